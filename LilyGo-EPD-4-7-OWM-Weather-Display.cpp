@@ -32,6 +32,12 @@
 // loggingWebserver
 #include <SD.h>
 #include <logWebServer.h>
+#include "logStorage.h"
+#include "logWriteBuffer.h"
+#include "logHotCache.h"
+#include "sdStats.h"
+#include "fileCatalog.h"
+#include "logPipeline.h"
 
 // Power saving
 #include "esp_pm.h"
@@ -68,10 +74,7 @@ SemaphoreHandle_t dataExhangeCompleteSem;
 SemaphoreHandle_t sht4xTriggerSem;
 SemaphoreHandle_t sht4xCompleteSem;
 
-// Queue handles
-QueueHandle_t sensorDataQueue;
-QueueHandle_t renderDataQueue;
-QueueHandle_t csvLogQueue;
+// Queue handles (sensorDataQueue, renderDataQueue, csvLogQueue) - logPipeline.h
 //QueueSetHandle_t queueSet = xQueueCreateSet(2); 
 
 //Task handles
@@ -129,14 +132,6 @@ typedef struct {
     uint8_t batPercentage;
 } SensorESPNOWData;
 
-// Global variables for SD Card handling
-#define MAX_ENTRIES 50000 // CSV single file logging limit
-bool sdCardInitialized = false;
-const int MAX_SD_INIT_RETRIES = 3;
-unsigned long lastSDRetryTime = 0;
-const unsigned long SD_RETRY_INTERVAL = 5000; // 5 seconds between retry attempts
-
-
 //################ ISR ##################################################
 
 // Button ISR
@@ -170,8 +165,8 @@ void IRAM_ATTR ButtonISR()
 */
 
 // ESP-NOW Callback Function
-// Variables to track last ESP-NOW reception time
-int64_t lastESPNowReceiveTime = 0;
+// Variables to track last ESP-NOW reception time, per node - retransmissions of one node don't block the others
+int64_t lastESPNowReceiveTime[SENSOR_REGISTRY_MAX] = {0};
 const int ESPNowIgnorePeriod = 45 * 1000000; // 30s in microseconds
 
 void OnDataRecv(const uint8_t *mac, const uint8_t *transmissionData, int len)
@@ -197,14 +192,24 @@ void OnDataRecv(const uint8_t *mac, const uint8_t *transmissionData, int len)
         return; // Discard the packet
     }
 
+    // Sender node - unknown nodes are only offered for pairing, registered by the registry's task
+    SensorId sensorId = sensorRegistryForMac(mac);
+    if (sensorId == SENSOR_ID_NONE)
+    {
+        SensorESPNOWData offered;
+        memcpy(&offered, transmissionData, sizeof(SensorESPNOWData));
+        sensorRegistryOfferNode(mac, offered.pressure > 0);
+        return;
+    }
+
     // Check if we're within the ignore period (received packet too soon)
     int64_t currentTime = esp_timer_get_time();
-    if (currentTime - lastESPNowReceiveTime < ESPNowIgnorePeriod)
+    if (lastESPNowReceiveTime[sensorId] != 0 && currentTime - lastESPNowReceiveTime[sensorId] < ESPNowIgnorePeriod)
     {
-        ESP_LOGW("ESP-NOW", "ESP-NOW packet received less than 45s ago, Ignoring.");
+        ESP_LOGW("ESP-NOW", "ESP-NOW packet from %s received less than 45s ago, Ignoring.", sensorName(sensorId));
         return;
     }
-    lastESPNowReceiveTime = currentTime; // Update last receive time
+    lastESPNowReceiveTime[sensorId] = currentTime; // Update last receive time
    
     // Process the packet
     SensorESPNOWData espnowTEMPData;
@@ -213,7 +218,7 @@ void OnDataRecv(const uint8_t *mac, const uint8_t *transmissionData, int len)
                              espnowTEMPData.temperature, 
                              espnowTEMPData.humidity, 
                              espnowTEMPData.pressure, 
-                             "/outside_log.csv", 
+                             sensorId, 
                              espnowTEMPData.batPercentage};
 
     if (xQueueSendFromISR(sensorDataQueue, &espnowData, NULL) != pdTRUE) {
@@ -228,7 +233,16 @@ void OnDataRecv(const uint8_t *mac, const uint8_t *transmissionData, int len)
     }
     else
     {
-        esp_err_t result = esp_now_send(receiverMac, (uint8_t *)&responseTimestamp, sizeof(responseTimestamp));
+        // Nodes registered at runtime aren't peers yet
+        if (!esp_now_is_peer_exist(mac))
+        {
+            esp_now_peer_info_t peerInfo = {};
+            memcpy(peerInfo.peer_addr, mac, 6);
+            peerInfo.channel = 0;
+            peerInfo.encrypt = false;
+            esp_now_add_peer(&peerInfo);
+        }
+        esp_err_t result = esp_now_send(mac, (uint8_t *)&responseTimestamp, sizeof(responseTimestamp));
         if (result == ESP_OK)
         {
             ESP_LOGI("ESP-NOW", "Successfully sent NTP timestamp: %" PRId32, responseTimestamp);
@@ -243,9 +257,11 @@ void OnDataRecv(const uint8_t *mac, const uint8_t *transmissionData, int len)
 
 bool initializeSDCard() {
     Serial.println("Initializing SD card...");
+    SDOpTimer timer(SD_OP_MOUNT);
     
     if (!SD.begin(SD_CS, SPI)) {
         Serial.println("SD Card initialization failed!");
+        timer.done(false);
         return false;
     }
     
@@ -255,6 +271,7 @@ bool initializeSDCard() {
     uint64_t cardSize = SD.cardSize();
     if (cardSize == 0) {
         Serial.println("Error: SD Card size not detected correctly!");
+        timer.done(false);
         return false;
     } else {
         Serial.printf("SD Card initialized. Size: %.2f GB\n", cardSize / 1024.0 / 1024.0 / 1024.0);
@@ -271,134 +288,6 @@ void setupSDCard() {
     }
 }
 
-// Function to check SD card health and attempt reinit if needed
-bool checkAndReinitSDCard() {
-    // If already initialized, do a quick check
-    if (sdCardInitialized) {
-        // Simple test - try to open the root directory
-        File root = SD.open("/");
-        if (!root || !root.isDirectory()) {
-            // SD card issue detected
-            Serial.println("SD card disconnected or failed during operation!");
-            sdCardInitialized = false;
-            if (root) root.close();
-        } else {
-            root.close();
-            return true; // Card is working fine
-        }
-    }
-    
-    // Only attempt reinitialization if enough time has passed since last attempt
-    unsigned long currentTime = millis();
-    if (!sdCardInitialized && (currentTime - lastSDRetryTime >= SD_RETRY_INTERVAL)) {
-        Serial.println("Attempting to reinitialize SD card...");
-        
-        // Try to end current session before reinitializing
-        SD.end();
-        delay(100);
-        
-        // Attempt to reinitialize
-        for (int retry = 0; retry < MAX_SD_INIT_RETRIES; retry++) {
-            if (initializeSDCard()) {
-                sdCardInitialized = true;
-                Serial.println("SD card successfully reinitialized!");
-                break;
-            }
-            Serial.printf("Reinit attempt %d failed, retrying...\n", retry + 1);
-            delay(500); // Short delay between retry attempts
-        }
-        
-        lastSDRetryTime = currentTime; // Update the last retry time
-    }
-    
-    return sdCardInitialized;
-}
-
-// Rotating/archiving files over 50000 entries - MAX_ENTRIES
-void rotateLogFile(const char *filename) {
-    // First check if file exists
-    if (!SD.exists(filename)) {
-        Serial.printf("File %s doesn't exist yet, no rotation needed\n", filename);
-        return;
-    }
-    
-    // Open the file to count lines
-    File file = SD.open(filename, FILE_READ);
-    if (!file) {
-        Serial.printf("Failed to open %s for line counting!\n", filename);
-        return;
-    }
-    
-    // Count lines
-    /*
-    int lineCount = 0;
-    while (file.available()) {
-        file.readStringUntil('\n');
-        lineCount++;
-    }
-    */
-    // Improved Count lines
-    int lineCount = 0;
-    char buf[64];
-    size_t bytes;
-    while ((bytes = file.read((uint8_t*)buf, sizeof(buf))) > 0) {
-        for (size_t i = 0; i < bytes; i++) {
-            if (buf[i] == '\n') lineCount++;
-        }
-    }
-    file.close();
-    
-    Serial.printf("File %s has %d entries\n", filename, lineCount);
-    
-    // If under threshold, no rotation needed
-    if (lineCount <= MAX_ENTRIES) {
-        return;
-    }
-    
-    // Create backup filename with date
-    char backupFilename[64];
-    // Get current date from RTC or system
-    // Format: bacMMDDYY.filename
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    
-    // Extract just the basename from path
-    const char *baseFilename = strrchr(filename, '/');
-    if (baseFilename != NULL) {
-        baseFilename++; // Skip the '/' character
-    } else {
-        baseFilename = filename; // No directory in path
-    }
-    
-    // Format backup filename with date prefix - with bounds checking
-    int written = snprintf(backupFilename, sizeof(backupFilename), "/bac%02d%02d%02d.%s", 
-             timeinfo.tm_mon + 1, timeinfo.tm_mday, timeinfo.tm_year % 100, baseFilename);
-    
-    if (written >= sizeof(backupFilename)) {
-        Serial.printf("ERROR: Backup filename too long, truncated: %s\n", backupFilename);
-        return; // Skip rotation if filename doesn't fit
-    }
-    
-    Serial.printf("Rotating log file %s to %s\n", filename, backupFilename);
-    
-    // Check if backup file already exists, remove it if it does
-    if (SD.exists(backupFilename)) {
-        Serial.printf("Removing existing backup file %s\n", backupFilename);
-        SD.remove(backupFilename);
-    }
-    
-    // Rename the current log file to the backup name
-    if (!SD.rename(filename, backupFilename)) {
-        Serial.printf("Failed to rename %s to %s!\n", filename, backupFilename);
-        return;
-    }
-    
-    // No need to create a new empty file - it will be created when needed
-    Serial.printf("Log rotation complete. New data will be written to a fresh %s\n", filename);
-}
-
 void InitialiseDisplay()
 {
     epd_init();
@@ -429,7 +318,7 @@ void InitialiseSystem()
     SPI.begin(SD_SCLK, SD_MISO, SD_MOSI, SD_CS);  // Initialise SPI bus for SD card
     ESP_ERROR_CHECK(i2cdev_init()); // Initialize the I2C bus for SHT41
     InitialiseDisplay();
-    initializeSDCard();
+    sdCardInitialized = initializeSDCard();
 }
 
 boolean SetTime()
@@ -705,9 +594,9 @@ void renderDisplay(volatile int &screenState)
     // Wait for two sensor data messages (inside & outside)
     for (int i = 0; i < 2; i++) {
         if (xQueueReceive(renderDataQueue, &tempData, pdMS_TO_TICKS(100)) == pdTRUE) {
-            if (strcmp(tempData.filename, "/outside_log.csv") == 0) {
+            if (tempData.sensorId == SENSOR_ID_OUTSIDE) {
                 outsideData = tempData;
-            } else if (strcmp(tempData.filename, "/inside_log.csv") == 0) {
+            } else if (tempData.sensorId == SENSOR_ID_INSIDE) {
                 insideData = tempData;
             }
         }
@@ -1448,7 +1337,7 @@ void SHT4xReadTask(void *pvParameters)
     SensorData sht4xdata;
     sht4xdata.pressure = 0;
     sht4xdata.timestamp = 0;
-    sht4xdata.filename = "/inside_log.csv";
+    sht4xdata.sensorId = SENSOR_ID_INSIDE;
     sht4xdata.batPercentage = 100;
 
     //Init SHT4x sensor with retry logic
@@ -1524,74 +1413,11 @@ void SHT4xReadTask(void *pvParameters)
     }
 }
 
-//Data distributing task
-void dataDistributorTask(void *parameter) {
-    SensorData data;
-    
-    while (1) {
-        // Wait for new data from sensors
-        if (xQueueReceive(sensorDataQueue, &data, portMAX_DELAY) == pdTRUE) {
-
-            // Distribute to all subscribers
-            if (xQueueSend(renderDataQueue, &data, pdMS_TO_TICKS(10)) != pdTRUE) {
-                Serial.println("[WARNING] renderDataQueue is full! Data lost.");
-            }
-            if (xQueueSend(serverLatestQueue, &data, pdMS_TO_TICKS(10)) != pdTRUE) {
-                Serial.println("[WARNING] serverLatestQueue is full! Data lost.");
-            }
-            if (xQueueSend(csvLogQueue, &data, pdMS_TO_TICKS(10)) != pdTRUE) {
-                Serial.println("[WARNING] csvLogQueue is full! Data lost.");
-            }
-            
-            // Optional: Log distribution
-            Serial.printf("Distributed %s data: %.1f°C, %.1f%%, %.1fhPa, timestamp: %d\n", data.filename, data.temperature, data.humidity, data.pressure, data.timestamp);
-        }
-
-        // Small delay to prevent CPU hogging
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-}
-
-// Updated SD Logging Task that includes file rotation
-void SDLogTask(void *pvParameters) {
-    SensorData logEntry;
-    while (1) {
-        // Wait indefinitely for new data in the queue
-        if (xQueueReceive(csvLogQueue, &logEntry, portMAX_DELAY) == pdTRUE) {
-
-            if (checkAndReinitSDCard() != sdCardInitialized)  {
-                Serial.println("SD card not available, data logging skipped!");
-                continue;
-            }
-            // Veryfing proper time assigment, in case any ESP hasn't set its NTP yet
-            if(logEntry.timestamp < 1700000000){
-                Serial.printf("Received data to log with incorrect timestamp, skipping loging.");
-                continue;
-            }
-            // Check if we need to rotate the log file
-            rotateLogFile(logEntry.filename);
-            
-            // Open file for appending (will create if doesn't exist)
-            File file = SD.open(logEntry.filename, FILE_APPEND);
-            if (!file) {
-                Serial.printf("Failed to open %s for writing!\n", logEntry.filename);
-                // Mark card as potentially failed to trigger reinitialization
-                sdCardInitialized = false;
-                continue;
-            }
-            
-            // Round up timestamps to 10s
-            logEntry.timestamp = (logEntry.timestamp + 5) / 10 * 10;
-
-            // Write data in CSV format
-            file.printf("%d,%.2f,%.1f,%.1f,%d\n", logEntry.timestamp, logEntry.temperature, 
-                       logEntry.humidity, logEntry.pressure, logEntry.batPercentage);
-            file.close();
-            
-            Serial.printf("Data logged to %s: Ts: %d, t: %.1f, h: %.1f, p: %.1f, b: %d\n",
-                         logEntry.filename, logEntry.timestamp, logEntry.temperature, 
-                         logEntry.humidity, logEntry.pressure, logEntry.batPercentage);
-        }
+// Asks SDLogTask to flush the log write buffer if the coming idle period (or deep sleep) would
+// exceed the data-loss window, and waits for it
+static void signalLogBufferIdle(int idleSeconds, bool deepSleep) {
+    if (!logPipelineRequestIdleFlush(idleSeconds, deepSleep, SECONDS_TO_TICKS(10))) {
+        ESP_LOGW("IdleTask", "Log buffer idle flush not confirmed, %u records pending", logBufferCount());
     }
 }
 
@@ -1615,6 +1441,9 @@ void IdleTask(void *pvParameters) {
     }
     
     Serial.printf("Idling for %d seconds, waking at next 15-min mark\n", sleepDuration);
+
+    // Buffered log records must not outlive the data-loss window (or deep sleep, PSRAM is lost)
+    signalLogBufferIdle(sleepDuration, DeepSleepEnabled);
         
     // Deep sleep if enabled
     if(DeepSleepEnabled == true) 
@@ -1780,8 +1609,9 @@ void setup()
     dataExhangeCompleteSem = xSemaphoreCreateBinary();
     sht4xTriggerSem = xSemaphoreCreateBinary();
     sht4xCompleteSem = xSemaphoreCreateBinary();
+    logFlushDoneSem = xSemaphoreCreateBinary();
 
-    if (!configSemaphore || !idleEndedSem || !ButtonWakeSem || !ESPNowWakeSem || !dataExhangeCompleteSem || !sht4xTriggerSem || !sht4xCompleteSem) 
+    if (!configSemaphore || !idleEndedSem || !ButtonWakeSem || !ESPNowWakeSem || !dataExhangeCompleteSem || !sht4xTriggerSem || !sht4xCompleteSem || !logFlushDoneSem) 
     {
         ESP_LOGE("SETUP", "Failed to create ALL semaphores");
         return;
@@ -1789,13 +1619,12 @@ void setup()
     ESP_LOGI("SETUP", "All semaphores created successfully");
 
     // Create queues with error checking
-    sensorDataQueue = xQueueCreate(10, sizeof(SensorData));
-    renderDataQueue = xQueueCreate(4, sizeof(SensorData));
-    serverLatestQueue = xQueueCreate(4, sizeof(SensorData));
-    csvLogQueue = xQueueCreate(12, sizeof(SensorData));
+    sensorDataQueue = xQueueCreate(SENSOR_DATA_QUEUE_LENGTH, sizeof(SensorData));
+    renderDataQueue = xQueueCreate(RENDER_DATA_QUEUE_LENGTH, sizeof(SensorData));
+    csvLogQueue = xQueueCreate(CSV_LOG_QUEUE_LENGTH, sizeof(LogMessage));
 
 
-    if (sensorDataQueue == NULL || renderDataQueue == NULL || serverLatestQueue == NULL || csvLogQueue == NULL) 
+    if (sensorDataQueue == NULL || renderDataQueue == NULL || csvLogQueue == NULL) 
     {
         ESP_LOGE("SETUP", "Failed to create queues");
         return;
@@ -1851,6 +1680,9 @@ void setup()
     Serial.println("ESP-NOW Init Failed");
     return;
     }
+    // Sensor IDs for everything that produces SensorData - the outside node is bound to receiverMac
+    sensorRegistryInit(receiverMac);
+
     // Register ESP-NOW callback
     esp_now_register_recv_cb(OnDataRecv); 
 
@@ -1876,6 +1708,9 @@ void setup()
         ESP_LOGI("SETUP", "SHT4xReadTask created successfully");
     }
 
+    // Recent readings in PSRAM for the web API, filled by dataDistributorTask
+    logHotCacheInit();
+
     // Create data distributor task - critical for data flow
     xReturned = xTaskCreate(dataDistributorTask, "dataDistributorTask", 4096, NULL, 4, NULL);
     if (xReturned != pdPASS) 
@@ -1898,7 +1733,22 @@ void setup()
     }
     ESP_LOGI("SETUP", "WeatherUpdateTask created successfully");
 
+    // Convert CSV logs left by older firmware and check index sidecars (needs valid time for backup naming)
+    if (sdCardInitialized) {
+        fileCatalogInit();
+        logStorageInit();
+        logCompactionStart();
+    }
+
+    // Hot cache history loaded from the card in the background
+    if (sdCardInitialized) {
+        logHotCacheWarm();
+    }
+
     // Create SD logging task - important but not critical
+    if (!logBufferInit()) {
+        ESP_LOGW("SETUP", "Log write buffer allocation failed, readings will not be logged");
+    }
     xReturned = xTaskCreate(SDLogTask, "SDLogTask", 8192, NULL, 2, NULL);
     if (xReturned != pdPASS) 
     {
@@ -6,16 +6,7 @@
 #include "epd_driver.h"        // https://github.com/Xinyuan-LilyGO/LilyGo-EPD47
 #include "drawingFunctions.h"
 #include "lang.h"
-
-// Struct for transfering data in the queues - rendering, server updates, storing
-typedef struct {
-    int32_t timestamp;
-    float temperature;
-    float humidity;
-    float pressure;
-    const char *filename;  // Name of the file to store data - "/outside_log.csv" or "/inside_log.csv"
-    uint8_t batPercentage;
-} SensorData;
+#include "sensorRegistry.h"    // SensorData, sensor IDs
 
 // For current Day and Day 1, 2, 3, etc
 typedef struct
@@ -0,0 +1,94 @@
+// Synthetic sensor history for the log benchmarks
+// Writes /inside_log.csv and /outside_log.csv in the CSV format of older firmware
+// (timestamp,temperature,humidity,pressure,battery) into a card directory - logStorageInit()
+// imports them into log segments, exactly like a card moved over from an old device.
+//
+//   gendata <card-dir> [--days N] [--interval S] [--end TIMESTAMP] [--seed N]
+//
+// Readings follow a seasonal and a daily cycle with noise; --interval 900 matches the device.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <sys/stat.h>
+
+static const double DAY_S = 86400.0;
+static const double YEAR_S = 365.25 * DAY_S;
+
+// xorshift32 - reproducible across platforms, unlike rand()
+static uint32_t rngState = 2463534242u;
+
+static double noise(double amplitude) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return ((rngState / 4294967295.0) * 2.0 - 1.0) * amplitude;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: gendata <card-dir> [--days N] [--interval S] [--end TIMESTAMP] [--seed N]\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    const char *cardDir = argv[1];
+    long days = 730;
+    long interval = 900;
+    long end = (long)time(NULL);
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--days") == 0) days = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--interval") == 0) interval = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--end") == 0) end = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) rngState = (uint32_t)atol(argv[i + 1]) | 1;
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (days <= 0 || interval < 10) {
+        usage();
+        return 1;
+    }
+    mkdir(cardDir, 0755);
+
+    std::string insidePath = std::string(cardDir) + "/inside_log.csv";
+    std::string outsidePath = std::string(cardDir) + "/outside_log.csv";
+    FILE *inside = fopen(insidePath.c_str(), "w");
+    FILE *outside = fopen(outsidePath.c_str(), "w");
+    if (!inside || !outside) {
+        fprintf(stderr, "cannot write into %s\n", cardDir);
+        return 1;
+    }
+
+    // Aligned like the device's 15 min wake-ups
+    long start = (end - days * 86400L) / interval * interval;
+    unsigned long lines = 0;
+    double pressure = 1013.0;
+    for (long ts = start; ts <= end; ts += interval) {
+        double season = cos(2 * M_PI * fmod(ts - 1705000000.0, YEAR_S) / YEAR_S);    // 1 mid January
+        double daily = -cos(2 * M_PI * (fmod(ts, DAY_S) - 3 * 3600) / DAY_S);       // Peak 15:00 UTC
+
+        double outT = 9.0 - 11.0 * season + 5.0 * daily + noise(0.8);
+        double outH = 75.0 + 8.0 * season - 15.0 * daily + noise(3.0);
+        pressure += noise(0.4) + (1013.0 - pressure) * 0.01;
+        int battery = 100 - (int)((ts - start) / (30 * 86400L)) % 60;
+
+        double inT = 21.5 - 1.5 * season + 0.8 * daily + noise(0.2);
+        double inH = 45.0 + 10.0 * season + noise(1.5);
+
+        fprintf(outside, "%ld,%.2f,%.1f,%.1f,%d\n", ts, outT, fmin(fmax(outH, 5), 100), pressure, battery);
+        fprintf(inside, "%ld,%.2f,%.1f,%.1f,%d\n", ts + 7, inT, inH, 0.0, 100);
+        lines++;
+    }
+    fclose(inside);
+    fclose(outside);
+
+    printf("%lu readings per sensor, %ld days at %ld s, ending %ld\n", lines, days, interval, end);
+    return 0;
+}
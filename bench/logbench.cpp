@@ -0,0 +1,362 @@
+// Log storage benchmark - runs the storage and query paths of the web API against a card
+// directory on the host (see shim/) and reports records/s, MB/s read and peak heap per query.
+//
+//   logbench <card-dir> [--repeat N] [--compact]
+//
+// Phases:
+//   init     logStorageInit() - legacy CSV import, rollup catch-up, compression of closed months
+//   compact  with --compact: downsampling of months past LOG_DOWNSAMPLE_AFTER_MONTHS, queries
+//            afterwards read the compacted segments
+//   append   write-behind buffer flushes of a dataset-long "bench" sensor (segment rollovers)
+//   latest   /latest fallback - last record by offset, and from the hot cache
+//   tail     /recent fallback - last 288 records from the newest segments
+//   warm     hot cache warm-up
+//   queries  per range and sensor, each the best of --repeat runs:
+//            minmax-raw / minmax-rollup    /minmax over the raw log / over rollups and edge records
+//            chart-raw / chart-rollup      /chart-data JSON aggregated from raw / from rollups
+//            chart-hot                     /chart-data JSON from the hot cache
+//            csv                           /download CSV conversion
+//
+// Host timings come from the page cache, not an SD card - compare runs with each other, not
+// with the device. MB/s counts bytes read through the FS shim.
+
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+#include "heapTrack.h"
+#include "logStorage.h"
+#include "logRollup.h"
+#include "logHotCache.h"
+#include "logWriteBuffer.h"
+
+static const char *BENCH_SENSOR = "bench";
+
+typedef struct {
+    const char *name;
+    int32_t seconds;        // 0 - whole dataset
+} BenchRange;
+
+static const BenchRange ranges[] = {
+    {"24h", 24 * 3600},
+    {"week", 7 * 86400},
+    {"month", 30 * 86400},
+    {"year", 365 * 86400},
+    {"all", 0},
+};
+
+static int repeat = 3;
+
+// Results land here so the compiler can't drop the work
+static volatile float benchSink;
+
+// Same rules as getAggregationStep() in logWebServer.cpp
+static int32_t aggregationStep(int32_t rangeSeconds) {
+    int rangeHours = rangeSeconds / 3600;
+    if (rangeHours > 8760) return 604800;
+    if (rangeHours > 672) return 86400;
+    if (rangeHours > 168) return 3600;
+    return 300;
+}
+
+//################## Measurement ##################
+
+static void printHeader() {
+    printf("%-14s %-6s %-8s %10s %10s %10s %9s %9s\n",
+           "phase", "range", "sensor", "records", "ms", "krec/s", "MB/s", "peakKB");
+}
+
+// Runs body repeat times (once if single), prints the fastest run; body returns records processed
+template <typename Body>
+static void measure(const char *phase, const char *range, const char *sensor, bool single, Body body) {
+    double bestMs = -1;
+    uint32_t records = 0;
+    uint64_t bytes = 0;
+    size_t peak = 0;
+
+    for (int run = 0; run < (single ? 1 : repeat); run++) {
+        shimResetIOStats();
+        size_t heapBefore = heapTrackCurrent();
+        heapTrackResetPeak();
+        unsigned long start = micros();
+
+        records = body();
+
+        double ms = (micros() - start) / 1000.0;
+        peak = max(peak, heapTrackPeak() - heapBefore);
+        if (bestMs < 0 || ms < bestMs) {
+            bestMs = ms;
+            bytes = shimIOStats().bytesRead;
+        }
+    }
+
+    double seconds = max(bestMs, 0.001) / 1000.0;
+    printf("%-14s %-6s %-8s %10u %10.2f %10.1f %9.1f %9.1f\n", phase, range, sensor, (unsigned)records,
+           bestMs, records / seconds / 1000.0, bytes / seconds / 1e6, peak / 1024.0);
+}
+
+//################## Workloads ##################
+
+typedef struct {
+    float min, max, sum;
+    uint32_t count;
+} FieldStats;
+
+static void fold(FieldStats &stats, float value) {
+    if (stats.count == 0 || value < stats.min) stats.min = value;
+    if (stats.count == 0 || value > stats.max) stats.max = value;
+    stats.sum += value;
+    stats.count++;
+}
+
+static uint32_t minMaxRaw(const char *sensor, int32_t start, int32_t end) {
+    FieldStats temperature = {}, humidity = {}, pressure = {};
+    LogQuery query;
+    if (!query.open(sensor, start, end)) return 0;
+    LogRecord rec;
+    while (query.next(rec)) {
+        fold(temperature, logRecordTemperature(rec));
+        fold(humidity, logRecordHumidity(rec));
+        if (rec.flags & LOG_FLAG_HAS_PRESSURE) fold(pressure, logRecordPressure(rec));
+    }
+    query.close();
+    benchSink = temperature.min + temperature.max + humidity.sum + pressure.sum;
+    return temperature.count;
+}
+
+// Rollup rows inside the range, raw records at the edges like calculateMinMaxAvg()
+static uint32_t minMaxRollup(const char *sensor, int32_t start, int32_t end) {
+    LogRangeStats stats;
+    if (!logRangeStats(sensor, start, end, 400, stats)) return 0;
+    benchSink = stats.temperature.min + stats.temperature.max + stats.humidity.sum + stats.pressure.sum;
+    return stats.count;
+}
+
+static void appendPoint(String &json, bool &first, int32_t timestamp, float temperature, float humidity) {
+    char point[64];
+    snprintf(point, sizeof(point), "%s{\"tS\":%d,\"T\":%.1f,\"H\":%.1f}", first ? "" : ",",
+             (int)timestamp, temperature, humidity);
+    json += point;
+    first = false;
+}
+
+// Step averages like streamProcessLogToJSON()
+static uint32_t chartRaw(const char *sensor, int32_t start, int32_t end, size_t &jsonLen) {
+    int32_t step = aggregationStep(end - start);
+    String json("[");
+    bool first = true;
+    uint32_t records = 0;
+
+    LogQuery query;
+    if (query.open(sensor, start, end)) {
+        int32_t bucket = 0;
+        float sumT = 0, sumH = 0;
+        uint32_t count = 0;
+        LogRecord rec;
+        while (query.next(rec)) {
+            int32_t recBucket = rec.timestamp / step * step;
+            if (count > 0 && recBucket != bucket) {
+                appendPoint(json, first, bucket, sumT / count, sumH / count);
+                sumT = sumH = 0;
+                count = 0;
+            }
+            bucket = recBucket;
+            sumT += logRecordTemperature(rec);
+            sumH += logRecordHumidity(rec);
+            count++;
+            records++;
+        }
+        if (count > 0) appendPoint(json, first, bucket, sumT / count, sumH / count);
+        query.close();
+    }
+    json += "]";
+    jsonLen = json.length();
+    return records;
+}
+
+static uint32_t chartRollup(const char *sensor, int32_t start, int32_t end, size_t &jsonLen) {
+    LogRollupReader reader;
+    String json("[");
+    bool first = true;
+    uint32_t rows = 0;
+    if (reader.open(sensor, logRollupTierForStep(aggregationStep(end - start))) && reader.seek(start)) {
+        LogRollupRow row;
+        while (reader.next(row) && row.bucketStart < end) {
+            appendPoint(json, first, row.bucketStart,
+                        logRollupAverage(row.temperature, row.count, LOG_TEMP_SCALE),
+                        logRollupAverage(row.humidity, row.count, LOG_HUMIDITY_SCALE));
+            rows++;
+        }
+    }
+    json += "]";
+    jsonLen = json.length();
+    return rows;
+}
+
+static uint32_t chartHot(const char *sensor, int32_t start, int32_t end) {
+    if (!logHotCacheCovers(sensor, start)) return 0;
+    int32_t step = aggregationStep(end - start);
+    String json("[");
+    bool first = true;
+    uint32_t records = 0;
+
+    LogHotCacheReader reader;
+    if (reader.open(sensor, start, end)) {
+        int32_t bucket = 0;
+        float sumT = 0, sumH = 0;
+        uint32_t count = 0;
+        LogRecord rec;
+        while (reader.next(rec)) {
+            int32_t recBucket = rec.timestamp / step * step;
+            if (count > 0 && recBucket != bucket) {
+                appendPoint(json, first, bucket, sumT / count, sumH / count);
+                sumT = sumH = 0;
+                count = 0;
+            }
+            bucket = recBucket;
+            sumT += logRecordTemperature(rec);
+            sumH += logRecordHumidity(rec);
+            count++;
+            records++;
+        }
+        if (count > 0) appendPoint(json, first, bucket, sumT / count, sumH / count);
+    }
+    return records;
+}
+
+static uint32_t csvExport(const char *sensor, int32_t start, int32_t end) {
+    LogCSVStream stream;
+    if (!stream.open(sensor, start, end)) return 0;
+    uint8_t buffer[512];
+    uint32_t lines = 0;
+    size_t len;
+    while ((len = stream.read(buffer, sizeof(buffer))) > 0) {
+        for (size_t i = 0; i < len; i++) {
+            if (buffer[i] == '\n') lines++;
+        }
+    }
+    return lines;
+}
+
+// Dataset-long sensor written through the write-behind buffer, one flush per LOG_BUFFER_FLUSH_RECORDS
+static uint32_t appendDataset(int32_t start, int32_t end) {
+    uint32_t records = 0;
+    for (int32_t ts = start / 900 * 900; ts <= end; ts += 900) {
+        float temperature = 15.0f + 10.0f * sinf(ts / 86400.0f);
+        logBufferAdd(BENCH_SENSOR, logMakeRecord(ts, temperature, 60.0f, 1010.0f, 90, true));
+        if (++records % LOG_BUFFER_FLUSH_RECORDS == 0) logBufferFlush(LOG_FLUSH_SIZE);
+    }
+    logBufferFlush(LOG_FLUSH_SIZE);
+    return records;
+}
+
+//################## Main ##################
+
+static uint32_t segmentRecords(const char *sensor, int32_t &firstTs, int32_t &lastTs) {
+    size_t count = logListSegments(sensor, NULL, 0);
+    std::vector<LogSegmentInfo> segments(count);
+    count = logListSegments(sensor, segments.data(), count);
+    uint32_t records = 0;
+    firstTs = INT32_MAX;
+    lastTs = INT32_MIN;
+    for (size_t i = 0; i < count; i++) {
+        records += segments[i].count;
+        firstTs = min(firstTs, segments[i].firstTs);
+        lastTs = max(lastTs, segments[i].lastTs);
+    }
+    return records;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: logbench <card-dir> [--repeat N] [--compact]\n");
+        return 1;
+    }
+    shimSetRoot(argv[1]);
+    bool compact = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--compact") == 0) compact = true;
+    }
+
+    printHeader();
+
+    measure("init", "-", "-", true, []() {
+        logStorageInit();
+        int32_t firstTs, lastTs;
+        return segmentRecords(insideLogName, firstTs, lastTs) + segmentRecords(outsideLogName, firstTs, lastTs);
+    });
+
+    if (compact) {
+        measure("compact", "-", "-", true, []() {
+            logDownsampleClosedSegments();
+            int32_t firstTs, lastTs;
+            return segmentRecords(insideLogName, firstTs, lastTs) + segmentRecords(outsideLogName, firstTs, lastTs);
+        });
+    }
+
+    int32_t firstTs, lastTs;
+    if (segmentRecords(outsideLogName, firstTs, lastTs) == 0) {
+        fprintf(stderr, "no outside log records in %s - run gendata first\n", argv[1]);
+        return 1;
+    }
+
+    logBufferInit();
+    int32_t benchFirst, benchLast;
+    if (segmentRecords(BENCH_SENSOR, benchFirst, benchLast) == 0) {
+        measure("append", "all", BENCH_SENSOR, true, [&]() { return appendDataset(firstTs, lastTs); });
+    } else {
+        printf("%-14s skipped, %s segments exist from an earlier run\n", "append", BENCH_SENSOR);
+    }
+
+    measure("latest", "-", outsideLogName, false, []() {
+        LogRecord rec;
+        uint32_t found = 0;
+        for (int i = 0; i < 100; i++) found += logReadLastRecord(outsideLogName, rec);
+        return found;
+    });
+
+    measure("tail", "-", outsideLogName, false, []() {
+        static LogRecord recs[288];
+        return (uint32_t)logReadLastRecords(outsideLogName, recs, 288);
+    });
+
+    logHotCacheInit();
+    measure("warm", "-", "-", true, []() {
+        logHotCacheWarm();
+        shimJoinTasks();
+        uint32_t cached = 0;
+        for (const char *sensor : {insideLogName, outsideLogName}) {
+            LogHotCacheReader reader;
+            LogRecord rec;
+            if (reader.open(sensor, 0, INT32_MAX)) {
+                while (reader.next(rec)) cached++;
+            }
+        }
+        return cached;
+    });
+
+    measure("latest-hot", "-", outsideLogName, false, []() {
+        LogRecord rec;
+        uint32_t found = 0;
+        for (int i = 0; i < 100; i++) found += logHotCacheLast(outsideLogName, rec);
+        return found;
+    });
+
+    const char *sensors[] = {insideLogName, outsideLogName};
+    for (const BenchRange &range : ranges) {
+        int32_t start = range.seconds ? lastTs - range.seconds : firstTs;
+        int32_t end = lastTs + 1;
+        for (const char *sensor : sensors) {
+            size_t jsonLen = 0;
+            measure("minmax-raw", range.name, sensor, false, [&]() { return minMaxRaw(sensor, start, end); });
+            measure("minmax-rollup", range.name, sensor, false, [&]() { return minMaxRollup(sensor, start, end); });
+            measure("chart-raw", range.name, sensor, false, [&]() { return chartRaw(sensor, start, end, jsonLen); });
+            measure("chart-rollup", range.name, sensor, false, [&]() { return chartRollup(sensor, start, end, jsonLen); });
+            if (logHotCacheCovers(sensor, start)) {
+                measure("chart-hot", range.name, sensor, false, [&]() { return chartHot(sensor, start, end); });
+            }
+            measure("csv", range.name, sensor, false, [&]() { return csvExport(sensor, start, end); });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,334 @@
+// Logging pipeline harness - runs dataDistributorTask and SDLogTask (logPipeline.cpp) with the
+// firmware's queues against a card directory with injected faults (see shim/SD.h), and reports
+// queue occupancy over time, readings lost on the way and how long the card took to come back.
+//
+//   pipebench <card-dir> [options]
+//     --hours H          simulated run time (default 6)
+//     --interval S       seconds between readings of each sensor (default 60)
+//     --sensors N        sensors reporting, inside and outside first (default 2)
+//     --speed X          shim clock speed-up over real time (default 600)
+//     --latency US       added to every card access
+//     --stall P:MS       share of card accesses that stall, and for how long
+//     --fail P           share of opens and writes that fail
+//     --outage AT:FOR    card pulled AT minutes into the run for FOR minutes, repeatable
+//     --csv-queue N      csvLogQueue length (default CSV_LOG_QUEUE_LENGTH)
+//     --timeline FILE    queue depths and card state per simulated second, CSV
+//
+// The local sensor waits up to 1 s for sensorDataQueue like SHT4xReadTask, ESP-NOW nodes don't
+// wait (sent from the receive callback). A display stand-in drains renderDataQueue.
+
+#include <Arduino.h>
+#include <SD.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "logPipeline.h"
+#include "logStorage.h"
+#include "logWriteBuffer.h"
+#include "logHotCache.h"
+#include "sdStats.h"
+#include "fileCatalog.h"
+
+typedef struct {
+    uint32_t atS;
+    uint32_t forS;
+} Outage;
+
+static uint32_t runHours = 6;
+static uint32_t intervalS = 60;
+static int sensorCount = 2;
+static uint32_t speed = 600;
+static UBaseType_t csvQueueLength = CSV_LOG_QUEUE_LENGTH;
+static ShimFaults baseFaults;
+static std::vector<Outage> outages;
+static const char *timelinePath = NULL;
+
+static int32_t startTs;
+static std::atomic<bool> producing(true);
+static std::atomic<uint32_t> produced(0);
+static std::atomic<uint32_t> sensorQueueDropped(0);
+
+// Board mount of the firmware, against the shim card
+bool initializeSDCard() {
+    SDOpTimer timer(SD_OP_MOUNT);
+    bool ok = SD.begin() && SD.cardSize() > 0;
+    timer.done(ok);
+    return ok;
+}
+
+static uint32_t simSeconds() {
+    return millis() / 1000;
+}
+
+//################## Stand-ins ##################
+
+static void sensorsThread(std::vector<SensorId> ids) {
+    uint32_t endS = runHours * 3600;
+    // Sensors report staggered over the interval
+    std::vector<uint32_t> nextDue(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) nextDue[i] = i * intervalS / ids.size();
+
+    while (true) {
+        size_t next = 0;
+        for (size_t i = 1; i < ids.size(); i++) {
+            if (nextDue[i] < nextDue[next]) next = i;
+        }
+        if (nextDue[next] >= endS) break;
+        uint32_t now = simSeconds();
+        if (nextDue[next] > now) delay((nextDue[next] - now) * 1000);
+
+        SensorData data = {};
+        data.timestamp = startTs + nextDue[next];
+        data.temperature = 20.0f + (nextDue[next] % 600) / 100.0f;
+        data.humidity = 50.0f;
+        data.pressure = 1013.0f;
+        data.sensorId = ids[next];
+        data.batPercentage = 90;
+
+        TickType_t wait = ids[next] == SENSOR_ID_INSIDE ? pdMS_TO_TICKS(1000) : 0;
+        if (xQueueSend(sensorDataQueue, &data, wait) != pdTRUE) sensorQueueDropped++;
+        produced++;
+        nextDue[next] += intervalS;
+    }
+    producing = false;
+}
+
+static void displayThread() {
+    SensorData data;
+    while (true) {
+        xQueueReceive(renderDataQueue, &data, pdMS_TO_TICKS(100));
+    }
+}
+
+//################## Sampling ##################
+
+typedef struct {
+    uint32_t seconds;
+    std::vector<uint32_t> csvDepth;     // Seconds spent at each csvLogQueue depth
+    uint32_t sensorQueueMax;
+    uint32_t bufferMax;
+} Occupancy;
+
+typedef struct {
+    uint32_t detectedAtS;               // Pipeline noticed the card missing
+    uint32_t remountedAtS;              // checkAndReinitSDCard() succeeded
+    uint32_t logDroppedDuring;
+} OutageResult;
+
+static bool cardPulled(uint32_t s) {
+    for (const Outage &outage : outages) {
+        if (s >= outage.atS && s < outage.atS + outage.forS) return true;
+    }
+    return false;
+}
+
+// Once per simulated second: applies the outage schedule, samples the queues
+static void sample(Occupancy &occupancy, std::vector<OutageResult> &results, FILE *timeline) {
+    uint32_t lastS = UINT32_MAX;
+    uint32_t outageSince = 0;
+    while (producing || uxQueueMessagesWaiting(sensorDataQueue) > 0 || uxQueueMessagesWaiting(csvLogQueue) > 0) {
+        uint32_t s = simSeconds();
+        if (s == lastS) {
+            delay(50);
+            continue;
+        }
+        lastS = s;
+
+        ShimFaults faults = baseFaults;
+        faults.removed = cardPulled(s);
+        shimSetFaults(faults);
+
+        uint32_t csvDepth = uxQueueMessagesWaiting(csvLogQueue);
+        uint32_t sensorDepth = uxQueueMessagesWaiting(sensorDataQueue);
+        uint32_t buffered = logBufferCount();
+        occupancy.seconds++;
+        occupancy.csvDepth[min(csvDepth, (uint32_t)csvQueueLength)]++;
+        occupancy.sensorQueueMax = max(occupancy.sensorQueueMax, sensorDepth);
+        occupancy.bufferMax = max(occupancy.bufferMax, buffered);
+
+        LogPipelineStats stats = logPipelineGetStats();
+        for (size_t i = 0; i < outages.size(); i++) {
+            OutageResult &result = results[i];
+            if (s < outages[i].atS) continue;
+            if (result.detectedAtS == UINT32_MAX && stats.outageSinceMs != 0) {
+                result.detectedAtS = stats.outageSinceMs / 1000;
+                outageSince = stats.logDropped;
+            }
+            if (result.detectedAtS != UINT32_MAX && result.remountedAtS == UINT32_MAX && stats.outageSinceMs == 0) {
+                result.remountedAtS = s;
+                result.logDroppedDuring = stats.logDropped - outageSince;
+            }
+        }
+
+        if (timeline) {
+            fprintf(timeline, "%u,%u,%u,%u,%d\n", (unsigned)s, (unsigned)sensorDepth, (unsigned)csvDepth,
+                    (unsigned)buffered, !faults.removed);
+        }
+        delay(50);
+    }
+}
+
+//################## Report ##################
+
+static uint32_t loggedRecords(const char *sensor) {
+    LogQuery query;
+    uint32_t count = 0;
+    if (query.open(sensor, startTs, INT32_MAX)) {
+        LogRecord rec;
+        while (query.next(rec)) count++;
+    }
+    return count;
+}
+
+static uint32_t depthPercentile(const Occupancy &occupancy, double share) {
+    uint64_t seen = 0;
+    for (size_t depth = 0; depth < occupancy.csvDepth.size(); depth++) {
+        seen += occupancy.csvDepth[depth];
+        if (seen >= share * occupancy.seconds) return depth;
+    }
+    return occupancy.csvDepth.size() - 1;
+}
+
+static void printOp(SDOp op, const SDOpStats &stats) {
+    if (stats.count == 0) return;
+    printf("  %-14s %8u ops %6u errors  avg %8.2f ms  max %8.2f ms\n", sdStatsOpName(op), (unsigned)stats.count,
+           (unsigned)stats.errors, stats.totalUs / 1000.0 / stats.count, stats.maxUs / 1000.0);
+}
+
+static bool parseArgs(int argc, char **argv) {
+    for (int i = 2; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) return false;
+        i++;
+        if (strcmp(arg, "--hours") == 0) runHours = max(1, atoi(value));
+        else if (strcmp(arg, "--interval") == 0) intervalS = max(10, atoi(value));
+        else if (strcmp(arg, "--sensors") == 0) sensorCount = max(1, min(atoi(value), LOG_MAX_SENSORS));
+        else if (strcmp(arg, "--speed") == 0) speed = max(1, atoi(value));
+        else if (strcmp(arg, "--latency") == 0) baseFaults.latencyUs = atoi(value);
+        else if (strcmp(arg, "--fail") == 0) baseFaults.failRate = atof(value);
+        else if (strcmp(arg, "--csv-queue") == 0) csvQueueLength = max(1, atoi(value));
+        else if (strcmp(arg, "--timeline") == 0) timelinePath = value;
+        else if (strcmp(arg, "--stall") == 0) {
+            float rate;
+            unsigned ms;
+            if (sscanf(value, "%f:%u", &rate, &ms) != 2) return false;
+            baseFaults.stallRate = rate;
+            baseFaults.stallMs = ms;
+        } else if (strcmp(arg, "--outage") == 0) {
+            unsigned at, length;
+            if (sscanf(value, "%u:%u", &at, &length) != 2) return false;
+            outages.push_back({at * 60, length * 60});
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || !parseArgs(argc, argv)) {
+        fprintf(stderr, "usage: pipebench <card-dir> [--hours H] [--interval S] [--sensors N] [--speed X]\n"
+                        "                 [--latency US] [--stall P:MS] [--fail P] [--outage AT:FOR]...\n"
+                        "                 [--csv-queue N] [--timeline FILE]\n");
+        return 1;
+    }
+    shimSetRoot(argv[1]);
+    shimSetTimeScale(speed);
+    startTs = time(nullptr);
+
+    // Same bring-up order as setup()
+    sdCardInitialized = initializeSDCard();
+    // Nodes are 02:00:00:00:00:<n>, node 1 is the outside sensor
+    static const uint8_t outsideMac[6] = {0x02, 0, 0, 0, 0, SENSOR_ID_OUTSIDE};
+    sensorRegistryInit(outsideMac);
+    sensorDataQueue = xQueueCreate(SENSOR_DATA_QUEUE_LENGTH, sizeof(SensorData));
+    renderDataQueue = xQueueCreate(RENDER_DATA_QUEUE_LENGTH, sizeof(SensorData));
+    csvLogQueue = xQueueCreate(csvQueueLength, sizeof(LogMessage));
+    logFlushDoneSem = xSemaphoreCreateBinary();
+    logHotCacheInit();
+    fileCatalogInit();
+    logStorageInit();
+    logBufferInit();
+
+    std::vector<SensorId> ids;
+    for (int i = 0; i < sensorCount; i++) {
+        if (i <= SENSOR_ID_OUTSIDE) {
+            ids.push_back(i);
+            continue;
+        }
+        uint8_t mac[6] = {0x02, 0, 0, 0, 0, (uint8_t)i};
+        SensorId id = sensorRegistryAdd(mac, true);
+        if (id != SENSOR_ID_NONE) ids.push_back(id);
+    }
+
+    shimSetFaults(baseFaults);
+    xTaskCreate(dataDistributorTask, "dataDistributorTask", 4096, NULL, 4, NULL);
+    xTaskCreate(SDLogTask, "SDLogTask", 8192, NULL, 2, NULL);
+    std::thread(displayThread).detach();
+    std::thread(sensorsThread, ids).detach();
+
+    Occupancy occupancy = {0, std::vector<uint32_t>(csvQueueLength + 1, 0), 0, 0};
+    std::vector<OutageResult> outageResults(outages.size(), {UINT32_MAX, UINT32_MAX, 0});
+    FILE *timeline = timelinePath ? fopen(timelinePath, "w") : NULL;
+    if (timeline) fprintf(timeline, "second,sensorQueue,csvLogQueue,buffered,cardUp\n");
+    sample(occupancy, outageResults, timeline);
+    if (timeline) fclose(timeline);
+
+    // Deep sleep request - SDLogTask flushes what is left in the write buffer
+    shimSetFaults(baseFaults);
+    bool flushed = logPipelineRequestIdleFlush(0, true, pdMS_TO_TICKS(60000));
+
+    LogPipelineStats pipeline = logPipelineGetStats();
+    LogBufferStats buffer = logBufferGetStats();
+    uint32_t logged = 0;
+    for (SensorId id : ids) logged += loggedRecords(sensorName(id));
+
+    printf("run                %u h simulated, %d sensors every %u s, csvLogQueue %u, x%u speed\n",
+           (unsigned)runHours, sensorCount, (unsigned)intervalS, (unsigned)csvQueueLength, (unsigned)speed);
+    printf("card faults        latency %u us, stalls %.4f x %u ms, failures %.4f, %u outages\n",
+           (unsigned)baseFaults.latencyUs, baseFaults.stallRate, (unsigned)baseFaults.stallMs,
+           baseFaults.failRate, (unsigned)outages.size());
+    printf("readings           %u produced, %u logged, %u lost%s\n", (unsigned)produced, (unsigned)logged,
+           (unsigned)(produced - min((uint32_t)produced, logged)), flushed ? "" : " (final flush not confirmed)");
+    printf("  sensorDataQueue  %u full\n", (unsigned)sensorQueueDropped);
+    printf("  csvLogQueue      %u full\n", (unsigned)pipeline.logDropped);
+    printf("  renderDataQueue  %u full (display only)\n", (unsigned)pipeline.renderDropped);
+    printf("  write buffer     %u overflowed, %u duplicates\n", (unsigned)buffer.recordsDropped, (unsigned)buffer.recordsDuplicate);
+    printf("csvLogQueue depth  p50 %u  p95 %u  p99 %u  max %u of %u, full %.2f%% of the time\n",
+           depthPercentile(occupancy, 0.50), depthPercentile(occupancy, 0.95), depthPercentile(occupancy, 0.99),
+           (unsigned)pipeline.logQueueMax, (unsigned)csvQueueLength,
+           occupancy.seconds ? 100.0 * occupancy.csvDepth[csvQueueLength] / occupancy.seconds : 0.0);
+    printf("sensorDataQueue    max %u of %u\n", (unsigned)occupancy.sensorQueueMax, SENSOR_DATA_QUEUE_LENGTH);
+    printf("write buffer       max %u records\n", (unsigned)occupancy.bufferMax);
+
+    printf("card outages       %u detected\n", (unsigned)pipeline.outages);
+    for (size_t i = 0; i < outages.size(); i++) {
+        const Outage &outage = outages[i];
+        const OutageResult &result = outageResults[i];
+        printf("  pulled %6us for %5us:", (unsigned)outage.atS, (unsigned)outage.forS);
+        if (result.detectedAtS == UINT32_MAX) {
+            printf(" not noticed\n");
+            continue;
+        }
+        printf(" noticed after %us", (unsigned)(result.detectedAtS - min(result.detectedAtS, outage.atS)));
+        if (result.remountedAtS == UINT32_MAX) {
+            printf(", not remounted\n");
+            continue;
+        }
+        uint32_t back = outage.atS + outage.forS;
+        printf(", remounted %us after reinsertion, %u readings lost to csvLogQueue\n",
+               (unsigned)(result.remountedAtS - min(result.remountedAtS, back)), (unsigned)result.logDroppedDuring);
+    }
+
+    SDOpStats ops[SD_OP_COUNT];
+    SDCardStats card;
+    sdStatsGet(ops, card);
+    printf("card operations    (simulated time)\n");
+    for (int op = 0; op < SD_OP_COUNT; op++) printOp((SDOp)op, ops[op]);
+
+    // Pipeline tasks never return
+    fflush(stdout);
+    _exit(0);
+}
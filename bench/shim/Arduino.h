@@ -0,0 +1,68 @@
+#ifndef BENCH_SHIM_ARDUINO_H
+#define BENCH_SHIM_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core the log storage modules use
+// Serial output goes to stderr and is muted unless BENCH_VERBOSE is set in the environment
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cctype>
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+int64_t esp_timer_get_time();
+
+// Shim clock runs this many times faster than real time - millis(), delays, task ticks and
+// injected card latency all scale, so hours of pipeline time pass in minutes. Set before use.
+void shimSetTimeScale(uint32_t factor);
+// Sleeps for shim clock microseconds
+void shimSleepUs(uint64_t us);
+
+// PSRAM is plain heap on the host
+void *ps_malloc(size_t size);
+void *ps_calloc(size_t count, size_t size);
+bool psramFound();
+
+class HardwareSerialShim {
+    public:
+        int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+        size_t print(const char *s);
+        size_t println(const char *s = "");
+};
+extern HardwareSerialShim Serial;
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+class String {
+    public:
+        String(const char *s = "") : str(s ? s : "") {}
+        String &operator=(const char *s) { str = s ? s : ""; return *this; }
+        String &operator+=(const char *s) { str += s; return *this; }
+        String &operator+=(const String &s) { str += s.str; return *this; }
+        String &operator+=(char c) { str += c; return *this; }
+        bool reserve(unsigned int size) { str.reserve(size); return true; }
+        bool concat(const char *s, unsigned int len) { str.append(s, len); return true; }
+        unsigned int length() const { return str.size(); }
+        const char *c_str() const { return str.c_str(); }
+        char operator[](unsigned int index) const { return str[index]; }
+
+    private:
+        std::string str;
+};
+
+#endif
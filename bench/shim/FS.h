@@ -0,0 +1,70 @@
+#ifndef BENCH_SHIM_FS_H
+#define BENCH_SHIM_FS_H
+
+// Host stand-in for the Arduino FS API, files live below a host directory (see SD.h)
+
+#include <Arduino.h>
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileImpl;
+
+class File {
+    public:
+        File() {}
+        explicit File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *buf, size_t size);
+        int available();
+        int read();
+        size_t read(uint8_t *buf, size_t size);
+        size_t readBytes(char *buf, size_t size) { return read((uint8_t*)buf, size); }
+        size_t readBytesUntil(char terminator, char *buf, size_t len);
+        void flush();
+        bool seek(uint32_t pos, SeekMode mode = SeekSet);
+        size_t position() const;
+        size_t size() const;
+        void close();
+        operator bool() const;
+        time_t getLastWrite();
+        const char *path() const;
+        const char *name() const;
+        bool isDirectory();
+        File openNextFile(const char *mode = FILE_READ);
+        void rewindDirectory();
+        int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+        size_t print(const char *s);
+        size_t print(int value);
+        size_t println(const char *s = "");
+
+    private:
+        std::shared_ptr<FileImpl> impl;
+};
+
+class FS {
+    public:
+        File open(const char *path, const char *mode = FILE_READ, bool create = false);
+        bool exists(const char *path);
+        bool remove(const char *path);
+        bool rename(const char *from, const char *to);
+        bool mkdir(const char *path);
+        bool rmdir(const char *path);
+};
+
+}
+
+using fs::File;
+using fs::FS;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef BENCH_SHIM_SD_H
+#define BENCH_SHIM_SD_H
+
+#include <FS.h>
+
+// Card faults injected into every access through SD and File
+typedef struct {
+    uint32_t latencyUs;     // Added to each open, read, write and seek
+    float stallRate;        // Share of accesses that stall for stallMs (wear levelling, GC)
+    uint32_t stallMs;
+    float failRate;         // Share of opens and writes that fail
+    bool removed;           // Card pulled - every access fails, begin() too
+} ShimFaults;
+
+void shimSetFaults(const ShimFaults &faults);
+ShimFaults shimGetFaults();
+
+class SDFS : public fs::FS {
+    public:
+        bool begin(...) { return !shimGetFaults().removed; }
+        void end() {}
+        uint64_t cardSize() { return shimGetFaults().removed ? 0 : 32ULL << 30; }
+};
+
+extern SDFS SD;
+
+// Host directory that stands for the card root
+void shimSetRoot(const char *dir);
+
+// I/O done through File since the last reset - the benchmark's "card" traffic
+typedef struct {
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint32_t opens;
+    uint32_t seeks;
+} ShimIOStats;
+
+ShimIOStats shimIOStats();
+void shimResetIOStats();
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BENCH_SHIM_QUEUE_H
+#define BENCH_SHIM_QUEUE_H
+
+#include "FreeRTOS.h"
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BENCH_SHIM_SEMPHR_H
+#define BENCH_SHIM_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+#endif
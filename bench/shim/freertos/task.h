@@ -0,0 +1,6 @@
+#ifndef BENCH_SHIM_TASK_H
+#define BENCH_SHIM_TASK_H
+
+#include "FreeRTOS.h"
+
+#endif
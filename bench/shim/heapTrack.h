@@ -0,0 +1,12 @@
+#ifndef BENCH_SHIM_HEAPTRACK_H
+#define BENCH_SHIM_HEAPTRACK_H
+
+#include <cstddef>
+
+// malloc/calloc/realloc/free of the benchmark and the modules under test, counted through
+// linker wrapping (see the Makefile) - new/delete inside the C++ runtime are not included
+size_t heapTrackCurrent();
+size_t heapTrackPeak();
+void heapTrackResetPeak();
+
+#endif
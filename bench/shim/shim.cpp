@@ -0,0 +1,573 @@
+#include <Arduino.h>
+#include <SD.h>
+#include "freertos/FreeRTOS.h"
+#include "heapTrack.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//################## Core ##################
+
+static const auto startTime = std::chrono::steady_clock::now();
+static std::atomic<uint32_t> timeScale(1);
+
+static uint64_t realMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void shimSetTimeScale(uint32_t factor) {
+    timeScale = factor > 0 ? factor : 1;
+}
+
+unsigned long millis() {
+    return realMicros() * timeScale / 1000;
+}
+
+unsigned long micros() {
+    return realMicros() * timeScale;
+}
+
+int64_t esp_timer_get_time() {
+    return realMicros() * timeScale;
+}
+
+void shimSleepUs(uint64_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us / timeScale));
+}
+
+void delay(unsigned long ms) {
+    shimSleepUs((uint64_t)ms * 1000);
+}
+
+void *ps_malloc(size_t size) {
+    return malloc(size);
+}
+
+void *ps_calloc(size_t count, size_t size) {
+    return calloc(count, size);
+}
+
+bool psramFound() {
+    return true;
+}
+
+HardwareSerialShim Serial;
+
+static bool serialEnabled() {
+    static int enabled = -1;
+    if (enabled < 0) enabled = getenv("BENCH_VERBOSE") != NULL;
+    return enabled;
+}
+
+int HardwareSerialShim::printf(const char *fmt, ...) {
+    if (!serialEnabled()) return 0;
+    va_list args;
+    va_start(args, fmt);
+    int written = vfprintf(stderr, fmt, args);
+    va_end(args);
+    return written;
+}
+
+size_t HardwareSerialShim::print(const char *s) {
+    return serialEnabled() ? fprintf(stderr, "%s", s) : 0;
+}
+
+size_t HardwareSerialShim::println(const char *s) {
+    return serialEnabled() ? fprintf(stderr, "%s\n", s) : 0;
+}
+
+//################## FreeRTOS ##################
+
+struct TaskExit {};
+
+static std::mutex tasksMutex;
+static std::vector<std::thread> tasks;
+
+// Handles tell mutexes from queues, binary semaphores are queues of empty items like in FreeRTOS
+struct ShimHandle {
+    bool isQueue;
+};
+
+struct ShimMutex : ShimHandle {
+    std::recursive_timed_mutex mutex;
+};
+
+struct ShimQueue : ShimHandle {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t itemSize;
+};
+
+// Waits on a queue condition for ticks of the shim clock, false on timeout
+template <typename Predicate>
+static bool waitTicks(ShimQueue *queue, std::unique_lock<std::mutex> &lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        queue->changed.wait(lock, ready);
+        return true;
+    }
+    auto timeout = std::chrono::microseconds((uint64_t)ticks * 1000 / timeScale);
+    return queue->changed.wait_for(lock, timeout, ready);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    ShimQueue *queue = new ShimQueue();
+    queue->isQueue = true;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t handle, const void *item, TickType_t ticks, bool front) {
+    ShimQueue *queue = (ShimQueue*)handle;
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitTicks(queue, lock, ticks, [queue]() { return queue->items.size() < queue->length; })) return pdFALSE;
+
+    std::vector<uint8_t> data((const uint8_t*)item, (const uint8_t*)item + (item ? queue->itemSize : 0));
+    if (front) {
+        queue->items.push_front(std::move(data));
+    } else {
+        queue->items.push_back(std::move(data));
+    }
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return queueSend(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return queueSend(queue, item, ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks) {
+    ShimQueue *queue = (ShimQueue*)handle;
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitTicks(queue, lock, ticks, [queue]() { return !queue->items.empty(); })) return pdFALSE;
+
+    if (item) memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+    ShimQueue *queue = (ShimQueue*)handle;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    ShimMutex *mutex = new ShimMutex();
+    mutex->isQueue = false;
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return xSemaphoreCreateMutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    if (((ShimHandle*)semaphore)->isQueue) return xQueueReceive(semaphore, NULL, ticks);
+
+    auto &mutex = ((ShimMutex*)semaphore)->mutex;
+    if (ticks == portMAX_DELAY) {
+        mutex.lock();
+        return pdTRUE;
+    }
+    return mutex.try_lock_for(std::chrono::microseconds((uint64_t)ticks * 1000 / timeScale)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (((ShimHandle*)semaphore)->isQueue) return xQueueSend(semaphore, NULL, 0);
+
+    ((ShimMutex*)semaphore)->mutex.unlock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return xSemaphoreTake(semaphore, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    return xSemaphoreGive(semaphore);
+}
+
+TickType_t xTaskGetTickCount() {
+    return millis();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackSize, void *parameter,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    tasks.emplace_back([function, parameter]() {
+        try {
+            function(parameter);
+        } catch (const TaskExit &) {
+        }
+    });
+    if (handle) *handle = NULL;
+    return pdPASS;
+}
+
+// Only self-deletion is supported, it ends the task's thread
+void vTaskDelete(TaskHandle_t handle) {
+    if (handle == NULL) throw TaskExit();
+}
+
+void shimJoinTasks() {
+    while (true) {
+        std::thread task;
+        {
+            std::lock_guard<std::mutex> lock(tasksMutex);
+            if (tasks.empty()) return;
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        task.join();
+    }
+}
+
+//################## File system ##################
+
+SDFS SD;
+
+static std::string rootDir = ".";
+static ShimIOStats ioStats;
+static std::mutex ioStatsMutex;
+
+void shimSetRoot(const char *dir) {
+    rootDir = dir;
+    while (rootDir.size() > 1 && rootDir.back() == '/') rootDir.pop_back();
+}
+
+ShimIOStats shimIOStats() {
+    std::lock_guard<std::mutex> lock(ioStatsMutex);
+    return ioStats;
+}
+
+void shimResetIOStats() {
+    std::lock_guard<std::mutex> lock(ioStatsMutex);
+    ioStats = ShimIOStats();
+}
+
+static void countIO(uint64_t read, uint64_t written, uint32_t opens, uint32_t seeks) {
+    std::lock_guard<std::mutex> lock(ioStatsMutex);
+    ioStats.bytesRead += read;
+    ioStats.bytesWritten += written;
+    ioStats.opens += opens;
+    ioStats.seeks += seeks;
+}
+
+static ShimFaults faults;
+static std::mutex faultsMutex;
+static std::mt19937 faultRandom(1);
+
+void shimSetFaults(const ShimFaults &newFaults) {
+    std::lock_guard<std::mutex> lock(faultsMutex);
+    faults = newFaults;
+}
+
+ShimFaults shimGetFaults() {
+    std::lock_guard<std::mutex> lock(faultsMutex);
+    return faults;
+}
+
+// Latency and stalls of one card access, false if the access fails
+static bool cardAccess(bool mayFail) {
+    ShimFaults current;
+    bool stall, fail;
+    {
+        std::lock_guard<std::mutex> lock(faultsMutex);
+        current = faults;
+        std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+        stall = current.stallRate > 0 && chance(faultRandom) < current.stallRate;
+        fail = mayFail && current.failRate > 0 && chance(faultRandom) < current.failRate;
+    }
+    uint64_t us = current.latencyUs + (stall ? (uint64_t)current.stallMs * 1000 : 0);
+    if (us > 0) shimSleepUs(us);
+    return !current.removed && !fail;
+}
+
+static std::string hostPath(const char *path) {
+    return rootDir + (path[0] == '/' ? "" : "/") + path;
+}
+
+namespace fs {
+
+struct FileImpl {
+    std::string path;       // Card path
+    FILE *fp = NULL;
+    DIR *dir = NULL;
+
+    ~FileImpl() {
+        if (fp) fclose(fp);
+        if (dir) closedir(dir);
+    }
+};
+
+static std::shared_ptr<FileImpl> openImpl(const char *path, const char *mode) {
+    if (!cardAccess(true)) return nullptr;
+    std::string host = hostPath(path);
+    auto impl = std::make_shared<FileImpl>();
+    impl->path = path;
+
+    struct stat st;
+    if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        impl->dir = opendir(host.c_str());
+        return impl->dir ? impl : nullptr;
+    }
+
+    // Binary stdio modes, "r+" keeps its meaning
+    std::string hostMode = mode;
+    hostMode += "b";
+    impl->fp = fopen(host.c_str(), hostMode.c_str());
+    if (!impl->fp) return nullptr;
+    countIO(0, 0, 1, 0);
+    return impl;
+}
+
+File FS::open(const char *path, const char *mode, bool create) {
+    return File(openImpl(path, mode));
+}
+
+bool FS::exists(const char *path) {
+    if (!cardAccess(false)) return false;
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path) {
+    if (!cardAccess(true)) return false;
+    return ::unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+    if (!cardAccess(true)) return false;
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+    if (!cardAccess(true)) return false;
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char *path) {
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size) {
+    if (!impl || !impl->fp || !cardAccess(true)) return 0;
+    size_t written = fwrite(buf, 1, size, impl->fp);
+    countIO(0, written, 0, 0);
+    return written;
+}
+
+int File::available() {
+    if (!impl || !impl->fp) return 0;
+    return (int)(size() - position());
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t size) {
+    if (!impl || !impl->fp || !cardAccess(false)) return 0;
+    size_t bytesRead = fread(buf, 1, size, impl->fp);
+    countIO(bytesRead, 0, 0, 0);
+    return bytesRead;
+}
+
+size_t File::readBytesUntil(char terminator, char *buf, size_t len) {
+    size_t count = 0;
+    while (count < len) {
+        int c = read();
+        if (c < 0 || c == terminator) break;
+        buf[count++] = (char)c;
+    }
+    return count;
+}
+
+void File::flush() {
+    if (impl && impl->fp) fflush(impl->fp);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!impl || !impl->fp || !cardAccess(false)) return false;
+    countIO(0, 0, 0, 1);
+    int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+    return fseek(impl->fp, pos, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!impl || !impl->fp) return 0;
+    long pos = ftell(impl->fp);
+    return pos < 0 ? 0 : (size_t)pos;
+}
+
+size_t File::size() const {
+    if (!impl || !impl->fp) return 0;
+    fflush(impl->fp);
+    struct stat st;
+    return fstat(fileno(impl->fp), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void File::close() {
+    impl.reset();
+}
+
+File::operator bool() const {
+    return impl != nullptr;
+}
+
+time_t File::getLastWrite() {
+    struct stat st;
+    return impl && stat(hostPath(impl->path.c_str()).c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+const char *File::path() const {
+    return impl ? impl->path.c_str() : "";
+}
+
+// Basename like the ESP32 core 2.x
+const char *File::name() const {
+    if (!impl) return "";
+    const char *slash = strrchr(impl->path.c_str(), '/');
+    return slash && slash[1] ? slash + 1 : impl->path.c_str();
+}
+
+bool File::isDirectory() {
+    return impl && impl->dir;
+}
+
+File File::openNextFile(const char *mode) {
+    if (!impl || !impl->dir) return File();
+    struct dirent *entry;
+    while ((entry = readdir(impl->dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        std::string child = impl->path;
+        if (child.empty() || child.back() != '/') child += "/";
+        child += entry->d_name;
+        return File(openImpl(child.c_str(), mode));
+    }
+    return File();
+}
+
+void File::rewindDirectory() {
+    if (impl && impl->dir) rewinddir(impl->dir);
+}
+
+int File::printf(const char *fmt, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    if (len < 0) return 0;
+    return (int)write((const uint8_t*)buffer, min((size_t)len, sizeof(buffer) - 1));
+}
+
+size_t File::print(const char *s) {
+    return write((const uint8_t*)s, strlen(s));
+}
+
+size_t File::print(int value) {
+    return printf("%d", value);
+}
+
+size_t File::println(const char *s) {
+    return print(s) + print("\n");
+}
+
+}
+
+//################## Heap tracking ##################
+
+// Linked with -Wl,--wrap=malloc,... - every block carries its size in a 16 byte header
+extern "C" {
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+void *__real_realloc(void *ptr, size_t size);
+
+static std::mutex heapMutex;
+static size_t heapCurrent = 0;
+static size_t heapPeak = 0;
+static const size_t HEAP_HEADER = 16;
+
+static void heapChanged(size_t added, size_t removed) {
+    std::lock_guard<std::mutex> lock(heapMutex);
+    heapCurrent = heapCurrent + added - removed;
+    heapPeak = max(heapPeak, heapCurrent);
+}
+
+void *__wrap_malloc(size_t size) {
+    uint8_t *block = (uint8_t*)__real_malloc(size + HEAP_HEADER);
+    if (!block) return NULL;
+    *(size_t*)block = size;
+    heapChanged(size, 0);
+    return block + HEAP_HEADER;
+}
+
+void __wrap_free(void *ptr) {
+    if (!ptr) return;
+    uint8_t *block = (uint8_t*)ptr - HEAP_HEADER;
+    heapChanged(0, *(size_t*)block);
+    __real_free(block);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    void *ptr = __wrap_malloc(count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    if (!ptr) return __wrap_malloc(size);
+    uint8_t *block = (uint8_t*)ptr - HEAP_HEADER;
+    size_t oldSize = *(size_t*)block;
+    block = (uint8_t*)__real_realloc(block, size + HEAP_HEADER);
+    if (!block) return NULL;
+    *(size_t*)block = size;
+    heapChanged(size, oldSize);
+    return block + HEAP_HEADER;
+}
+}
+
+size_t heapTrackCurrent() {
+    std::lock_guard<std::mutex> lock(heapMutex);
+    return heapCurrent;
+}
+
+size_t heapTrackPeak() {
+    std::lock_guard<std::mutex> lock(heapMutex);
+    return heapPeak;
+}
+
+void heapTrackResetPeak() {
+    std::lock_guard<std::mutex> lock(heapMutex);
+    heapPeak = heapCurrent;
+}
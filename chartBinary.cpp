@@ -0,0 +1,311 @@
+#include "chartBinary.h"
+#include "logHotCache.h"
+
+typedef struct {
+    int32_t bucketStart;
+    int16_t temperature;
+    int16_t humidity;
+    int16_t pressure;
+} ChartPoint;
+
+// Extremes of one field within a decimation column
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int32_t minTs;
+    int32_t maxTs;
+    bool valid;
+} ChartExtreme;
+
+enum { FIELD_TEMPERATURE = 0, FIELD_HUMIDITY, FIELD_PRESSURE, FIELD_COUNT };
+
+typedef struct {
+    ChartPoint *points;
+    size_t count;
+    size_t maxPoints;
+    size_t dtWords;
+    int32_t step;
+    bool hasPressure;
+
+    // Min/max decimation, columnWidth 0 for bucket averages
+    int32_t columnStart;
+    int32_t columnWidth;
+    int32_t column;             // Column being collected, -1 if none
+    ChartExtreme extremes[FIELD_COUNT];
+} ChartSeries;
+
+// Rounded mean in the same fixed point scale
+static int16_t average(int32_t sum, uint32_t count) {
+    if (count == 0) return CHART_BINARY_NO_VALUE;
+    int32_t half = count / 2;
+    return (sum >= 0 ? sum + half : sum - half) / (int32_t)count;
+}
+
+static void addPoint(ChartSeries &series, int32_t bucketStart, int16_t temperature, int16_t humidity, int16_t pressure) {
+    if (series.count >= series.maxPoints) return;
+    if (series.count > 0) {
+        int32_t previous = series.points[series.count - 1].bucketStart;
+        if (bucketStart <= previous) return;
+        uint32_t steps = (bucketStart - previous) / series.step;
+        series.dtWords += steps >= 1 && steps <= 0xFFFF ? 1 : 3;
+    } else {
+        series.dtWords = 1;
+    }
+
+    ChartPoint &point = series.points[series.count++];
+    point.bucketStart = bucketStart;
+    point.temperature = temperature;
+    point.humidity = humidity;
+    point.pressure = pressure;
+    if (pressure != CHART_BINARY_NO_VALUE) series.hasPressure = true;
+}
+
+static void addExtreme(ChartSeries &series, int field, int16_t min, int32_t minTs, int16_t max, int32_t maxTs) {
+    ChartExtreme &extreme = series.extremes[field];
+    if (!extreme.valid || min < extreme.min) {
+        extreme.min = min;
+        extreme.minTs = minTs;
+    }
+    if (!extreme.valid || max > extreme.max) {
+        extreme.max = max;
+        extreme.maxTs = maxTs;
+    }
+    extreme.valid = true;
+}
+
+// Earlier (second false) or later extreme of a field
+static int16_t extremeValue(const ChartExtreme &extreme, bool second) {
+    if (!extreme.valid) return CHART_BINARY_NO_VALUE;
+    return (extreme.minTs <= extreme.maxTs) != second ? extreme.min : extreme.max;
+}
+
+// Column complete - up to two points at the times of the temperature extremes
+static void flushColumn(ChartSeries &series) {
+    if (series.column < 0) return;
+    const ChartExtreme &temperature = series.extremes[FIELD_TEMPERATURE];
+    if (temperature.valid) {
+        int32_t first = min(temperature.minTs, temperature.maxTs);
+        int32_t second = max(temperature.minTs, temperature.maxTs);
+        for (int point = 0; point < 2; point++) {
+            int32_t timestamp = point ? second : first;
+            timestamp -= timestamp % series.step;
+            if (point && series.count > 0 && timestamp <= series.points[series.count - 1].bucketStart) break;
+            addPoint(series, timestamp, extremeValue(series.extremes[FIELD_TEMPERATURE], point),
+                     extremeValue(series.extremes[FIELD_HUMIDITY], point),
+                     extremeValue(series.extremes[FIELD_PRESSURE], point));
+        }
+    }
+    memset(series.extremes, 0, sizeof(series.extremes));
+    series.column = -1;
+}
+
+// Starts the column of timestamp, the previous one is written out
+static void enterColumn(ChartSeries &series, int32_t timestamp) {
+    int32_t column = timestamp > series.columnStart ? (timestamp - series.columnStart) / series.columnWidth : 0;
+    if (column != series.column) {
+        flushColumn(series);
+        series.column = column;
+    }
+}
+
+// Records in time order folded into tier buckets - same buckets and values the rollup produces;
+// decimated series take every record into its column instead
+template <typename Reader>
+static void foldRecords(Reader &reader, int32_t start, int32_t end, LogRollupTier tier, ChartSeries &series) {
+    if (series.columnWidth > 0) {
+        LogRecord rec;
+        while (reader.next(rec)) {
+            if (rec.timestamp < start || rec.timestamp > end) continue;
+            enterColumn(series, rec.timestamp);
+            addExtreme(series, FIELD_TEMPERATURE, rec.temperature, rec.timestamp, rec.temperature, rec.timestamp);
+            addExtreme(series, FIELD_HUMIDITY, rec.humidity, rec.timestamp, rec.humidity, rec.timestamp);
+            if (rec.flags & LOG_FLAG_HAS_PRESSURE) {
+                addExtreme(series, FIELD_PRESSURE, rec.pressure, rec.timestamp, rec.pressure, rec.timestamp);
+            }
+        }
+        flushColumn(series);
+        return;
+    }
+
+    int32_t bucket = 0;
+    uint32_t count = 0, pressureCount = 0;
+    int32_t tempSum = 0, humiditySum = 0, pressureSum = 0;
+
+    LogRecord rec;
+    bool more = true;
+    while (more) {
+        more = reader.next(rec);
+        if (more && (rec.timestamp < start || rec.timestamp > end)) continue;
+        int32_t recordBucket = more ? logRollupBucketStart(rec.timestamp, tier) : 0;
+
+        // Bucket complete
+        if (count > 0 && (!more || recordBucket != bucket)) {
+            addPoint(series, bucket, average(tempSum, count), average(humiditySum, count),
+                     average(pressureSum, pressureCount));
+            count = pressureCount = 0;
+            tempSum = humiditySum = pressureSum = 0;
+        }
+        if (!more) break;
+
+        bucket = recordBucket;
+        tempSum += rec.temperature;
+        humiditySum += rec.humidity;
+        if (rec.flags & LOG_FLAG_HAS_PRESSURE) {
+            pressureSum += rec.pressure;
+            pressureCount++;
+        }
+        count++;
+    }
+}
+
+static bool foldRollup(const char *sensor, int32_t start, int32_t end, LogRollupTier tier, ChartSeries &series) {
+    LogRollupReader rollup;
+    if (!rollup.open(sensor, tier)) return false;
+
+    rollup.seek(start);
+    LogRollupRow row;
+    while (rollup.next(row)) {
+        if (row.bucketStart > end) break;
+        if (row.count == 0 || row.bucketStart + logRollupTierSeconds[tier] <= start) continue;
+        if (series.columnWidth > 0) {
+            // Rows keep the extremes of their records, with the times they occurred
+            enterColumn(series, row.bucketStart);
+            addExtreme(series, FIELD_TEMPERATURE, row.temperature.min, row.temperature.minTs,
+                       row.temperature.max, row.temperature.maxTs);
+            addExtreme(series, FIELD_HUMIDITY, row.humidity.min, row.humidity.minTs,
+                       row.humidity.max, row.humidity.maxTs);
+            if (row.pressureCount > 0) {
+                addExtreme(series, FIELD_PRESSURE, row.pressure.min, row.pressure.minTs,
+                           row.pressure.max, row.pressure.maxTs);
+            }
+            continue;
+        }
+        addPoint(series, row.bucketStart, average(row.temperature.sum, row.count),
+                 average(row.humidity.sum, row.count), average(row.pressure.sum, row.pressureCount));
+    }
+    flushColumn(series);
+    rollup.close();
+    return true;
+}
+
+// Hot cache for recent ranges, else the rollup tier, else the raw log; a sensor without data stays empty
+static void collectSeries(const char *sensor, int32_t start, int32_t end, LogRollupTier tier, ChartSeries &series) {
+    LogHotCacheReader hotCache;
+    if (logHotCacheCovers(sensor, start) && hotCache.open(sensor, start, end)) {
+        foldRecords(hotCache, start, end, tier, series);
+        return;
+    }
+    if (foldRollup(sensor, start, end, tier, series)) return;
+
+    LogQuery query;
+    if (query.open(sensor, start, end)) {
+        foldRecords(query, start, end, tier, series);
+        query.close();
+    }
+}
+
+static uint8_t* put16(uint8_t *out, uint16_t value) {
+    memcpy(out, &value, 2);
+    return out + 2;
+}
+
+static uint8_t* put32(uint8_t *out, uint32_t value) {
+    memcpy(out, &value, 4);
+    return out + 4;
+}
+
+static uint8_t* writeSeries(uint8_t *out, const ChartSeries &series) {
+    out = put32(out, series.count);
+    out = put32(out, series.dtWords);
+    out = put32(out, series.count > 0 ? series.points[0].bucketStart : 0);
+    *out++ = series.hasPressure ? CHART_BINARY_PRESSURE : 0;
+    *out++ = 0;
+    *out++ = 0;
+    *out++ = 0;
+
+    for (size_t i = 0; i < series.count; i++) {
+        uint32_t steps = i > 0 ? (series.points[i].bucketStart - series.points[i - 1].bucketStart) / series.step : 0;
+        if (i > 0 && (steps == 0 || steps > 0xFFFF)) {
+            out = put16(out, 0);
+            out = put16(out, steps & 0xFFFF);
+            out = put16(out, steps >> 16);
+        } else {
+            out = put16(out, steps);
+        }
+    }
+    for (size_t i = 0; i < series.count; i++) out = put16(out, series.points[i].temperature);
+    for (size_t i = 0; i < series.count; i++) out = put16(out, series.points[i].humidity);
+    if (series.hasPressure) {
+        for (size_t i = 0; i < series.count; i++) out = put16(out, series.points[i].pressure);
+    }
+    return out;
+}
+
+bool chartBinaryBuild(const char *const *sensors, size_t sensorCount, int32_t start, int32_t end,
+                      LogRollupTier tier, uint32_t targetPoints, ChartBinary &payload) {
+    payload.data = NULL;
+    payload.size = 0;
+    if (sensorCount == 0 || sensorCount > 255 || end < start) return false;
+
+    // Decimated - columns of at least one step, rollup rows from the finest tier the pass can afford
+    int32_t step = logRollupTierSeconds[tier];
+    int32_t columnWidth = 0;
+    size_t maxPoints;
+    if (targetPoints > 0) {
+        int32_t columns = max(targetPoints / 2, (uint32_t)1);
+        step = CHART_BINARY_DECIMATED_STEP;
+        columnWidth = max((end - start) / columns + 1, step);
+        tier = logRollupTierForRange(end - start, CHART_BINARY_SOURCE_ROWS);
+        maxPoints = min((size_t)targetPoints + 2, (size_t)CHART_BINARY_MAX_POINTS);
+    } else {
+        maxPoints = min((size_t)((end - start) / step + 2), (size_t)CHART_BINARY_MAX_POINTS);
+    }
+
+    ChartSeries *series = (ChartSeries*)calloc(sensorCount, sizeof(ChartSeries));
+    ChartPoint *points = (ChartPoint*)ps_malloc(sensorCount * maxPoints * sizeof(ChartPoint));
+    if (!points) points = (ChartPoint*)malloc(sensorCount * maxPoints * sizeof(ChartPoint));
+    if (!series || !points) {
+        Serial.printf("[ERROR] Failed to allocate %u chart points\n", (unsigned)(sensorCount * maxPoints));
+        free(series);
+        free(points);
+        return false;
+    }
+
+    size_t size = 8;
+    for (size_t s = 0; s < sensorCount; s++) {
+        series[s].points = points + s * maxPoints;
+        series[s].maxPoints = maxPoints;
+        series[s].step = step;
+        series[s].columnStart = start;
+        series[s].columnWidth = columnWidth;
+        series[s].column = -1;
+        collectSeries(sensors[s], start, end, tier, series[s]);
+        size += 16 + series[s].dtWords * 2 + series[s].count * 2 * (series[s].hasPressure ? 3 : 2);
+    }
+
+    payload.data = (uint8_t*)ps_malloc(size);
+    if (!payload.data) payload.data = (uint8_t*)malloc(size);
+    if (payload.data) {
+        uint8_t *out = payload.data;
+        *out++ = CHART_BINARY_VERSION;
+        *out++ = sensorCount;
+        out = put16(out, 0);
+        out = put32(out, step);
+        for (size_t s = 0; s < sensorCount; s++) {
+            out = writeSeries(out, series[s]);
+        }
+        payload.size = out - payload.data;
+    } else {
+        Serial.printf("[ERROR] Failed to allocate %u byte chart payload\n", (unsigned)size);
+    }
+
+    free(points);
+    free(series);
+    return payload.data != NULL;
+}
+
+void chartBinaryFree(ChartBinary &payload) {
+    free(payload.data);
+    payload.data = NULL;
+    payload.size = 0;
+}
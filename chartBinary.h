@@ -0,0 +1,50 @@
+#ifndef CHARTBINARY_H
+#define CHARTBINARY_H
+
+#include <Arduino.h>
+#include "logStorage.h"
+#include "logRollup.h"
+
+// Columnar binary chart payload - /chart-data?fmt=bin, decoded with DataView by index.html.
+// Values stay in the log's fixed point scales, so the device does no float formatting and a
+// point takes 6-8 bytes instead of ~45 characters of JSON. All fields little endian:
+//   header     uint8 version, uint8 seriesCount, uint16 reserved, int32 step (seconds)
+//   per series uint32 count, uint32 dtWords, int32 baseTs, uint8 flags, uint8 reserved[3]
+//              uint16 dt[dtWords]  point time in steps after the previous one (first 0);
+//                                  0 after the first is an escape, uint32 steps follow as lo, hi
+//              int16 T[count]      °C * LOG_TEMP_SCALE
+//              int16 H[count]      % * LOG_HUMIDITY_SCALE
+//              int16 P[count]      hPa * LOG_PRESSURE_SCALE, only with CHART_BINARY_PRESSURE
+// A missing value is CHART_BINARY_NO_VALUE. Points are bucket starts, step the bucket length.
+//
+// With a target point count the series are min/max decimated instead of bucket averaged: the
+// range is split into targetPoints / 2 columns (one per pixel for twice the chart width) and each
+// column gives two points - the first carries every field's earlier extreme, the second its
+// later one - so spikes like frost dips survive any zoom level. Point times are those of the
+// temperature extremes, on a CHART_BINARY_DECIMATED_STEP grid. Raw records are decimated where
+// the hot cache or the log is the source, rollup rows through their own min/max otherwise.
+
+#define CHART_BINARY_VERSION 1
+#define CHART_BINARY_PRESSURE 0x01      // Series flag - P column present
+#define CHART_BINARY_NO_VALUE INT16_MIN
+#define CHART_BINARY_MAX_POINTS 8192    // Per series, later buckets are cut off
+#define CHART_BINARY_DECIMATED_STEP 10  // Log timestamps are rounded to 10 s
+
+// Finest rollup tier read for a decimated range - bounds the single pass over the card
+#ifndef CHART_BINARY_SOURCE_ROWS
+#define CHART_BINARY_SOURCE_ROWS 2048
+#endif
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} ChartBinary;
+
+// Series of the sensors over [start, end] - each from the hot cache, the rollup or the raw log,
+// whichever is available first. Averages per bucket of tier with targetPoints 0, else at most
+// targetPoints min/max decimated points; free the payload with chartBinaryFree()
+bool chartBinaryBuild(const char *const *sensors, size_t sensorCount, int32_t start, int32_t end,
+                      LogRollupTier tier, uint32_t targetPoints, ChartBinary &payload);
+void chartBinaryFree(ChartBinary &payload);
+
+#endif /* CHARTBINARY_H */
@@ -0,0 +1,324 @@
+#include "chartCache.h"
+
+typedef struct {
+    char path[48];
+    uint16_t count;             // Responses streaming the file, 0 = free entry
+} ChartCachePin;
+
+static ChartCachePin pins[CHART_CACHE_MAX_PINS];
+static SemaphoreHandle_t pinMutex = NULL;
+
+static void lockPins() {
+    if (pinMutex == NULL) {
+        pinMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(pinMutex, portMAX_DELAY);
+}
+
+static void unlockPins() {
+    xSemaphoreGive(pinMutex);
+}
+
+//################## Pins ##################
+
+bool chartCachePin(const char *path) {
+    lockPins();
+    ChartCachePin *entry = NULL;
+    for (int i = 0; i < CHART_CACHE_MAX_PINS; i++) {
+        if (pins[i].count > 0 && strcmp(pins[i].path, path) == 0) {
+            entry = &pins[i];
+            break;
+        }
+        if (pins[i].count == 0 && entry == NULL) entry = &pins[i];
+    }
+    if (entry != NULL && entry->count == 0) {
+        memset(entry->path, 0, sizeof(entry->path));
+        strncpy(entry->path, path, sizeof(entry->path) - 1);
+    }
+    if (entry != NULL) entry->count++;
+    unlockPins();
+    return entry != NULL;
+}
+
+void chartCacheUnpin(const char *path) {
+    lockPins();
+    for (int i = 0; i < CHART_CACHE_MAX_PINS; i++) {
+        if (pins[i].count > 0 && strcmp(pins[i].path, path) == 0) {
+            pins[i].count--;
+            break;
+        }
+    }
+    unlockPins();
+}
+
+bool chartCachePinned(const char *path) {
+    bool pinned = false;
+    lockPins();
+    for (int i = 0; i < CHART_CACHE_MAX_PINS; i++) {
+        if (pins[i].count > 0 && strcmp(pins[i].path, path) == 0) {
+            pinned = true;
+            break;
+        }
+    }
+    unlockPins();
+    return pinned;
+}
+
+//################## Cache file ##################
+
+// One chart point, same layout streamProcessLogToJSON writes
+static size_t formatPoint(const LogRollupRow &row, bool isOutside, char *buffer, size_t len) {
+    int written;
+    float temperature = round(logRollupAverage(row.temperature, row.count, LOG_TEMP_SCALE) * 10.0) / 10.0;
+    float humidity = round(logRollupAverage(row.humidity, row.count, LOG_HUMIDITY_SCALE) * 10.0) / 10.0;
+    if (isOutside) {
+        float pressure = round(logRollupAverage(row.pressure, row.pressureCount, LOG_PRESSURE_SCALE) * 10.0) / 10.0;
+        written = snprintf(buffer, len, "{\"tS\":%d,\"T\":%.1f,\"H\":%.1f,\"P\":%.1f}",
+                           (int)row.bucketStart, temperature, humidity, pressure);
+    } else {
+        written = snprintf(buffer, len, "{\"tS\":%d,\"T\":%.1f,\"H\":%.1f}",
+                           (int)row.bucketStart, temperature, humidity);
+    }
+    if (written < 0) return 0;
+    return min((size_t)written, len - 1);
+}
+
+static bool loadMeta(const char *metaPath, ChartCacheMeta &meta) {
+    File file = SD.open(metaPath, FILE_READ);
+    if (!file) return false;
+    bool ok = file.read((uint8_t*)&meta, sizeof(meta)) == sizeof(meta) && meta.magic == CHART_CACHE_MAGIC;
+    file.close();
+    return ok;
+}
+
+static bool saveMeta(const char *metaPath, const ChartCacheMeta &meta) {
+    File file = SD.open(metaPath, FILE_WRITE);
+    if (!file) return false;
+    bool ok = file.write((const uint8_t*)&meta, sizeof(meta)) == sizeof(meta);
+    file.close();
+    return ok;
+}
+
+// Starts an empty window
+static bool resetCache(const char *jsonPath, ChartCacheMeta &meta, LogRollupTier tier, bool isOutside) {
+    File file = SD.open(jsonPath, FILE_WRITE);
+    if (!file) return false;
+    file.print("[]");
+    file.close();
+
+    memset(&meta, 0, sizeof(meta));
+    meta.magic = CHART_CACHE_MAGIC;
+    meta.tier = tier;
+    meta.isOutside = isOutside;
+    meta.lastBucket = INT32_MIN;
+    meta.headOffset = 1;
+    meta.liveCount = 0;
+    return true;
+}
+
+// Starts an empty window at the closing ']' without touching the bytes before it - the old
+// points become dead prefix; false if the file doesn't end like a cache file
+static bool restartAtEnd(const char *jsonPath, ChartCacheMeta &meta, LogRollupTier tier, bool isOutside) {
+    File file = SD.open(jsonPath, FILE_READ);
+    if (!file) return false;
+    size_t size = file.size();
+    bool closed = size >= 2 && file.seek(size - 1) && file.read() == ']';
+    file.close();
+    if (!closed) return false;
+
+    memset(&meta, 0, sizeof(meta));
+    meta.magic = CHART_CACHE_MAGIC;
+    meta.tier = tier;
+    meta.isOutside = isOutside;
+    meta.lastBucket = INT32_MIN;
+    meta.headOffset = size - 1;
+    meta.liveCount = 0;
+    return true;
+}
+
+// Appends settled buckets newer than meta.lastBucket in place of the closing ']'
+static bool appendSettled(const char *jsonPath, ChartCacheMeta &meta, LogRollupReader &rollup,
+                          int32_t windowStart, int32_t settledBefore) {
+    LogRollupTier tier = (LogRollupTier)meta.tier;
+    rollup.seek(max(meta.lastBucket, windowStart));
+
+    File file = SD.open(jsonPath, "r+");
+    if (!file || file.size() < 2 || !file.seek(file.size() - 1)) {
+        if (file) file.close();
+        return false;
+    }
+
+    char point[80];
+    uint32_t appended = 0;
+    LogRollupRow row;
+    while (rollup.next(row)) {
+        if (row.count == 0 || row.bucketStart <= meta.lastBucket ||
+            row.bucketStart + logRollupTierSeconds[tier] <= windowStart) continue;
+        if (row.bucketStart + logRollupTierSeconds[tier] > settledBefore) break;
+
+        if (meta.liveCount > 0) file.print(",");
+        size_t len = formatPoint(row, meta.isOutside, point, sizeof(point));
+        file.write((uint8_t*)point, len);
+
+        meta.lastBucket = row.bucketStart;
+        meta.liveCount++;
+        appended++;
+    }
+    file.print("]");
+    file.close();
+
+    if (appended > 0) {
+        Serial.printf("[DEBUG] Chart cache %s: %u points appended\n", jsonPath, (unsigned)appended);
+    }
+    return true;
+}
+
+// Moves the head past points that fell out of the window - reads the expired prefix only
+static void trimExpired(const char *jsonPath, ChartCacheMeta &meta, int32_t windowStart) {
+    if (meta.liveCount == 0) return;
+
+    File file = SD.open(jsonPath, FILE_READ);
+    if (!file || !file.seek(meta.headOffset)) {
+        if (file) file.close();
+        return;
+    }
+
+    int32_t tierSeconds = logRollupTierSeconds[meta.tier];
+    char point[80];
+    uint32_t dropped = 0;
+    while (meta.liveCount > 0) {
+        size_t len = file.readBytesUntil('}', point, sizeof(point) - 1);
+        point[len] = '\0';
+
+        int timestamp;
+        if (len == 0 || sscanf(point, "{\"tS\":%d", &timestamp) != 1 ||
+            timestamp + tierSeconds > windowStart) break;
+
+        // Whole window expired - empty window at the closing ']', appending continues after
+        // lastBucket; the dead prefix goes with the next compaction
+        if (meta.liveCount == 1) {
+            meta.headOffset = file.size() - 1;
+            meta.liveCount = 0;
+            dropped++;
+            break;
+        }
+
+        // Point plus its '}' and the ',' separator
+        meta.headOffset += len + 2;
+        meta.liveCount--;
+        dropped++;
+        file.read();
+    }
+    file.close();
+
+    if (dropped > 0) {
+        Serial.printf("[DEBUG] Chart cache %s: %u expired points dropped\n", jsonPath, (unsigned)dropped);
+    }
+}
+
+// Rewrites the file without the dead prefix once it dominates the file and no response reads it
+static void compactIfNeeded(const char *jsonPath, ChartCacheMeta &meta) {
+    if (chartCachePinned(jsonPath)) return;
+
+    File file = SD.open(jsonPath, FILE_READ);
+    if (!file) return;
+
+    size_t size = file.size();
+    if (meta.headOffset < CHART_CACHE_COMPACT_BYTES || meta.headOffset < size / 2) {
+        file.close();
+        return;
+    }
+
+    char tempPath[40];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", jsonPath);
+    File output = SD.open(tempPath, FILE_WRITE);
+    if (!output) {
+        file.close();
+        return;
+    }
+
+    output.print("[");
+    file.seek(meta.headOffset);
+    uint8_t buffer[512];
+    size_t bytesRead;
+    while ((bytesRead = file.read(buffer, sizeof(buffer))) > 0) {
+        output.write(buffer, bytesRead);
+    }
+    file.close();
+    output.close();
+
+    SD.remove(jsonPath);
+    SD.rename(tempPath, jsonPath);
+    Serial.printf("[INFO] Chart cache %s compacted, %u dead bytes removed\n", jsonPath, (unsigned)(meta.headOffset - 1));
+    meta.headOffset = 1;
+}
+
+bool chartCacheRefresh(const char *sensor, const char *range, int32_t rangeSeconds, LogRollupTier tier,
+                       bool isOutside, ChartCacheWindow &window) {
+    char jsonPath[32], metaPath[32];
+    snprintf(jsonPath, sizeof(jsonPath), "/%s_%s.json", sensor, range);
+    snprintf(metaPath, sizeof(metaPath), "/%s_%s.meta", sensor, range);
+
+    // No rollup - the caller regenerates the JSON file in full, which invalidates the cache state
+    LogRollupReader rollup;
+    if (!rollup.open(sensor, tier)) {
+        SD.remove(metaPath);
+        return false;
+    }
+
+    int32_t now = time(nullptr);
+    int32_t windowStart = now - rangeSeconds;
+    int32_t settledBefore = now - CHART_CACHE_SETTLE_S;
+
+    // Cache written by other code (full regeneration), for a different tier or before late
+    // records changed settled buckets starts over
+    ChartCacheMeta meta;
+    File file = SD.open(jsonPath, FILE_READ);
+    size_t size = file ? file.size() : 0;
+    if (file) file.close();
+    if (!loadMeta(metaPath, meta) || meta.tier != tier || meta.isOutside != isOutside ||
+        meta.rollupRevision != rollup.revision() || size < 2 || meta.headOffset > size - 1) {
+        bool pinned = chartCachePinned(jsonPath);
+        if (pinned ? !restartAtEnd(jsonPath, meta, tier, isOutside) : !resetCache(jsonPath, meta, tier, isOutside)) {
+            SD.remove(metaPath);
+            return false;
+        }
+        meta.rollupRevision = rollup.revision();
+    }
+
+    if (!appendSettled(jsonPath, meta, rollup, windowStart, settledBefore)) {
+        SD.remove(metaPath);
+        return false;
+    }
+    trimExpired(jsonPath, meta, windowStart);
+    compactIfNeeded(jsonPath, meta);
+    saveMeta(metaPath, meta);
+
+    // Live window from the file without its closing ']'
+    file = SD.open(jsonPath, FILE_READ);
+    if (!file) return false;
+    size = file.size();
+    file.close();
+    memset(window.path, 0, sizeof(window.path));
+    strncpy(window.path, jsonPath, sizeof(window.path) - 1);
+    window.offset = meta.headOffset;
+    window.length = size > meta.headOffset + 1 ? size - 1 - meta.headOffset : 0;
+
+    // Unsettled tail straight from the rollup
+    char point[80];
+    bool hasPoints = meta.liveCount > 0;
+    window.tail = "";
+    rollup.seek(max(meta.lastBucket, windowStart));
+    LogRollupRow row;
+    while (rollup.next(row)) {
+        if (row.count == 0 || row.bucketStart <= meta.lastBucket ||
+            row.bucketStart + logRollupTierSeconds[tier] <= windowStart) continue;
+
+        if (hasPoints) window.tail += ",";
+        formatPoint(row, isOutside, point, sizeof(point));
+        window.tail += point;
+        hasPoints = true;
+    }
+    rollup.close();
+    return true;
+}
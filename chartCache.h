@@ -0,0 +1,56 @@
+#ifndef CHARTCACHE_H
+#define CHARTCACHE_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include "logRollup.h"
+#include "logWriteBuffer.h"
+
+// Incremental chart JSON cache for the fixed /chart-data ranges (24h, week, month, year)
+// /<sensor>_<range>.json holds a sliding window of settled rollup buckets as a JSON array,
+// /<sensor>_<range>.meta remembers the last bucket written and where the live window starts.
+// A refresh appends only buckets completed since the last one and drops expired leading ones
+// by moving the head offset - the file is rewritten only once the dead prefix outgrows the rest.
+// Buckets newer than the settle time (still fed by the write-behind buffer) are never cached,
+// they're rendered from the rollup tail on every request. A late record that changes a settled
+// bucket bumps the rollup's revision, the cache then starts over from the rollup.
+// Responses copy the file while later requests refresh it, so a file pinned by a response is
+// never rewritten: appends go past its window, a restart begins a new window at the end and
+// compaction waits until the last response is done.
+
+#define CHART_CACHE_MAGIC 0x4843574A    // "JWCH" little endian
+#define CHART_CACHE_SETTLE_S LOG_ROLLUP_SETTLE_S
+#define CHART_CACHE_COMPACT_BYTES 8192  // Rewrite once the dead prefix is this large and over half the file
+#define CHART_CACHE_MAX_PINS 16         // Files being streamed at once
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t tier;               // LogRollupTier the points come from
+    uint8_t isOutside;          // Points carry pressure
+    uint16_t reserved;
+    int32_t lastBucket;         // Start of the newest bucket in the file, INT32_MIN when empty
+    uint32_t headOffset;        // Offset of the first live point
+    uint32_t liveCount;         // Points from headOffset to the end
+    uint32_t rollupRevision;    // LogRollupReader::revision() the points were read at
+} ChartCacheMeta;
+
+// Live window of a refreshed cache - the JSON array is "[", bytes [offset, offset + length) of
+// path, then tail (points of unsettled buckets, comma-led if the file part has points) and "]"
+typedef struct {
+    char path[32];
+    uint32_t offset;
+    uint32_t length;
+    String tail;
+} ChartCacheWindow;
+
+// Brings the cache of one sensor/range up to date, the file part is streamed by the caller
+bool chartCacheRefresh(const char *sensor, const char *range, int32_t rangeSeconds, LogRollupTier tier,
+                       bool isOutside, ChartCacheWindow &window);
+
+// Chart JSON files (cache or generated) a response is copying from - pinned files must not be
+// rewritten or removed; false if the pin table is full
+bool chartCachePin(const char *path);
+void chartCacheUnpin(const char *path);
+bool chartCachePinned(const char *path);
+
+#endif /* CHARTCACHE_H */
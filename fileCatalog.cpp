@@ -0,0 +1,167 @@
+#include "fileCatalog.h"
+#include "logStorage.h"
+#include "sdStats.h"
+#include <time.h>
+
+// Sorted by path - shared between the web server, SDLogTask and the maintenance task
+static FileCatalogEntry *entries = NULL;
+static size_t entryCount = 0;
+static bool catalogBuilt = false;
+static SemaphoreHandle_t catalogMutex = NULL;
+
+static void lockCatalog() {
+    if (catalogMutex == NULL) {
+        catalogMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+}
+
+static void unlockCatalog() {
+    xSemaphoreGive(catalogMutex);
+}
+
+static bool endsWith(const char *name, const char *suffix) {
+    size_t nameLen = strlen(name);
+    size_t suffixLen = strlen(suffix);
+    return nameLen >= suffixLen && strcmp(name + nameLen - suffixLen, suffix) == 0;
+}
+
+static const char* baseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+uint8_t fileCatalogKind(const char *path) {
+    const char *name = baseName(path);
+    size_t dirLen = name - path;
+
+    if (dirLen == strlen(LOG_ARCHIVE_DIR) + 1 && strncmp(path, LOG_ARCHIVE_DIR "/", dirLen) == 0) {
+        return endsWith(name, ".bin") || endsWith(name, ".arc") ? FILE_KIND_ARCHIVED : 0;
+    }
+    if (dirLen != 1 || path[0] != '/') return 0;
+
+    if (endsWith(name, "_log.csv")) return FILE_KIND_CSV_BACKUP;
+    if (endsWith(name, "_log.bin")) return FILE_KIND_LEGACY_LOG;
+    if (strstr(name, "_custom_") != NULL && endsWith(name, ".json")) return FILE_KIND_CUSTOM_JSON;
+    if (endsWith(name, ".zip")) return FILE_KIND_ZIP;
+    return 0;
+}
+
+static int findEntry(const char *path) {
+    for (size_t i = 0; i < entryCount; i++) {
+        if (strcmp(entries[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+// Inserts or refreshes an entry, caller holds the lock
+static void putEntry(const char *path, uint8_t kind, time_t modified) {
+    if (strlen(path) >= FILE_CATALOG_PATH_MAX) return;
+
+    int index = findEntry(path);
+    if (index >= 0) {
+        entries[index].kind = kind;
+        entries[index].modified = modified;
+        return;
+    }
+    if (entryCount >= FILE_CATALOG_MAX) {
+        Serial.printf("[WARNING] File catalog full (%d entries), %s not listed\n", FILE_CATALOG_MAX, path);
+        return;
+    }
+
+    size_t pos = entryCount;
+    while (pos > 0 && strcmp(entries[pos - 1].path, path) > 0) {
+        entries[pos] = entries[pos - 1];
+        pos--;
+    }
+    memset(&entries[pos], 0, sizeof(entries[pos]));
+    strncpy(entries[pos].path, path, FILE_CATALOG_PATH_MAX - 1);
+    entries[pos].kind = kind;
+    entries[pos].modified = modified;
+    entryCount++;
+}
+
+static void scanDirectory(const char *dirPath) {
+    File dir = SD.open(dirPath);
+    if (!dir) return;
+
+    char path[FILE_CATALOG_PATH_MAX + 16];
+    File file = dir.openNextFile();
+    while (file) {
+        if (!file.isDirectory()) {
+            snprintf(path, sizeof(path), "%s/%s", strcmp(dirPath, "/") == 0 ? "" : dirPath, baseName(file.name()));
+            uint8_t kind = fileCatalogKind(path);
+            if (kind) putEntry(path, kind, file.getLastWrite());
+        }
+        file.close();
+        file = dir.openNextFile();
+    }
+    dir.close();
+}
+
+bool fileCatalogInit() {
+    lockCatalog();
+    if (entries == NULL) {
+        entries = (FileCatalogEntry*)ps_malloc(FILE_CATALOG_MAX * sizeof(FileCatalogEntry));
+        if (!entries) entries = (FileCatalogEntry*)malloc(FILE_CATALOG_MAX * sizeof(FileCatalogEntry));
+        if (!entries) {
+            unlockCatalog();
+            Serial.println("[ERROR] Failed to allocate file catalog");
+            return false;
+        }
+    }
+
+    SDOpTimer timer(SD_OP_LIST);
+    entryCount = 0;
+    scanDirectory("/");
+    scanDirectory(LOG_ARCHIVE_DIR);
+    catalogBuilt = true;
+    timer.done(true);
+    unlockCatalog();
+
+    Serial.printf("[INFO] File catalog built, %u files\n", (unsigned)entryCount);
+    return true;
+}
+
+void fileCatalogAdd(const char *path) {
+    uint8_t kind = fileCatalogKind(path);
+    if (!kind) return;
+    lockCatalog();
+    if (catalogBuilt) putEntry(path, kind, time(nullptr));
+    unlockCatalog();
+}
+
+void fileCatalogRemove(const char *path) {
+    lockCatalog();
+    int index = catalogBuilt ? findEntry(path) : -1;
+    if (index >= 0) {
+        for (size_t i = index; i + 1 < entryCount; i++) {
+            entries[i] = entries[i + 1];
+        }
+        entryCount--;
+    }
+    unlockCatalog();
+}
+
+void fileCatalogRename(const char *from, const char *to) {
+    fileCatalogRemove(from);
+    fileCatalogAdd(to);
+}
+
+size_t fileCatalogList(uint8_t kinds, const char *contains, FileCatalogEntry *out, size_t maxCount) {
+    if (!catalogBuilt && !fileCatalogInit()) return 0;
+
+    size_t found = 0;
+    lockCatalog();
+    for (size_t i = 0; i < entryCount; i++) {
+        if (!(entries[i].kind & kinds)) continue;
+        if (contains != NULL && strstr(baseName(entries[i].path), contains) == NULL) continue;
+        if (out != NULL) {
+            if (found >= maxCount) break;
+            out[found] = entries[i];
+        }
+        found++;
+    }
+    unlockCatalog();
+    return found;
+}
@@ -0,0 +1,48 @@
+#ifndef FILECATALOG_H
+#define FILECATALOG_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// In-memory catalog of the loose files the web server lists and cleans up - CSV backups and
+// binary logs of older firmware, segments expired into LOG_ARCHIVE_DIR, custom range chart JSON
+// and ZIP downloads. Built by one directory walk per mount and kept current by the code that
+// creates, renames and removes these files, so listings don't walk the card root.
+// Monthly log segments are not in here - the segment manifest (logStorage.h) lists them.
+
+#ifndef FILE_CATALOG_MAX
+#define FILE_CATALOG_MAX 256
+#endif
+#define FILE_CATALOG_PATH_MAX 48
+
+// Entry kinds, combinable as a mask for fileCatalogList()
+#define FILE_KIND_CSV_BACKUP 0x01       // <sensor>_log.csv and its bacMMDDYY copies
+#define FILE_KIND_LEGACY_LOG 0x02       // Single-file binary logs, <sensor>_log.bin and bac* copies
+#define FILE_KIND_ARCHIVED 0x04         // Segments expired by the retention policy
+#define FILE_KIND_CUSTOM_JSON 0x08      // /chart-data output for custom ranges
+#define FILE_KIND_ZIP 0x10              // /download-multiple archives
+
+typedef struct {
+    char path[FILE_CATALOG_PATH_MAX];   // Full path, e.g. "/logs/archive/inside_202301.arc"
+    uint8_t kind;                       // FILE_KIND_*
+    time_t modified;                    // Last write at the scan, time of the last update since
+} FileCatalogEntry;
+
+// Walks the card root and LOG_ARCHIVE_DIR - at mount and after a card reinit
+bool fileCatalogInit();
+
+// Kind of a path, 0 for files the catalog doesn't track
+uint8_t fileCatalogKind(const char *path);
+
+// Updates after changes on the card - untracked kinds are ignored
+void fileCatalogAdd(const char *path);
+void fileCatalogRemove(const char *path);
+void fileCatalogRename(const char *from, const char *to);
+
+// Entries of the given kinds whose base name contains the substring (NULL for all), in path order;
+// returns the number found, out may be NULL to count
+size_t fileCatalogList(uint8_t kinds, const char *contains, FileCatalogEntry *out, size_t maxCount);
+
+#endif /* FILECATALOG_H */
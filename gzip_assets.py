@@ -0,0 +1,34 @@
+#!python3
+# PlatformIO pre-build step - gzips the web pages next to their sources:
+#   index.html       -> index.html.gz        (copy both to the SD card root, served by the log web server)
+#   data/config.html -> data/config.html.gz  (uploaded to SPIFFS with "pio run -t uploadfs")
+# The servers keep the .gz in PSRAM and send it with Content-Encoding: gzip (staticAssets.cpp).
+# Also runs standalone: python gzip_assets.py
+import gzip
+import os
+
+ASSETS = ["index.html", os.path.join("data", "config.html")]
+
+try:
+    Import("env")
+    project_dir = env.subst("$PROJECT_DIR")
+except NameError:
+    project_dir = os.path.dirname(os.path.abspath(__file__))
+
+
+def compress(source, target):
+    # Only when the page changed - keeps uploadfs from seeing a new file on every build
+    if os.path.exists(target) and os.path.getmtime(target) >= os.path.getmtime(source):
+        return
+    with open(source, "rb") as f:
+        data = f.read()
+    # Fixed mtime - same page gives the same bytes and the same ETag
+    with open(target, "wb") as f:
+        f.write(gzip.compress(data, compresslevel=9, mtime=0))
+    print("gzip_assets: %s %d -> %d bytes" % (os.path.relpath(target, project_dir), len(data), os.path.getsize(target)))
+
+
+for asset in ASSETS:
+    source = os.path.join(project_dir, asset)
+    if os.path.exists(source):
+        compress(source, source + ".gz")
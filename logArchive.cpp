@@ -0,0 +1,359 @@
+#include "logArchive.h"
+
+//################## Column coding ##################
+
+static inline uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static size_t putVarint(uint8_t *out, uint32_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[len++] = value;
+    return len;
+}
+
+static bool getVarint(const uint8_t *in, size_t len, size_t &pos, uint32_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && pos < len; shift += 7) {
+        uint8_t byte = in[pos++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Zigzag varints, every zero followed by the number of further zeros
+static size_t encodeColumn(const int32_t *values, size_t count, uint8_t *out) {
+    size_t len = 0;
+    size_t i = 0;
+    while (i < count) {
+        len += putVarint(out + len, zigzag(values[i]));
+        if (values[i] == 0) {
+            size_t run = 0;
+            while (i + 1 + run < count && values[i + 1 + run] == 0) run++;
+            len += putVarint(out + len, run);
+            i += run;
+        }
+        i++;
+    }
+    return len;
+}
+
+static bool decodeColumn(const uint8_t *in, size_t len, size_t &pos, int32_t *values, size_t count) {
+    size_t i = 0;
+    while (i < count) {
+        uint32_t raw;
+        if (!getVarint(in, len, pos, raw)) return false;
+        values[i++] = unzigzag(raw);
+
+        if (raw == 0) {
+            uint32_t run;
+            if (!getVarint(in, len, pos, run) || i + run > count) return false;
+            while (run-- > 0) values[i++] = 0;
+        }
+    }
+    return true;
+}
+
+// Column values of one block - timestamps as delta-of-delta, everything else as delta
+static void splitColumns(const LogRecord *recs, size_t count, int32_t columns[LOG_ARCHIVE_COLUMNS][LOG_ARCHIVE_BLOCK_RECORDS]) {
+    int32_t prevDelta = 0;
+    for (size_t i = 0; i < count; i++) {
+        const LogRecord &rec = recs[i];
+        const LogRecord *prev = i > 0 ? &recs[i - 1] : NULL;
+
+        int32_t delta = prev ? rec.timestamp - prev->timestamp : 0;
+        columns[0][i] = delta - prevDelta;
+        prevDelta = delta;
+
+        columns[1][i] = rec.temperature - (prev ? prev->temperature : 0);
+        columns[2][i] = rec.humidity - (prev ? prev->humidity : 0);
+        columns[3][i] = rec.pressure - (prev ? prev->pressure : 0);
+        columns[4][i] = rec.batPercentage - (prev ? prev->batPercentage : 0);
+        columns[5][i] = rec.flags - (prev ? prev->flags : 0);
+    }
+}
+
+static void joinColumns(int32_t columns[LOG_ARCHIVE_COLUMNS][LOG_ARCHIVE_BLOCK_RECORDS], size_t count,
+                        int32_t firstTs, LogRecord *recs) {
+    int32_t delta = 0;
+    for (size_t i = 0; i < count; i++) {
+        LogRecord &rec = recs[i];
+        const LogRecord *prev = i > 0 ? &recs[i - 1] : NULL;
+
+        delta += columns[0][i];
+        rec.timestamp = prev ? prev->timestamp + delta : firstTs;
+        rec.temperature = (prev ? prev->temperature : 0) + columns[1][i];
+        rec.humidity = (prev ? prev->humidity : 0) + columns[2][i];
+        rec.pressure = (prev ? prev->pressure : 0) + columns[3][i];
+        rec.batPercentage = (prev ? prev->batPercentage : 0) + columns[4][i];
+        rec.flags = (prev ? prev->flags : 0) + columns[5][i];
+        logRecordSeal(rec);
+    }
+}
+
+// Column scratch space, shared by the encoder and decoders (guarded, a block is processed at once)
+static int32_t (*columnScratch)[LOG_ARCHIVE_BLOCK_RECORDS] = NULL;
+static SemaphoreHandle_t scratchMutex = NULL;
+
+static bool lockScratch() {
+    if (scratchMutex == NULL) {
+        scratchMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(scratchMutex, portMAX_DELAY);
+
+    if (columnScratch == NULL) {
+        size_t size = LOG_ARCHIVE_COLUMNS * LOG_ARCHIVE_BLOCK_RECORDS * sizeof(int32_t);
+        columnScratch = (int32_t (*)[LOG_ARCHIVE_BLOCK_RECORDS])ps_malloc(size);
+        if (!columnScratch) columnScratch = (int32_t (*)[LOG_ARCHIVE_BLOCK_RECORDS])malloc(size);
+    }
+    if (columnScratch == NULL) {
+        xSemaphoreGive(scratchMutex);
+        return false;
+    }
+    return true;
+}
+
+static void unlockScratch() {
+    xSemaphoreGive(scratchMutex);
+}
+
+static void* allocBuffer(size_t size) {
+    void *buffer = ps_malloc(size);
+    return buffer ? buffer : malloc(size);
+}
+
+//################## Encoder ##################
+
+static bool writeBlock(File &output, const LogRecord *recs, size_t count, uint8_t *payload, LogArchiveHeader &header) {
+    if (!lockScratch()) return false;
+
+    splitColumns(recs, count, columnScratch);
+    size_t len = 0;
+    for (int column = 0; column < LOG_ARCHIVE_COLUMNS; column++) {
+        len += encodeColumn(columnScratch[column], count, payload + len);
+    }
+    unlockScratch();
+
+    LogArchiveBlockHeader block = {(uint16_t)count, 0, recs[0].timestamp, recs[count - 1].timestamp, (uint32_t)len};
+    if (output.write((uint8_t*)&block, sizeof(block)) != sizeof(block) || output.write(payload, len) != len) {
+        return false;
+    }
+
+    header.maxBlockBytes = max(header.maxBlockBytes, (uint32_t)len);
+    return true;
+}
+
+bool logArchiveCompress(const char *srcPath, const char *dstPath) {
+    LogReader reader;
+    if (!reader.open(srcPath)) return false;
+
+    char tempPath[64];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", dstPath);
+    File output = SD.open(tempPath, FILE_WRITE);
+    if (!output) {
+        Serial.printf("[ERROR] Failed to create archive %s\n", tempPath);
+        return false;
+    }
+
+    LogRecord *recs = (LogRecord*)allocBuffer(LOG_ARCHIVE_BLOCK_RECORDS * sizeof(LogRecord));
+    uint8_t *payload = (uint8_t*)allocBuffer(LOG_ARCHIVE_MAX_BLOCK_BYTES);
+    if (!recs || !payload) {
+        free(recs);
+        free(payload);
+        output.close();
+        SD.remove(tempPath);
+        return false;
+    }
+
+    // Header is completed after the last block
+    LogArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LOG_ARCHIVE_MAGIC;
+    header.version = LOG_ARCHIVE_VERSION;
+    header.recordSize = LOG_RECORD_SIZE;
+    header.blockRecords = LOG_ARCHIVE_BLOCK_RECORDS;
+    output.write((uint8_t*)&header, sizeof(header));
+
+    bool ok = true;
+    size_t blockCount = 0;
+    LogRecord rec;
+    while (ok && reader.next(rec)) {
+        if (header.recordCount == 0) header.firstTs = rec.timestamp;
+        header.lastTs = rec.timestamp;
+        header.recordCount++;
+
+        recs[blockCount++] = rec;
+        if (blockCount == LOG_ARCHIVE_BLOCK_RECORDS) {
+            ok = writeBlock(output, recs, blockCount, payload, header);
+            blockCount = 0;
+        }
+    }
+    if (ok && blockCount > 0) {
+        ok = writeBlock(output, recs, blockCount, payload, header);
+    }
+    ok = ok && header.recordCount == reader.recordCount();
+    reader.close();
+
+    size_t compressedSize = output.size();
+    ok = ok && output.seek(0) && output.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+    output.close();
+    free(recs);
+    free(payload);
+
+    if (!ok) {
+        Serial.printf("[ERROR] Compressing %s failed\n", srcPath);
+        SD.remove(tempPath);
+        return false;
+    }
+
+    SD.remove(dstPath);
+    if (!SD.rename(tempPath, dstPath)) {
+        SD.remove(tempPath);
+        return false;
+    }
+
+    size_t rawSize = LOG_HEADER_SIZE + header.recordCount * LOG_RECORD_SIZE;
+    Serial.printf("[INFO] Archived %s -> %s: %u records, %u -> %u bytes\n", srcPath, dstPath,
+                  (unsigned)header.recordCount, (unsigned)rawSize, (unsigned)compressedSize);
+    return true;
+}
+
+//################## Decoder ##################
+
+bool LogArchiveReader::open(const char *filename) {
+    close();
+    file = SD.open(filename, FILE_READ);
+    if (!file) return false;
+
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || header.magic != LOG_ARCHIVE_MAGIC ||
+        header.blockRecords > LOG_ARCHIVE_BLOCK_RECORDS ||
+        header.maxBlockBytes > LOG_ARCHIVE_MAX_BLOCK_BYTES) {
+        Serial.printf("[ERROR] %s is not a valid log archive\n", filename);
+        file.close();
+        return false;
+    }
+
+    records = (LogRecord*)allocBuffer(LOG_ARCHIVE_BLOCK_RECORDS * sizeof(LogRecord));
+    payload = (uint8_t*)allocBuffer(max(header.maxBlockBytes, (uint32_t)1));
+    if (!records || !payload) {
+        close();
+        return false;
+    }
+
+    count = header.recordCount;
+    return rewind();
+}
+
+void LogArchiveReader::close() {
+    if (file) file.close();
+    free(records);
+    free(payload);
+    records = NULL;
+    payload = NULL;
+    count = nextIndex = 0;
+    blockStart = blockCount = blockPos = 0;
+}
+
+bool LogArchiveReader::rewind() {
+    nextIndex = blockStart = 0;
+    blockCount = blockPos = 0;
+    nextBlockOffset = sizeof(LogArchiveHeader);
+    return true;
+}
+
+bool LogArchiveReader::readBlockHeader(uint32_t offset, LogArchiveBlockHeader &block) {
+    return file.seek(offset) &&
+           file.read((uint8_t*)&block, sizeof(block)) == sizeof(block) &&
+           block.count > 0 && block.count <= LOG_ARCHIVE_BLOCK_RECORDS && block.bytes <= header.maxBlockBytes;
+}
+
+// Decodes the block at offset, firstIndex is the index of its first record
+bool LogArchiveReader::decodeBlock(uint32_t offset, uint32_t firstIndex) {
+    LogArchiveBlockHeader block;
+    if (!readBlockHeader(offset, block) || file.read(payload, block.bytes) != block.bytes || !lockScratch()) {
+        return false;
+    }
+
+    size_t pos = 0;
+    bool ok = true;
+    for (int column = 0; column < LOG_ARCHIVE_COLUMNS && ok; column++) {
+        ok = decodeColumn(payload, block.bytes, pos, columnScratch[column], block.count);
+    }
+    if (ok) joinColumns(columnScratch, block.count, block.firstTs, records);
+    unlockScratch();
+
+    if (!ok) {
+        Serial.println("[ERROR] Corrupted log archive block");
+        return false;
+    }
+
+    blockStart = firstIndex;
+    blockCount = block.count;
+    blockPos = 0;
+    nextBlockOffset = offset + sizeof(block) + block.bytes;
+    return true;
+}
+
+// Skips whole blocks by their headers, decodes only the one holding the record
+bool LogArchiveReader::seekRecord(uint32_t index) {
+    if (!file || index > count) return false;
+
+    rewind();
+    uint32_t offset = sizeof(LogArchiveHeader);
+    uint32_t first = 0;
+    LogArchiveBlockHeader block;
+    while (index < count && readBlockHeader(offset, block)) {
+        if (index < first + block.count) {
+            if (!decodeBlock(offset, first)) return false;
+            blockPos = index - first;
+            nextIndex = index;
+            return true;
+        }
+        first += block.count;
+        offset += sizeof(block) + block.bytes;
+    }
+
+    // Positioned at the end
+    blockStart = nextIndex = count;
+    return index == count;
+}
+
+// Positions the reader at the start of the last block not newer than startTime,
+// callers skip the leading records older than startTime like with the index sidecar
+bool LogArchiveReader::seekTime(int32_t startTime) {
+    if (!file) return false;
+
+    rewind();
+    uint32_t offset = sizeof(LogArchiveHeader);
+    uint32_t first = 0;
+    uint32_t foundOffset = offset, foundFirst = 0;
+    LogArchiveBlockHeader block;
+    while (first < count && readBlockHeader(offset, block) && block.firstTs <= startTime) {
+        foundOffset = offset;
+        foundFirst = first;
+        first += block.count;
+        offset += sizeof(block) + block.bytes;
+    }
+
+    if (count == 0 || !decodeBlock(foundOffset, foundFirst)) return false;
+    nextIndex = foundFirst;
+    return true;
+}
+
+bool LogArchiveReader::next(LogRecord &rec) {
+    if (blockPos >= blockCount) {
+        if (!file || nextIndex >= count || !decodeBlock(nextBlockOffset, blockStart + blockCount)) return false;
+    }
+    rec = records[blockPos++];
+    nextIndex++;
+    return true;
+}
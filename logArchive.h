@@ -0,0 +1,79 @@
+#ifndef LOGARCHIVE_H
+#define LOGARCHIVE_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+#include "logStorage.h"
+
+// Compressed archive format for closed log segments (<sensor>_<YYYYMM>.arc)
+// Records are stored in blocks of up to LOG_ARCHIVE_BLOCK_RECORDS, each block column by column:
+//   timestamp            - delta-of-delta (fixed cadence -> runs of zeros)
+//   temperature, humidity, pressure, battery, flags - delta to the previous record
+// Every value is zigzag varint coded, a zero is followed by the length of its zero run.
+// Record CRCs are not stored - archives are written to a temp file and renamed, decoded records are resealed.
+// Block headers carry record count, time span and byte length, so readers skip whole blocks
+// and decode one block at a time - no index sidecar needed.
+
+#define LOG_ARCHIVE_MAGIC 0x43524157    // "WARC" little endian
+#define LOG_ARCHIVE_VERSION 1
+#define LOG_ARCHIVE_BLOCK_RECORDS 256
+#define LOG_ARCHIVE_COLUMNS 6
+// Worst case block payload - 5 byte varint per value plus a 5 byte run length after each zero
+#define LOG_ARCHIVE_MAX_BLOCK_BYTES (LOG_ARCHIVE_BLOCK_RECORDS * LOG_ARCHIVE_COLUMNS * 10)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t recordSize;         // LOG_RECORD_SIZE at compression time, informational
+    uint16_t blockRecords;
+    uint32_t recordCount;
+    int32_t firstTs;
+    int32_t lastTs;
+    uint32_t maxBlockBytes;     // Largest block payload, decoder buffer size
+} LogArchiveHeader;
+
+typedef struct __attribute__((packed)) {
+    uint16_t count;
+    uint16_t reserved;
+    int32_t firstTs;
+    int32_t lastTs;
+    uint32_t bytes;             // Payload length following this header
+} LogArchiveBlockHeader;
+
+// Compresses a binary log file into an archive, written to <dstPath>.tmp and renamed when complete
+bool logArchiveCompress(const char *srcPath, const char *dstPath);
+
+// Streaming decoder, one decoded block in memory at a time
+class LogArchiveReader {
+    public:
+        LogArchiveReader() : records(NULL), payload(NULL), count(0), nextIndex(0),
+                             blockStart(0), blockCount(0), blockPos(0), nextBlockOffset(0) {}
+        ~LogArchiveReader() { close(); }
+
+        bool open(const char *filename);
+        void close();
+
+        uint32_t recordCount() const { return header.recordCount; }
+        bool seekRecord(uint32_t index);
+        bool seekTime(int32_t startTime);
+        bool next(LogRecord &rec);
+
+    private:
+        bool rewind();
+        bool readBlockHeader(uint32_t offset, LogArchiveBlockHeader &block);
+        bool decodeBlock(uint32_t offset, uint32_t firstIndex);
+
+        File file;
+        LogArchiveHeader header;
+        LogRecord *records;         // Decoded block
+        uint8_t *payload;           // Compressed block
+        uint32_t count;
+        uint32_t nextIndex;         // Index of the next record returned by next()
+        uint32_t blockStart;        // Index of the first record of the decoded block
+        uint32_t blockCount;
+        uint32_t blockPos;
+        uint32_t nextBlockOffset;   // File offset of the next block header
+};
+
+#endif /* LOGARCHIVE_H */
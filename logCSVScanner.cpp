@@ -0,0 +1,182 @@
+#include "logCSVScanner.h"
+
+// LogRecord units as decimal places
+static_assert(LOG_TEMP_SCALE == 100.0f && LOG_HUMIDITY_SCALE == 10.0f && LOG_PRESSURE_SCALE == 10.0f,
+              "logParseCSVRecord() decimals follow the LogRecord scales");
+#define TEMP_DECIMALS 2
+#define HUMIDITY_DECIMALS 1
+#define PRESSURE_DECIMALS 1
+
+// First '\n' in [p, end) - four bytes per step once aligned, a byte of the word is zero
+// after the XOR exactly where the newline is
+static const char* findNewline(const char *p, const char *end) {
+    while (p < end && ((uintptr_t)p & 3)) {
+        if (*p == '\n') return p;
+        p++;
+    }
+    while (p + 4 <= end) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        word ^= 0x0A0A0A0Au;
+        if ((word - 0x01010101u) & ~word & 0x80808080u) break;
+        p += 4;
+    }
+    while (p < end) {
+        if (*p == '\n') return p;
+        p++;
+    }
+    return NULL;
+}
+
+bool LogCSVScanner::open(const char *path) {
+    close();
+    file = SD.open(path, FILE_READ);
+    if (!file) return false;
+
+    // One spare byte terminates a last line without '\n'
+    block = (char*)ps_malloc(LOG_CSV_SCAN_BLOCK + 1);
+    if (!block) block = (char*)malloc(LOG_CSV_SCAN_BLOCK + 1);
+    if (!block) {
+        file.close();
+        return false;
+    }
+    start = end = 0;
+    eof = false;
+    skipped = 0;
+    return true;
+}
+
+void LogCSVScanner::close() {
+    if (file) file.close();
+    free(block);
+    block = NULL;
+    start = end = 0;
+    eof = true;
+}
+
+// Moves the unread rest to the front and reads behind it
+bool LogCSVScanner::fill() {
+    if (eof) return false;
+    if (start > 0) {
+        memmove(block, block + start, end - start);
+        end -= start;
+        start = 0;
+    }
+    size_t bytesRead = file.read((uint8_t*)block + end, LOG_CSV_SCAN_BLOCK - end);
+    if (bytesRead == 0) eof = true;
+    end += bytesRead;
+    return bytesRead > 0;
+}
+
+bool LogCSVScanner::nextLine(char *&line, size_t &len) {
+    if (!block) return false;
+    bool discarding = false;
+
+    while (true) {
+        const char *newline = findNewline(block + start, block + end);
+        if (newline) {
+            size_t lineStart = start;
+            start = newline - block + 1;
+            if (discarding) {
+                discarding = false;
+                continue;
+            }
+            line = block + lineStart;
+            len = newline - line;
+            if (len > 0 && line[len - 1] == '\r') len--;
+            line[len] = '\0';
+            return true;
+        }
+
+        if (eof) {
+            // Last line without a line ending
+            if (start == end || discarding) return false;
+            line = block + start;
+            len = end - start;
+            if (len > 0 && line[len - 1] == '\r') len--;
+            line[len] = '\0';
+            start = end;
+            return true;
+        }
+
+        // Block full without a newline - the line can't be returned in place
+        if (start == 0 && end == LOG_CSV_SCAN_BLOCK) {
+            if (!discarding) skipped++;
+            discarding = true;
+            start = end = 0;
+        }
+        fill();
+    }
+}
+
+bool logParseFixed(const char *&p, const char *end, int decimals, int32_t &value) {
+    while (p < end && *p == ' ') p++;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    int64_t result = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (result < INT32_MAX) result = result * 10 + (*p - '0');
+        digits++;
+        p++;
+    }
+
+    int fraction = 0;
+    bool roundUp = false;
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (fraction < decimals) {
+                result = result * 10 + (*p - '0');
+                fraction++;
+            } else if (fraction == decimals) {
+                roundUp = *p >= '5';
+                fraction++;
+            }
+            digits++;
+            p++;
+        }
+    }
+    if (digits == 0) return false;
+
+    for (; fraction < decimals; fraction++) result *= 10;
+    if (roundUp) result++;
+    if (result > INT32_MAX) result = INT32_MAX;
+    value = negative ? -(int32_t)result : (int32_t)result;
+    return true;
+}
+
+static int16_t clampInt16(int32_t value) {
+    return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : (int16_t)value);
+}
+
+bool logParseCSVRecord(const char *line, size_t len, bool hasPressure, LogRecord &rec) {
+    const char *p = line;
+    const char *end = line + len;
+    int32_t timestamp, temperature, humidity, pressure = 0, battery = 100;
+
+    if (!logParseFixed(p, end, 0, timestamp) || p >= end || *p++ != ',') return false;
+    if (!logParseFixed(p, end, TEMP_DECIMALS, temperature) || p >= end || *p++ != ',') return false;
+    if (!logParseFixed(p, end, HUMIDITY_DECIMALS, humidity)) return false;
+    // Pressure and battery are optional, like the old sscanf() parsing
+    if (p < end && *p == ',') {
+        p++;
+        if (logParseFixed(p, end, PRESSURE_DECIMALS, pressure) && p < end && *p == ',') {
+            p++;
+            logParseFixed(p, end, 0, battery);
+        }
+    }
+
+    rec.timestamp = timestamp;
+    rec.temperature = clampInt16(temperature);
+    rec.humidity = clampInt16(humidity);
+    rec.pressure = hasPressure ? clampInt16(pressure) : 0;
+    rec.batPercentage = battery < 0 ? 0 : (battery > 255 ? 255 : battery);
+    rec.flags = hasPressure ? LOG_FLAG_HAS_PRESSURE : 0;
+    logRecordSeal(rec);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef LOGCSVSCANNER_H
+#define LOGCSVSCANNER_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+#include "logStorage.h"
+
+// Buffered line scanner for the CSV text files on the card - legacy sensor logs, the segment
+// manifest and the sensor registry. Reads LOG_CSV_SCAN_BLOCK bytes per SD access into a
+// PSRAM block and hands out lines in place, instead of one virtual read() call per byte.
+// Sensor log lines are parsed with a fixed-point parser straight into LogRecord units.
+
+#ifndef LOG_CSV_SCAN_BLOCK
+#define LOG_CSV_SCAN_BLOCK 8192
+#endif
+
+class LogCSVScanner {
+    public:
+        LogCSVScanner() : block(NULL), start(0), end(0), eof(true), skipped(0) {}
+        ~LogCSVScanner() { close(); }
+
+        bool open(const char *path);
+        void close();
+
+        // Next line without its line ending, NUL terminated and valid until the next call.
+        // Lines longer than the block are skipped (counted in skippedLines())
+        bool nextLine(char *&line, size_t &len);
+        uint32_t skippedLines() const { return skipped; }
+
+    private:
+        bool fill();
+
+        File file;
+        char *block;
+        size_t start;           // First unread byte in block
+        size_t end;             // One past the last valid byte
+        bool eof;
+        uint32_t skipped;
+};
+
+// Decimal number into fixed point with the given decimals ("-3.47", 2 -> -347), rounded half
+// away from zero on the first dropped digit; advances p past the number
+bool logParseFixed(const char *&p, const char *end, int decimals, int32_t &value);
+
+// "timestamp,temperature,humidity[,pressure[,battery]]" into a sealed record
+bool logParseCSVRecord(const char *line, size_t len, bool hasPressure, LogRecord &rec);
+
+#endif /* LOGCSVSCANNER_H */
@@ -0,0 +1,298 @@
+#include "logHotCache.h"
+#include <algorithm>
+#include <time.h>
+
+// One ring per sensor, record with absolute index n lives at recs[n % LOG_HOT_CACHE_RECORDS]
+typedef struct {
+    char sensor[LOG_SENSOR_NAME_MAX];   // Empty for unused slots
+    LogRecord *recs;
+    uint32_t first;             // Absolute index of the first record written to this ring
+    uint32_t total;             // Absolute index one past the newest record
+    int32_t coveredFrom;        // Cache holds every record since then, INT32_MAX until warmed
+} HotCacheSlot;
+
+static HotCacheSlot slots[LOG_HOT_CACHE_MAX_SENSORS];
+static bool cacheEnabled = false;
+static SemaphoreHandle_t cacheMutex = NULL;
+
+static void lockCache() {
+    if (cacheMutex == NULL) {
+        cacheMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+}
+
+static void unlockCache() {
+    xSemaphoreGive(cacheMutex);
+}
+
+static uint32_t oldestIndex(const HotCacheSlot &slot) {
+    return slot.total - slot.first > LOG_HOT_CACHE_RECORDS ? slot.total - LOG_HOT_CACHE_RECORDS : slot.first;
+}
+
+static int findSlot(const char *sensor) {
+    for (int i = 0; i < LOG_HOT_CACHE_MAX_SENSORS; i++) {
+        if (slots[i].sensor[0] != '\0' && strcmp(slots[i].sensor, sensor) == 0) return i;
+    }
+    return -1;
+}
+
+// Existing slot or a new one - ring memory is taken from PSRAM only, the cache is optional
+static HotCacheSlot* slotFor(const char *sensor) {
+    int index = findSlot(sensor);
+    if (index >= 0) return &slots[index];
+
+    for (int i = 0; i < LOG_HOT_CACHE_MAX_SENSORS; i++) {
+        if (slots[i].sensor[0] == '\0') {
+            slots[i].recs = (LogRecord*)ps_malloc(LOG_HOT_CACHE_RECORDS * sizeof(LogRecord));
+            if (!slots[i].recs) {
+                Serial.printf("[ERROR] Failed to allocate hot cache for %s\n", sensor);
+                return NULL;
+            }
+            strncpy(slots[i].sensor, sensor, LOG_SENSOR_NAME_MAX - 1);
+            slots[i].first = slots[i].total = 0;
+            slots[i].coveredFrom = INT32_MAX;
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Inserts in time order - a late reading shifts the newer ones up a place, one repeating a cached
+// timestamp is dropped. Coverage moves past whatever gets overwritten.
+static void appendLocked(HotCacheSlot &slot, const LogRecord &rec) {
+    uint32_t oldest = oldestIndex(slot);
+    uint32_t pos = slot.total;
+    while (pos > oldest && slot.recs[(pos - 1) % LOG_HOT_CACHE_RECORDS].timestamp > rec.timestamp) pos--;
+    if (pos > oldest && slot.recs[(pos - 1) % LOG_HOT_CACHE_RECORDS].timestamp == rec.timestamp) return;
+
+    bool full = slot.total - slot.first >= LOG_HOT_CACHE_RECORDS;
+    if (full && pos == oldest) {
+        // Older than anything the ring keeps - the cache no longer holds everything since coveredFrom
+        slot.coveredFrom = max(slot.coveredFrom, rec.timestamp + 1);
+        return;
+    }
+
+    LogRecord &entry = slot.recs[slot.total % LOG_HOT_CACHE_RECORDS];
+    if (full && entry.timestamp >= slot.coveredFrom) {
+        slot.coveredFrom = entry.timestamp + 1;
+    }
+    for (uint32_t i = slot.total; i > pos; i--) {
+        slot.recs[i % LOG_HOT_CACHE_RECORDS] = slot.recs[(i - 1) % LOG_HOT_CACHE_RECORDS];
+    }
+    slot.recs[pos % LOG_HOT_CACHE_RECORDS] = rec;
+    slot.total++;
+}
+
+bool logHotCacheInit() {
+    memset(slots, 0, sizeof(slots));
+    cacheEnabled = psramFound();
+    if (!cacheEnabled) {
+        Serial.println("[WARNING] No PSRAM, hot tail cache disabled");
+        return false;
+    }
+    Serial.printf("[INFO] Hot tail cache ready: %d records per sensor, %d days warm-up\n",
+                  LOG_HOT_CACHE_RECORDS, LOG_HOT_CACHE_DAYS);
+    return true;
+}
+
+void logHotCacheAdd(const char *sensor, const LogRecord &rec) {
+    if (!cacheEnabled) return;
+    lockCache();
+    HotCacheSlot *slot = slotFor(sensor);
+    if (slot) appendLocked(*slot, rec);
+    unlockCache();
+}
+
+bool logHotCacheCovers(const char *sensor, int32_t startTime) {
+    lockCache();
+    int index = findSlot(sensor);
+    bool covered = index >= 0 && slots[index].coveredFrom <= startTime;
+    unlockCache();
+    return covered;
+}
+
+bool logHotCacheLast(const char *sensor, LogRecord &rec) {
+    lockCache();
+    int index = findSlot(sensor);
+    bool found = index >= 0 && slots[index].total > slots[index].first;
+    if (found) rec = slots[index].recs[(slots[index].total - 1) % LOG_HOT_CACHE_RECORDS];
+    unlockCache();
+    return found;
+}
+
+size_t logHotCacheTail(const char *sensor, LogRecord *out, size_t n) {
+    lockCache();
+    int index = findSlot(sensor);
+    size_t count = 0;
+    if (index >= 0) {
+        const HotCacheSlot &slot = slots[index];
+        count = min(n, (size_t)(slot.total - oldestIndex(slot)));
+        for (size_t i = 0; i < count; i++) {
+            out[i] = slot.recs[(slot.total - count + i) % LOG_HOT_CACHE_RECORDS];
+        }
+    }
+    unlockCache();
+    return count;
+}
+
+//################## Warm-up ##################
+
+// Loads the last LOG_HOT_CACHE_DAYS of one sensor into a fresh ring, then merges in the
+// readings that arrived live in the meantime and swaps the rings
+static void warmSensor(const char *sensor, int32_t windowStart) {
+    LogRecord *recs = (LogRecord*)ps_malloc(LOG_HOT_CACHE_RECORDS * sizeof(LogRecord));
+    if (!recs) return;
+
+    uint32_t loaded = 0;
+    int32_t coveredFrom = windowStart;
+    LogQuery query;
+    if (query.open(sensor, windowStart, INT32_MAX)) {
+        LogRecord rec;
+        while (query.next(rec)) {
+            LogRecord &entry = recs[loaded % LOG_HOT_CACHE_RECORDS];
+            if (loaded >= LOG_HOT_CACHE_RECORDS) coveredFrom = entry.timestamp + 1;
+            entry = rec;
+            loaded++;
+        }
+        query.close();
+    }
+
+    // Oldest record to index 0
+    uint32_t kept = min(loaded, (uint32_t)LOG_HOT_CACHE_RECORDS);
+    if (loaded > LOG_HOT_CACHE_RECORDS) {
+        std::rotate(recs, recs + loaded % LOG_HOT_CACHE_RECORDS, recs + LOG_HOT_CACHE_RECORDS);
+    }
+    int32_t lastLoaded = kept > 0 ? recs[kept - 1].timestamp : INT32_MIN;
+
+    lockCache();
+    HotCacheSlot *slot = slotFor(sensor);
+    if (!slot) {
+        unlockCache();
+        free(recs);
+        return;
+    }
+
+    // New absolute indices start past every index handed out so far, open readers skip ahead
+    HotCacheSlot live = *slot;
+    uint32_t base = (live.total + LOG_HOT_CACHE_RECORDS - 1) / LOG_HOT_CACHE_RECORDS * LOG_HOT_CACHE_RECORDS;
+    slot->recs = recs;
+    slot->first = base;
+    slot->total = base + kept;
+    slot->coveredFrom = coveredFrom;
+    uint32_t merged = 0;
+    for (uint32_t i = oldestIndex(live); i < live.total; i++) {
+        const LogRecord &rec = live.recs[i % LOG_HOT_CACHE_RECORDS];
+        if (rec.timestamp > lastLoaded) {
+            appendLocked(*slot, rec);
+            merged++;
+        }
+    }
+    coveredFrom = slot->coveredFrom;
+    unlockCache();
+    free(live.recs);
+
+    Serial.printf("[INFO] Hot cache %s warmed: %u records from SD, %u live, complete since %d\n",
+                  sensor, (unsigned)kept, (unsigned)merged, (int)coveredFrom);
+}
+
+static void hotCacheWarmTask(void *parameter) {
+    // Window start needs the clock
+    for (int i = 0; i < 120 && time(nullptr) < 1700000000; i++) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    time_t now = time(nullptr);
+    if (now >= 1700000000) {
+        int32_t windowStart = now - LOG_HOT_CACHE_DAYS * 86400;
+        size_t segmentCount = logListSegments(NULL, NULL, 0);
+        LogSegmentInfo *segments = segmentCount ? (LogSegmentInfo*)malloc(segmentCount * sizeof(LogSegmentInfo)) : NULL;
+        if (segments) {
+            segmentCount = logListSegments(NULL, segments, segmentCount);
+            // Every sensor with a log partition, each once
+            for (size_t i = 0; i < segmentCount; i++) {
+                bool seen = false;
+                for (size_t j = 0; j < i; j++) {
+                    if (strcmp(segments[j].sensor, segments[i].sensor) == 0) seen = true;
+                }
+                if (!seen) warmSensor(segments[i].sensor, windowStart);
+            }
+            free(segments);
+        }
+        // Sensors already reporting live but without a log partition yet
+        for (int i = 0; i < LOG_HOT_CACHE_MAX_SENSORS; i++) {
+            char sensor[LOG_SENSOR_NAME_MAX] = "";
+            lockCache();
+            if (slots[i].coveredFrom == INT32_MAX) memcpy(sensor, slots[i].sensor, sizeof(sensor));
+            unlockCache();
+            if (sensor[0] != '\0') warmSensor(sensor, windowStart);
+        }
+    } else {
+        Serial.println("[WARNING] Hot cache warm-up skipped, no valid time");
+    }
+    vTaskDelete(NULL);
+}
+
+void logHotCacheWarm() {
+    if (!cacheEnabled) return;
+    if (xTaskCreate(hotCacheWarmTask, "HotCacheWarmTask", 6144, NULL, 1, NULL) != pdPASS) {
+        Serial.println("[ERROR] Failed to create hot cache warm-up task");
+    }
+}
+
+//################## Reader ##################
+
+bool LogHotCacheReader::open(const char *sensor, int32_t start, int32_t end) {
+    startTime = start;
+    endTime = end;
+    bufCount = bufPos = 0;
+
+    lockCache();
+    slot = findSlot(sensor);
+    if (slot < 0) {
+        unlockCache();
+        return false;
+    }
+
+    // Binary search for the first record at or after start
+    const HotCacheSlot &cache = slots[slot];
+    uint32_t low = oldestIndex(cache), high = cache.total;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (cache.recs[mid % LOG_HOT_CACHE_RECORDS].timestamp < start) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    position = low;
+    unlockCache();
+    return true;
+}
+
+bool LogHotCacheReader::next(LogRecord &rec) {
+    if (slot < 0) return false;
+
+    while (true) {
+        if (bufPos >= bufCount) {
+            lockCache();
+            const HotCacheSlot &cache = slots[slot];
+            position = max(position, oldestIndex(cache));
+            bufCount = 0;
+            while (bufCount < BUFFER_RECORDS && position < cache.total) {
+                buffer[bufCount++] = cache.recs[position++ % LOG_HOT_CACHE_RECORDS];
+            }
+            bufPos = 0;
+            unlockCache();
+            if (bufCount == 0) return false;
+        }
+
+        const LogRecord &candidate = buffer[bufPos++];
+        if (candidate.timestamp < startTime) continue;
+        if (candidate.timestamp > endTime) {
+            slot = -1;
+            return false;
+        }
+        rec = candidate;
+        return true;
+    }
+}
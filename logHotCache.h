@@ -0,0 +1,56 @@
+#ifndef LOGHOTCACHE_H
+#define LOGHOTCACHE_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "logStorage.h"
+
+// Hot tail cache - the most recent readings of each sensor kept in PSRAM
+// dataDistributorTask appends every reading as it arrives (ahead of the write-behind buffer),
+// a background task warms the cache with the last LOG_HOT_CACHE_DAYS from the SD card at boot.
+// /latest, /minmax and /chart-data read from here whenever the requested range is covered,
+// so the usual dashboard ranges (24h, week) need no SD access at all.
+
+#ifndef LOG_HOT_CACHE_DAYS
+#define LOG_HOT_CACHE_DAYS 8            // Warm-up window, week range plus a day of slack
+#endif
+#ifndef LOG_HOT_CACHE_RECORDS
+#define LOG_HOT_CACHE_RECORDS 4096      // Per sensor (56 KB of 14 B records), 42 days at 15 min interval, 14 at 5 min
+#endif
+#define LOG_HOT_CACHE_MAX_SENSORS LOG_MAX_SENSORS
+
+bool logHotCacheInit();
+// Starts the background warm-up from the log segments, needs logStorageInit() first
+void logHotCacheWarm();
+
+void logHotCacheAdd(const char *sensor, const LogRecord &rec);
+// True if every record of the sensor since startTime is in the cache
+bool logHotCacheCovers(const char *sensor, int32_t startTime);
+bool logHotCacheLast(const char *sensor, LogRecord &rec);
+// Up to n newest records in time order, returns the count
+size_t logHotCacheTail(const char *sensor, LogRecord *out, size_t n);
+
+// Time range reader over one sensor's ring, records are copied out in small chunks so
+// the cache stays unlocked between calls; records overwritten meanwhile are skipped, a late
+// reading inserted meanwhile may be missed or repeat its neighbour
+class LogHotCacheReader {
+    public:
+        LogHotCacheReader() : slot(-1), startTime(0), endTime(0), position(0), bufCount(0), bufPos(0) {}
+
+        bool open(const char *sensor, int32_t start, int32_t end);
+        bool next(LogRecord &rec);
+
+    private:
+        static const size_t BUFFER_RECORDS = 32;
+
+        int slot;
+        int32_t startTime;
+        int32_t endTime;
+        uint32_t position;              // Absolute index of the next record to copy
+        LogRecord buffer[BUFFER_RECORDS];
+        size_t bufCount;
+        size_t bufPos;
+};
+
+#endif /* LOGHOTCACHE_H */
@@ -0,0 +1,243 @@
+#include "logPipeline.h"
+#include <SD.h>
+#include "logStorage.h"
+#include "logWriteBuffer.h"
+#include "logHotCache.h"
+#include "sdStats.h"
+#include "fileCatalog.h"
+
+// Queue handles, created in setup()
+QueueHandle_t sensorDataQueue;
+QueueHandle_t renderDataQueue;
+QueueHandle_t csvLogQueue;
+SemaphoreHandle_t logFlushDoneSem;
+
+// Global variables for SD Card handling
+bool sdCardInitialized = false;
+const int MAX_SD_INIT_RETRIES = 3;
+unsigned long lastSDRetryTime = 0;
+const unsigned long SD_RETRY_INTERVAL = 5000; // 5 seconds between retry attempts
+
+static LogPipelineStats stats;
+static SemaphoreHandle_t statsMutex = NULL;
+
+static void lockStats() {
+    if (statsMutex == NULL) {
+        statsMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(statsMutex, portMAX_DELAY);
+}
+
+static void unlockStats() {
+    xSemaphoreGive(statsMutex);
+}
+
+// Card found unusable - the outage lasts until a remount succeeds
+static void markCardLost() {
+    sdCardInitialized = false;
+    lockStats();
+    if (stats.outageSinceMs == 0) {
+        stats.outageSinceMs = max(millis(), 1UL);
+        stats.outages++;
+    }
+    unlockStats();
+}
+
+static void markCardRemounted() {
+    lockStats();
+    if (stats.outageSinceMs != 0) {
+        stats.lastOutageMs = millis() - stats.outageSinceMs;
+        stats.maxOutageMs = max(stats.maxOutageMs, stats.lastOutageMs);
+        stats.outageSinceMs = 0;
+    }
+    unlockStats();
+}
+
+LogPipelineStats logPipelineGetStats() {
+    lockStats();
+    LogPipelineStats copy = stats;
+    unlockStats();
+    return copy;
+}
+
+//###################### SD CARD #######################
+
+// Function to check SD card health and attempt reinit if needed
+bool checkAndReinitSDCard() {
+    // If already initialized, do a quick check
+    if (sdCardInitialized) {
+        // Simple test - try to open the root directory
+        SDOpTimer timer(SD_OP_HEALTH_CHECK);
+        File root = SD.open("/");
+        if (!root || !root.isDirectory()) {
+            // SD card issue detected
+            Serial.println("SD card disconnected or failed during operation!");
+            markCardLost();
+            if (root) root.close();
+            timer.done(false);
+            sdStatsHealthFailure();
+        } else {
+            root.close();
+            return true; // Card is working fine
+        }
+    }
+
+    // Only attempt reinitialization if enough time has passed since last attempt
+    unsigned long currentTime = millis();
+    if (!sdCardInitialized && (currentTime - lastSDRetryTime >= SD_RETRY_INTERVAL)) {
+        Serial.println("Attempting to reinitialize SD card...");
+
+        // Try to end current session before reinitializing
+        SD.end();
+        delay(100);
+
+        // Attempt to reinitialize
+        for (int retry = 0; retry < MAX_SD_INIT_RETRIES; retry++) {
+            if (initializeSDCard()) {
+                sdCardInitialized = true;
+                Serial.println("SD card successfully reinitialized!");
+                // May be another card
+                fileCatalogInit();
+                markCardRemounted();
+                break;
+            }
+            Serial.printf("Reinit attempt %d failed, retrying...\n", retry + 1);
+            delay(500); // Short delay between retry attempts
+        }
+        sdStatsReinit(sdCardInitialized);
+
+        lastSDRetryTime = currentTime; // Update the last retry time
+    }
+
+    return sdCardInitialized;
+}
+
+//###################### Tasks #######################
+
+// Reading as stored in the log - same validation and timestamp rounding for SD log and hot cache
+static bool makeLogRecord(SensorData &data, LogRecord &record) {
+    // Veryfing proper time assigment, in case any ESP hasn't set its NTP yet
+    if (data.timestamp < 1700000000) {
+        return false;
+    }
+    // Round up timestamps to 10s
+    data.timestamp = (data.timestamp + 5) / 10 * 10;
+
+    record = logMakeRecord(data.timestamp, data.temperature, data.humidity, data.pressure,
+                           data.batPercentage, sensorHasPressure(data.sensorId));
+    return true;
+}
+
+//Data distributing task
+void dataDistributorTask(void *parameter) {
+    SensorData data;
+
+    while (1) {
+        // Wait for new data from sensors
+        if (xQueueReceive(sensorDataQueue, &data, portMAX_DELAY) == pdTRUE) {
+
+            // Distribute to all subscribers
+            bool rendered = xQueueSend(renderDataQueue, &data, pdMS_TO_TICKS(10)) == pdTRUE;
+            if (!rendered) {
+                Serial.println("[WARNING] renderDataQueue is full! Data lost.");
+            }
+            sensorRegistrySetLatest(data);
+            LogMessage message = {};
+            message.type = LOG_MESSAGE_READING;
+            message.reading = data;
+            bool queued = xQueueSend(csvLogQueue, &message, pdMS_TO_TICKS(10)) == pdTRUE;
+            if (!queued) {
+                Serial.println("[WARNING] csvLogQueue is full! Data lost.");
+            }
+
+            lockStats();
+            stats.readings++;
+            if (!rendered) stats.renderDropped++;
+            if (!queued) stats.logDropped++;
+            stats.logQueueMax = max(stats.logQueueMax, (uint32_t)uxQueueMessagesWaiting(csvLogQueue));
+            unlockStats();
+
+            // Web API reads recent data from PSRAM instead of the card
+            LogRecord record;
+            if (makeLogRecord(data, record)) {
+                logHotCacheAdd(sensorName(data.sensorId), record);
+            }
+
+            // Optional: Log distribution
+            Serial.printf("Distributed %s data: %.1f°C, %.1f%%, %.1fhPa, timestamp: %d\n", sensorName(data.sensorId), data.temperature, data.humidity, data.pressure, data.timestamp);
+        }
+
+        // Small delay to prevent CPU hogging
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+// Writes the write-behind buffer out, card health is checked once per batch instead of per record
+static void flushLogBuffer(LogFlushReason reason) {
+    if (!checkAndReinitSDCard()) {
+        Serial.printf("SD card not available, %u log records kept in buffer\n", logBufferCount());
+        logBufferRetryLater();
+        return;
+    }
+    uint32_t pending = logBufferCount();
+    SDOpTimer timer(SD_OP_FLUSH);
+    bool flushed = logBufferFlush(reason);
+    timer.done(flushed, (pending - logBufferCount()) * LOG_RECORD_SIZE);
+    if (!flushed) {
+        // Mark card as potentially failed to trigger reinitialization
+        markCardLost();
+        return;
+    }
+    // Nodes registered since the last flush
+    sensorRegistrySave();
+}
+
+// SD Logging Task - records are collected in the write-behind buffer (logWriteBuffer) and
+// written to the monthly log segments (logStorage) in batches
+void SDLogTask(void *pvParameters) {
+    LogMessage message;
+    while (1) {
+        // Wait for new data, or until the oldest buffered record reaches the data-loss window
+        if (xQueueReceive(csvLogQueue, &message, logBufferWaitTicks()) == pdTRUE) {
+
+            // Idle request from IdleTask
+            if (message.type == LOG_MESSAGE_IDLE) {
+                if (logBufferFlushBeforeIdle(message.idle.seconds, message.idle.deepSleep)) {
+                    flushLogBuffer(LOG_FLUSH_IDLE);
+                }
+                xSemaphoreGive(logFlushDoneSem);
+                continue;
+            }
+            SensorData &logEntry = message.reading;
+
+            // Buffer data as fixed-size binary record
+            LogRecord record;
+            if (!makeLogRecord(logEntry, record)) {
+                Serial.printf("Received data to log with incorrect timestamp, skipping loging.");
+                continue;
+            }
+            logBufferAdd(sensorName(logEntry.sensorId), record);
+
+            Serial.printf("Data buffered for %s (%u pending): Ts: %d, t: %.1f, h: %.1f, p: %.1f, b: %d\n",
+                         sensorName(logEntry.sensorId), logBufferCount(), logEntry.timestamp, logEntry.temperature,
+                         logEntry.humidity, logEntry.pressure, logEntry.batPercentage);
+        }
+
+        int reason = logBufferFlushDue();
+        if (reason >= 0) {
+            flushLogBuffer((LogFlushReason)reason);
+        }
+    }
+}
+
+bool logPipelineRequestIdleFlush(uint32_t idleSeconds, bool deepSleep, TickType_t timeout) {
+    LogMessage message = {};
+    message.type = LOG_MESSAGE_IDLE;
+    message.idle.seconds = idleSeconds;
+    message.idle.deepSleep = deepSleep;
+
+    // Ahead of queued readings, so IdleTask doesn't wait behind them
+    xSemaphoreTake(logFlushDoneSem, 0);
+    return xQueueSendToFront(csvLogQueue, &message, pdMS_TO_TICKS(100)) == pdTRUE &&
+           xSemaphoreTake(logFlushDoneSem, timeout) == pdTRUE;
+}
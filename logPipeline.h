@@ -0,0 +1,75 @@
+#ifndef LOGPIPELINE_H
+#define LOGPIPELINE_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "sensorRegistry.h"
+
+// Reading pipeline from the sensors to the card
+//   sensorDataQueue -> dataDistributorTask -> renderDataQueue (display), hot cache, sensor registry
+//                                          -> csvLogQueue -> SDLogTask -> write buffer -> log segments
+// SDLogTask checks the card before each flush and remounts it after a failure. Queue depth,
+// readings lost to full queues and card outages are counted here (/sd-stats); the host harness
+// in bench/pipebench.cpp runs these tasks against a slow or failing card to size the queues.
+
+#ifndef SENSOR_DATA_QUEUE_LENGTH
+#define SENSOR_DATA_QUEUE_LENGTH 10
+#endif
+#ifndef RENDER_DATA_QUEUE_LENGTH
+#define RENDER_DATA_QUEUE_LENGTH 4
+#endif
+#ifndef CSV_LOG_QUEUE_LENGTH
+#define CSV_LOG_QUEUE_LENGTH 12
+#endif
+
+extern QueueHandle_t sensorDataQueue;
+extern QueueHandle_t renderDataQueue;
+extern QueueHandle_t csvLogQueue;         // LogMessage items
+extern SemaphoreHandle_t logFlushDoneSem;   // Given by SDLogTask when an idle request is handled
+extern bool sdCardInitialized;
+
+typedef enum {
+    LOG_MESSAGE_READING = 0,
+    LOG_MESSAGE_IDLE                // IdleTask going idle or into deep sleep
+} LogMessageType;
+
+// csvLogQueue item - a reading for the log, or an idle request SDLogTask answers on logFlushDoneSem
+typedef struct {
+    LogMessageType type;
+    union {
+        SensorData reading;
+        struct {
+            uint32_t seconds;       // Length of the coming idle period
+            bool deepSleep;         // PSRAM is lost
+        } idle;
+    };
+} LogMessage;
+
+typedef struct {
+    uint32_t readings;              // Received by dataDistributorTask
+    uint32_t renderDropped;         // renderDataQueue full
+    uint32_t logDropped;            // csvLogQueue full - lost for the log
+    uint32_t logQueueMax;           // Highest csvLogQueue depth seen
+    uint32_t outages;               // Card lost during operation
+    uint32_t lastOutageMs;          // Card lost until remounted, last outage
+    uint32_t maxOutageMs;
+    uint32_t outageSinceMs;         // millis() the current outage started, 0 with the card up
+} LogPipelineStats;
+
+// Board specific mount, defined by the firmware (pins, SPI bus) or the harness
+bool initializeSDCard();
+// Quick health check of a mounted card, remount attempts every few seconds otherwise
+bool checkAndReinitSDCard();
+
+void dataDistributorTask(void *parameter);
+void SDLogTask(void *pvParameters);
+
+LogPipelineStats logPipelineGetStats();
+
+// Asks SDLogTask to flush the write buffer if the idle period (or deep sleep) would exceed the
+// data-loss window; false if the request wasn't confirmed within timeout
+bool logPipelineRequestIdleFlush(uint32_t idleSeconds, bool deepSleep, TickType_t timeout);
+
+#endif /* LOGPIPELINE_H */
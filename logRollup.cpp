@@ -0,0 +1,639 @@
+#include "logRollup.h"
+#include "logHotCache.h"
+
+const int32_t logRollupTierSeconds[LOG_ROLLUP_TIERS] = {300, 3600, 86400, 604800};
+static const char* tierNames[LOG_ROLLUP_TIERS] = {"5m", "1h", "1d", "1w"};
+
+#define ROLLUP_ROW_SIZE sizeof(LogRollupRow)
+
+// Cached tail of each rollup file - the open bucket is updated in place without reading it back
+typedef struct {
+    char sensor[LOG_SENSOR_NAME_MAX];
+    bool loaded;
+    uint32_t rowCount;
+    uint32_t revision;          // Header copy, see logRollup.h
+    LogRollupRow last;
+} RollupState;
+
+static RollupState states[LOG_ROLLUP_MAX_SENSORS][LOG_ROLLUP_TIERS];
+static SemaphoreHandle_t rollupMutex = NULL;
+
+static void lockRollup() {
+    if (rollupMutex == NULL) {
+        rollupMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(rollupMutex, portMAX_DELAY);
+}
+
+static void unlockRollup() {
+    xSemaphoreGive(rollupMutex);
+}
+
+//################## Buckets ##################
+
+int32_t logRollupBucketStart(int32_t timestamp, LogRollupTier tier) {
+    if (tier == LOG_ROLLUP_WEEK) {
+        // 1970-01-01 was a Thursday - shift so weeks start on Monday
+        int32_t days = timestamp / 86400;
+        return (days - (days + 3) % 7) * 86400;
+    }
+    return timestamp - timestamp % logRollupTierSeconds[tier];
+}
+
+bool logRollupPath(const char *sensor, LogRollupTier tier, char *path, size_t len) {
+    int written = snprintf(path, len, LOG_ROLLUP_DIR "/%s_%s.bin", sensor, tierNames[tier]);
+    return written > 0 && (size_t)written < len;
+}
+
+LogRollupTier logRollupTierForStep(int32_t stepSeconds) {
+    for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+        if (logRollupTierSeconds[tier] >= stepSeconds) return (LogRollupTier)tier;
+    }
+    return LOG_ROLLUP_WEEK;
+}
+
+LogRollupTier logRollupTierForRange(int32_t rangeSeconds, uint32_t maxRows) {
+    for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+        if ((uint32_t)(rangeSeconds / logRollupTierSeconds[tier]) <= maxRows) return (LogRollupTier)tier;
+    }
+    return LOG_ROLLUP_WEEK;
+}
+
+static void mergeField(LogRollupField &field, int16_t value, int32_t timestamp, bool first) {
+    if (first) {
+        field.sum = 0;
+        field.min = field.max = value;
+        field.minTs = field.maxTs = timestamp;
+    }
+    field.sum += value;
+    if (value < field.min) {
+        field.min = value;
+        field.minTs = timestamp;
+    }
+    if (value > field.max) {
+        field.max = value;
+        field.maxTs = timestamp;
+    }
+}
+
+static void mergeRecord(LogRollupRow &row, const LogRecord &rec) {
+    bool first = row.count == 0;
+    mergeField(row.temperature, rec.temperature, rec.timestamp, first);
+    mergeField(row.humidity, rec.humidity, rec.timestamp, first);
+    row.count++;
+
+    if (rec.flags & LOG_FLAG_HAS_PRESSURE) {
+        mergeField(row.pressure, rec.pressure, rec.timestamp, row.pressureCount == 0);
+        row.pressureCount++;
+    }
+}
+
+static void startRow(LogRollupRow &row, int32_t bucketStart) {
+    memset(&row, 0, sizeof(row));
+    row.bucketStart = bucketStart;
+}
+
+//################## Files ##################
+
+static RollupState* stateFor(const char *sensor, LogRollupTier tier) {
+    for (int i = 0; i < LOG_ROLLUP_MAX_SENSORS; i++) {
+        if (states[i][0].sensor[0] != '\0' && strcmp(states[i][0].sensor, sensor) == 0) return &states[i][tier];
+    }
+    for (int i = 0; i < LOG_ROLLUP_MAX_SENSORS; i++) {
+        if (states[i][0].sensor[0] == '\0') {
+            for (int t = 0; t < LOG_ROLLUP_TIERS; t++) {
+                strncpy(states[i][t].sensor, sensor, LOG_SENSOR_NAME_MAX - 1);
+                states[i][t].loaded = false;
+            }
+            return &states[i][tier];
+        }
+    }
+    Serial.printf("[ERROR] No rollup slot for sensor %s\n", sensor);
+    return NULL;
+}
+
+static bool loadState(RollupState &state, LogRollupTier tier) {
+    if (state.loaded) return true;
+
+    char path[48];
+    logRollupPath(state.sensor, tier, path, sizeof(path));
+    state.rowCount = 0;
+    state.revision = 0;
+
+    File file = SD.open(path, FILE_READ);
+    if (file) {
+        LogFileHeader header;
+        if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+            header.magic != LOG_ROLLUP_MAGIC || header.recordSize != ROLLUP_ROW_SIZE) {
+            Serial.printf("[ERROR] %s is not a valid rollup file, rebuilding it\n", path);
+            file.close();
+            SD.remove(path);
+        } else {
+            state.rowCount = (file.size() - LOG_HEADER_SIZE) / ROLLUP_ROW_SIZE;
+            state.revision = header.reserved;
+            if (state.rowCount > 0) {
+                file.seek(LOG_HEADER_SIZE + (state.rowCount - 1) * ROLLUP_ROW_SIZE);
+                file.read((uint8_t*)&state.last, ROLLUP_ROW_SIZE);
+            }
+            file.close();
+        }
+    }
+
+    state.loaded = true;
+    return true;
+}
+
+static File openForUpdate(const char *path) {
+    if (!SD.exists(path)) {
+        if (!SD.exists(LOG_ROLLUP_DIR)) SD.mkdir(LOG_ROLLUP_DIR);
+
+        File file = SD.open(path, FILE_WRITE);
+        if (!file) return file;
+
+        LogFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = LOG_ROLLUP_MAGIC;
+        header.version = LOG_FORMAT_VERSION;
+        header.recordSize = ROLLUP_ROW_SIZE;
+        file.write((uint8_t*)&header, sizeof(header));
+        file.close();
+    }
+    // Append mode ignores seeks - rows are rewritten in place
+    return SD.open(path, "r+");
+}
+
+static bool writeRow(File &file, uint32_t index, const LogRollupRow &row) {
+    return file.seek(LOG_HEADER_SIZE + index * ROLLUP_ROW_SIZE) &&
+           file.write((const uint8_t*)&row, ROLLUP_ROW_SIZE) == ROLLUP_ROW_SIZE;
+}
+
+// Binary search for a bucket among the rows already on the card
+static bool findRow(File &file, uint32_t rows, int32_t bucketStart, uint32_t &index, LogRollupRow &row) {
+    uint32_t low = 0, high = rows;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (!file.seek(LOG_HEADER_SIZE + mid * ROLLUP_ROW_SIZE) ||
+            file.read((uint8_t*)&row, ROLLUP_ROW_SIZE) != ROLLUP_ROW_SIZE) {
+            return false;
+        }
+        if (row.bucketStart == bucketStart) {
+            index = mid;
+            return true;
+        }
+        if (row.bucketStart < bucketStart) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+// Merges rows for buckets missing from the file (sorted, all older than the last row) into it.
+// Works backwards from the end, so each row on the card past the first insertion point is read
+// and moved once, in blocks of ROLLUP_MOVE_ROWS
+#define ROLLUP_MOVE_ROWS 32
+
+static bool insertRows(File &file, uint32_t rows, const LogRollupRow *added, uint32_t addedCount) {
+    LogRollupRow in[ROLLUP_MOVE_ROWS];
+    LogRollupRow out[ROLLUP_MOVE_ROWS];
+    uint32_t inCount = 0;                   // Rows of in[] not placed yet, in[0..inCount)
+    uint32_t outCount = 0;                  // Rows in out[ROLLUP_MOVE_ROWS - outCount..]
+    uint32_t readFrom = rows;               // Rows [readFrom, rows) are read
+    uint32_t writeTo = rows + addedCount;   // Rows [writeTo, rows + addedCount) are written
+
+    while (addedCount > 0) {
+        if (inCount == 0 && readFrom > 0) {
+            inCount = min((uint32_t)ROLLUP_MOVE_ROWS, readFrom);
+            readFrom -= inCount;
+            if (!file.seek(LOG_HEADER_SIZE + readFrom * ROLLUP_ROW_SIZE) ||
+                file.read((uint8_t*)in, inCount * ROLLUP_ROW_SIZE) != inCount * ROLLUP_ROW_SIZE) {
+                return false;
+            }
+        }
+
+        if (inCount > 0 && in[inCount - 1].bucketStart > added[addedCount - 1].bucketStart) {
+            out[ROLLUP_MOVE_ROWS - 1 - outCount++] = in[--inCount];
+        } else {
+            out[ROLLUP_MOVE_ROWS - 1 - outCount++] = added[--addedCount];
+        }
+
+        // Flush when full, and once all new rows are placed - the rows below stay where they are
+        if (outCount == ROLLUP_MOVE_ROWS || addedCount == 0) {
+            writeTo -= outCount;
+            if (!file.seek(LOG_HEADER_SIZE + writeTo * ROLLUP_ROW_SIZE) ||
+                file.write((const uint8_t*)&out[ROLLUP_MOVE_ROWS - outCount], outCount * ROLLUP_ROW_SIZE) !=
+                    outCount * ROLLUP_ROW_SIZE) {
+                return false;
+            }
+            outCount = 0;
+        }
+    }
+    // Unplaced rows left in in[] already sit at their own position (writeTo == readFrom + inCount)
+    return true;
+}
+
+// Folds records into one tier - one file open, the open bucket is written once at the end
+static bool applyTier(RollupState &state, LogRollupTier tier, const LogRecord *recs, size_t count) {
+    char path[48];
+    logRollupPath(state.sensor, tier, path, sizeof(path));
+
+    File file = openForUpdate(path);
+    if (!file) {
+        Serial.printf("[ERROR] Failed to open %s for update\n", path);
+        return false;
+    }
+
+    bool ok = true;
+    bool dirty = false;
+    bool revised = false;           // A settled bucket changed
+    int32_t settledBefore = time(nullptr) - LOG_ROLLUP_SETTLE_S;
+    LogRollupRow *added = NULL;     // Rows for late records whose bucket isn't on the card yet
+    uint32_t addedCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t bucketStart = logRollupBucketStart(recs[i].timestamp, tier);
+
+        if (state.rowCount > 0 && bucketStart == state.last.bucketStart) {
+            mergeRecord(state.last, recs[i]);
+            dirty = true;
+            if (bucketStart + logRollupTierSeconds[tier] <= settledBefore) revised = true;
+        } else if (state.rowCount == 0 || bucketStart > state.last.bucketStart) {
+            // Bucket closed - next one starts
+            if (dirty) ok &= writeRow(file, state.rowCount - 1, state.last);
+            startRow(state.last, bucketStart);
+            mergeRecord(state.last, recs[i]);
+            state.rowCount++;
+            dirty = true;
+        } else {
+            // Late record for an older bucket - updated in place if the bucket exists
+            LogRollupRow row;
+            uint32_t index;
+            revised = true;
+            if (findRow(file, state.rowCount - 1, bucketStart, index, row)) {
+                mergeRecord(row, recs[i]);
+                ok &= writeRow(file, index, row);
+                continue;
+            }
+
+            // Otherwise a new row, inserted once all records are folded in
+            uint32_t a = addedCount;
+            while (a > 0 && added[a - 1].bucketStart > bucketStart) a--;
+            if (a > 0 && added[a - 1].bucketStart == bucketStart) {
+                mergeRecord(added[a - 1], recs[i]);
+                continue;
+            }
+            if (added == NULL) {
+                added = (LogRollupRow*)ps_malloc(count * sizeof(LogRollupRow));
+                if (!added) added = (LogRollupRow*)malloc(count * sizeof(LogRollupRow));
+                if (!added) {
+                    Serial.printf("[ERROR] Failed to allocate late rows for %s\n", path);
+                    ok = false;
+                    continue;
+                }
+            }
+            memmove(&added[a + 1], &added[a], (addedCount - a) * sizeof(LogRollupRow));
+            startRow(added[a], bucketStart);
+            mergeRecord(added[a], recs[i]);
+            addedCount++;
+        }
+    }
+    if (dirty) ok &= writeRow(file, state.rowCount - 1, state.last);
+
+    if (addedCount > 0) {
+        // The cached last row moves up with the rest, its content stays the same; readers wait
+        // and find their place again
+        logRewriteBegin();
+        if (insertRows(file, state.rowCount, added, addedCount)) {
+            state.rowCount += addedCount;
+        } else {
+            ok = false;
+        }
+        file.flush();
+        logRewriteUnlock();
+    }
+    free(added);
+
+    if (revised) {
+        state.revision++;
+        ok &= file.seek(offsetof(LogFileHeader, reserved)) &&
+              file.write((const uint8_t*)&state.revision, sizeof(state.revision)) == sizeof(state.revision);
+    }
+    file.close();
+
+    if (!ok) {
+        // Cached tail may not match the file any more
+        state.loaded = false;
+    }
+    return ok;
+}
+
+bool logRollupAdd(const char *sensor, const LogRecord *recs, size_t count) {
+    if (count == 0) return true;
+
+    bool ok = true;
+    lockRollup();
+    for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+        RollupState *state = stateFor(sensor, (LogRollupTier)tier);
+        if (state == NULL || !loadState(*state, (LogRollupTier)tier)) {
+            ok = false;
+            continue;
+        }
+        ok &= applyTier(*state, (LogRollupTier)tier, recs, count);
+    }
+    unlockRollup();
+    return ok;
+}
+
+//################## Catch-up ##################
+
+// Replays the log from the last bucket of each tier - rebuilds rollups after an update from
+// firmware without them, or a reset between a segment write and its rollup update
+static void catchUpSensor(const char *sensor) {
+    RollupState *tierStates[LOG_ROLLUP_TIERS];
+    LogRollupRow savedLast[LOG_ROLLUP_TIERS];
+    int32_t resumeFrom[LOG_ROLLUP_TIERS];
+    int32_t replayFrom = INT32_MAX;
+
+    lockRollup();
+    for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+        tierStates[tier] = stateFor(sensor, (LogRollupTier)tier);
+        if (tierStates[tier] == NULL) {
+            unlockRollup();
+            return;
+        }
+        loadState(*tierStates[tier], (LogRollupTier)tier);
+
+        RollupState &state = *tierStates[tier];
+        if (state.rowCount > 0) {
+            // Last bucket may be incomplete - rebuilt from scratch by the replay
+            resumeFrom[tier] = state.last.bucketStart;
+            savedLast[tier] = state.last;
+            startRow(state.last, state.last.bucketStart);
+        } else {
+            resumeFrom[tier] = INT32_MIN;
+        }
+        replayFrom = min(replayFrom, resumeFrom[tier]);
+    }
+
+    LogQuery query;
+    uint32_t replayed = 0;
+    if (query.open(sensor, replayFrom, INT32_MAX)) {
+        LogRecord batch[128];
+        size_t batchCount = 0;
+        bool more = true;
+        while (more) {
+            more = query.next(batch[batchCount]);
+            if (more) batchCount++;
+
+            if (batchCount == sizeof(batch) / sizeof(batch[0]) || (!more && batchCount > 0)) {
+                // Records are in time order - each tier takes the part past its resume point
+                for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+                    size_t first = 0;
+                    while (first < batchCount && batch[first].timestamp < resumeFrom[tier]) first++;
+                    if (first < batchCount) {
+                        applyTier(*tierStates[tier], (LogRollupTier)tier, batch + first, batchCount - first);
+                    }
+                }
+                replayed += batchCount;
+                batchCount = 0;
+            }
+        }
+    }
+
+    // Nothing replayed into a reset bucket - keep what the file had
+    for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+        RollupState &state = *tierStates[tier];
+        if (resumeFrom[tier] != INT32_MIN && state.last.bucketStart == resumeFrom[tier] && state.last.count == 0) {
+            state.last = savedLast[tier];
+        }
+    }
+    unlockRollup();
+
+    if (replayed > 0) {
+        Serial.printf("[INFO] Rollups for %s caught up, %u records replayed\n", sensor, (unsigned)replayed);
+    }
+}
+
+void logRollupInit() {
+    size_t segmentCount = logListSegments(NULL, NULL, 0);
+    if (segmentCount == 0) return;
+
+    LogSegmentInfo *segments = (LogSegmentInfo*)malloc(segmentCount * sizeof(LogSegmentInfo));
+    if (!segments) return;
+    segmentCount = logListSegments(NULL, segments, segmentCount);
+
+    // Each sensor once
+    for (size_t i = 0; i < segmentCount; i++) {
+        bool seen = false;
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(segments[j].sensor, segments[i].sensor) == 0) seen = true;
+        }
+        if (!seen) catchUpSensor(segments[i].sensor);
+    }
+    free(segments);
+}
+
+//################## Reading ##################
+
+bool LogRollupReader::open(const char *sensor, LogRollupTier tier) {
+    close();
+    if (!logRollupPath(sensor, tier, path, sizeof(path))) return false;
+
+    logRewriteLock();
+    LogFileHeader header;
+    file = SD.open(path, FILE_READ);
+    bool ok = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == LOG_ROLLUP_MAGIC && header.recordSize == ROLLUP_ROW_SIZE;
+    if (ok) {
+        count = (file.size() - LOG_HEADER_SIZE) / ROLLUP_ROW_SIZE;
+        revisionCount = header.reserved;
+        generation = logRewriteGeneration();
+    } else if (file) {
+        file.close();
+    }
+    logRewriteUnlock();
+    nextIndex = 0;
+    return ok;
+}
+
+void LogRollupReader::close() {
+    if (file) file.close();
+    count = nextIndex = revisionCount = 0;
+    hasLast = false;
+    seekTs = INT32_MIN;
+}
+
+// Rows were moved up since the file was opened - reopened (the handle may hold old data) and
+// continued behind the last row returned, else from the last seek. revision() stays as opened,
+// so a chart cache built from these rows restarts on its next refresh
+bool LogRollupReader::resync() {
+    file.close();
+    file = SD.open(path, FILE_READ);
+    if (!file || file.size() < LOG_HEADER_SIZE) {
+        if (file) file.close();
+        count = nextIndex = 0;
+        return false;
+    }
+    count = (file.size() - LOG_HEADER_SIZE) / ROLLUP_ROW_SIZE;
+    generation = logRewriteGeneration();
+    if (hasLast) return seekLocked(lastBucket);
+    if (seekTs != INT32_MIN) return seekLocked(seekTs);
+    nextIndex = min(nextIndex, count);
+    return file.seek(LOG_HEADER_SIZE + nextIndex * ROLLUP_ROW_SIZE);
+}
+
+// Positions the reader at the first bucket that ends after startTime
+bool LogRollupReader::seek(int32_t startTime) {
+    hasLast = false;
+    seekTs = startTime;
+
+    logRewriteLock();
+    bool ok = (generation == logRewriteGeneration() || resync()) && seekLocked(startTime);
+    logRewriteUnlock();
+    return ok;
+}
+
+bool LogRollupReader::seekLocked(int32_t startTime) {
+    if (!file) return false;
+
+    uint32_t low = 0, high = count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        LogRollupRow row;
+        if (!file.seek(LOG_HEADER_SIZE + mid * ROLLUP_ROW_SIZE) ||
+            file.read((uint8_t*)&row, ROLLUP_ROW_SIZE) != ROLLUP_ROW_SIZE) {
+            return false;
+        }
+        if (row.bucketStart <= startTime) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    nextIndex = low > 0 ? low - 1 : 0;
+    return file.seek(LOG_HEADER_SIZE + nextIndex * ROLLUP_ROW_SIZE);
+}
+
+bool LogRollupReader::next(LogRollupRow &row) {
+    bool ok = false;
+    logRewriteLock();
+    if (generation == logRewriteGeneration() || resync()) {
+        while (file && nextIndex < count && file.read((uint8_t*)&row, ROLLUP_ROW_SIZE) == ROLLUP_ROW_SIZE) {
+            nextIndex++;
+            // Buckets are strictly ascending - rows up to the last one returned were already read
+            if (hasLast && row.bucketStart <= lastBucket) continue;
+            ok = true;
+            break;
+        }
+    }
+    logRewriteUnlock();
+    if (ok) {
+        lastBucket = row.bucketStart;
+        hasLast = true;
+    }
+    return ok;
+}
+
+//################## Range statistics ##################
+
+static void initRangeField(LogRangeField &field) {
+    field.sum = 0;
+    field.min = INT16_MAX;
+    field.max = INT16_MIN;
+    field.minTs = field.maxTs = 0;
+}
+
+static void foldRangeValue(LogRangeField &field, int16_t value, int32_t timestamp) {
+    if (value < field.min) {
+        field.min = value;
+        field.minTs = timestamp;
+    }
+    if (value > field.max) {
+        field.max = value;
+        field.maxTs = timestamp;
+    }
+    field.sum += value;
+}
+
+static void foldRangeRow(LogRangeField &field, const LogRollupField &row) {
+    if (row.min < field.min) {
+        field.min = row.min;
+        field.minTs = row.minTs;
+    }
+    if (row.max > field.max) {
+        field.max = row.max;
+        field.maxTs = row.maxTs;
+    }
+    field.sum += row.sum;
+}
+
+static void foldRangeRecord(LogRangeStats &stats, const LogRecord &rec) {
+    foldRangeValue(stats.temperature, rec.temperature, rec.timestamp);
+    foldRangeValue(stats.humidity, rec.humidity, rec.timestamp);
+    if (rec.flags & LOG_FLAG_HAS_PRESSURE) {
+        foldRangeValue(stats.pressure, rec.pressure, rec.timestamp);
+        stats.pressureCount++;
+    }
+    stats.count++;
+}
+
+// Edge of a range - records not yet flushed to the card are in the hot cache
+static void foldRangeRaw(const char *sensor, int32_t start, int32_t end, LogRangeStats &stats) {
+    if (start > end) return;
+
+    LogRecord rec;
+    LogHotCacheReader hotReader;
+    if (logHotCacheCovers(sensor, start) && hotReader.open(sensor, start, end)) {
+        while (hotReader.next(rec)) foldRangeRecord(stats, rec);
+        return;
+    }
+
+    LogQuery query;
+    if (!query.open(sensor, start, end)) return;
+    while (query.next(rec)) foldRangeRecord(stats, rec);
+    query.close();
+}
+
+bool logRangeStats(const char *sensor, int32_t start, int32_t end, uint32_t maxRows, LogRangeStats &stats) {
+    memset(&stats, 0, sizeof(stats));
+    initRangeField(stats.temperature);
+    initRangeField(stats.humidity);
+    initRangeField(stats.pressure);
+
+    LogRollupTier tier = logRollupTierForRange(end - start, maxRows);
+    LogRollupReader reader;
+    if (!reader.open(sensor, tier)) return false;
+
+    // Buckets [interiorStart, interiorEnd) lie entirely inside [start, end] and are settled -
+    // rows of newer ones miss records still in the write-behind buffer
+    int32_t interiorStart = logRollupBucketStart(start, tier);
+    if (interiorStart < start) interiorStart += logRollupTierSeconds[tier];
+    int32_t interiorEnd = min(logRollupBucketStart(end + 1, tier),
+                              logRollupBucketStart(time(nullptr) - LOG_ROLLUP_SETTLE_S, tier));
+    if (interiorStart >= interiorEnd) {
+        reader.close();
+        foldRangeRaw(sensor, start, end, stats);
+        return true;
+    }
+
+    foldRangeRaw(sensor, start, interiorStart - 1, stats);
+
+    LogRollupRow row;
+    if (reader.seek(interiorStart)) {
+        while (reader.next(row) && row.bucketStart < interiorEnd) {
+            if (row.count == 0 || row.bucketStart < interiorStart) continue;
+            foldRangeRow(stats.temperature, row.temperature);
+            foldRangeRow(stats.humidity, row.humidity);
+            if (row.pressureCount > 0) {
+                foldRangeRow(stats.pressure, row.pressure);
+                stats.pressureCount += row.pressureCount;
+            }
+            stats.count += row.count;
+        }
+    }
+    reader.close();
+
+    foldRangeRaw(sensor, interiorEnd, end, stats);
+    return true;
+}
@@ -0,0 +1,122 @@
+#ifndef LOGROLLUP_H
+#define LOGROLLUP_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+#include "logStorage.h"
+#include "logWriteBuffer.h"
+
+// Rollup tiers - pre-aggregated sensor data maintained at ingest time
+// Every record written by logAppendBatch() is folded into the current bucket of each tier,
+// so charts and min/max read a few hundred rollup rows instead of the raw log.
+// Buckets are aligned to UTC boundaries: 5 min, full hour, midnight, Monday midnight.
+//   /logs/rollup/<sensor>_<tier>.bin - LogFileHeader (LOG_ROLLUP_MAGIC) + LogRollupRows in bucket order
+// A bucket is settled once it ended LOG_ROLLUP_SETTLE_S ago - the write-behind buffer has written
+// all its records by then. Late records can still change it; the header's reserved field counts
+// these revisions so caches of settled buckets (chartCache) know to start over.
+
+#define LOG_ROLLUP_DIR "/logs/rollup"
+#define LOG_ROLLUP_MAGIC 0x4C4F5257     // "WROL" little endian
+#define LOG_ROLLUP_MAX_SENSORS LOG_MAX_SENSORS
+#define LOG_ROLLUP_SETTLE_S LOG_BUFFER_MAX_AGE_S
+
+typedef enum {
+    LOG_ROLLUP_5MIN = 0,
+    LOG_ROLLUP_HOUR,
+    LOG_ROLLUP_DAY,
+    LOG_ROLLUP_WEEK,
+    LOG_ROLLUP_TIERS
+} LogRollupTier;
+
+// Per field aggregate, values in the same fixed point scale as LogRecord
+typedef struct __attribute__((packed)) {
+    int32_t sum;
+    int16_t min;
+    int16_t max;
+    int32_t minTs;
+    int32_t maxTs;
+} LogRollupField;
+
+typedef struct __attribute__((packed)) {
+    int32_t bucketStart;
+    uint16_t count;
+    uint16_t pressureCount;     // Records with LOG_FLAG_HAS_PRESSURE
+    LogRollupField temperature;
+    LogRollupField humidity;
+    LogRollupField pressure;
+} LogRollupRow;
+
+extern const int32_t logRollupTierSeconds[LOG_ROLLUP_TIERS];
+
+int32_t logRollupBucketStart(int32_t timestamp, LogRollupTier tier);
+bool logRollupPath(const char *sensor, LogRollupTier tier, char *path, size_t len);
+
+// Finest tier whose buckets are at least stepSeconds long
+LogRollupTier logRollupTierForStep(int32_t stepSeconds);
+// Finest tier covering rangeSeconds in at most maxRows buckets
+LogRollupTier logRollupTierForRange(int32_t rangeSeconds, uint32_t maxRows);
+
+// Startup - brings rollups up to date with the log segments (also builds them for existing logs)
+void logRollupInit();
+// Folds records of one sensor into all tiers, called by logAppendBatch() after a successful write
+bool logRollupAdd(const char *sensor, const LogRecord *recs, size_t count);
+
+inline float logRollupAverage(const LogRollupField &field, uint16_t count, float scale) {
+    return count > 0 ? field.sum / (float)count / scale : 0;
+}
+
+// Range aggregate with 64 bit sums - a year of 10 s records overflows a rollup field
+typedef struct {
+    int64_t sum;
+    int16_t min;
+    int16_t max;
+    int32_t minTs;
+    int32_t maxTs;
+} LogRangeField;
+
+typedef struct {
+    uint32_t count;
+    uint32_t pressureCount;
+    LogRangeField temperature;
+    LogRangeField humidity;
+    LogRangeField pressure;
+} LogRangeStats;
+
+// Exact min/max/sum over [start, end] - rows of the finest tier covering the range in maxRows
+// buckets for every settled bucket entirely inside it, raw records (hot cache, else the log) for
+// the partial bucket at the start and everything after the last settled one. False if the tier
+// can't be read.
+bool logRangeStats(const char *sensor, int32_t start, int32_t end, uint32_t maxRows, LogRangeStats &stats);
+
+// Sequential reader of one rollup tier
+class LogRollupReader {
+    public:
+        LogRollupReader() : count(0), nextIndex(0), revisionCount(0), generation(0), seekTs(INT32_MIN),
+                            lastBucket(0), hasLast(false) { path[0] = '\0'; }
+        ~LogRollupReader() { close(); }
+
+        bool open(const char *sensor, LogRollupTier tier);
+        void close();
+        uint32_t rowCount() const { return count; }
+        // Changes to settled buckets since the file was created
+        uint32_t revision() const { return revisionCount; }
+        bool seek(int32_t startTime);
+        bool next(LogRollupRow &row);
+
+    private:
+        bool resync();
+        bool seekLocked(int32_t startTime);
+
+        File file;
+        char path[48];
+        uint32_t count;
+        uint32_t nextIndex;
+        uint32_t revisionCount;
+        uint32_t generation;        // logRewriteGeneration() the open file matches
+        int32_t seekTs;             // Last seek(), INT32_MIN if none
+        int32_t lastBucket;         // Last row returned since the last seek
+        bool hasLast;
+};
+
+#endif /* LOGROLLUP_H */
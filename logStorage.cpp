@@ -0,0 +1,1747 @@
+#include "logStorage.h"
+#include "logRollup.h"
+#include "logArchive.h"
+#include "logCSVScanner.h"
+#include "fileCatalog.h"
+#include "sdStats.h"
+#include <time.h>
+
+const char* insideLogName = "inside";
+const char* outsideLogName = "outside";
+
+// Segment manifest - shared between SDLogTask (writer) and the web server (readers)
+static LogSegmentInfo manifest[LOG_MAX_SEGMENTS];
+static size_t manifestCount = 0;
+static bool manifestLoaded = false;
+static SemaphoreHandle_t manifestMutex = NULL;
+
+static void lockManifest() {
+    if (manifestMutex == NULL) {
+        manifestMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(manifestMutex, portMAX_DELAY);
+}
+
+static void unlockManifest() {
+    xSemaphoreGive(manifestMutex);
+}
+
+// In-place rewrites of segments and rollups, see logStorage.h - recursive, a merge reads the
+// file back for its index while holding it
+static SemaphoreHandle_t rewriteMutex = NULL;
+static uint32_t rewriteGeneration = 0;
+
+void logRewriteLock() {
+    if (rewriteMutex == NULL) {
+        rewriteMutex = xSemaphoreCreateRecursiveMutex();
+    }
+    xSemaphoreTakeRecursive(rewriteMutex, portMAX_DELAY);
+}
+
+void logRewriteUnlock() {
+    xSemaphoreGiveRecursive(rewriteMutex);
+}
+
+void logRewriteBegin() {
+    logRewriteLock();
+    rewriteGeneration++;
+}
+
+uint32_t logRewriteGeneration() {
+    return rewriteGeneration;
+}
+
+//################## Record conversion ##################
+
+// Clamp scaled value into int16 range before storing
+static int16_t scaleToInt16(float value, float scale) {
+    float scaled = roundf(value * scale);
+    if (scaled > INT16_MAX) return INT16_MAX;
+    if (scaled < INT16_MIN) return INT16_MIN;
+    return (int16_t)scaled;
+}
+
+LogRecord logMakeRecord(int32_t timestamp, float temperature, float humidity, float pressure,
+                        uint8_t batPercentage, bool hasPressure) {
+    LogRecord rec;
+    rec.timestamp = timestamp;
+    rec.temperature = scaleToInt16(temperature, LOG_TEMP_SCALE);
+    rec.humidity = scaleToInt16(humidity, LOG_HUMIDITY_SCALE);
+    rec.pressure = hasPressure ? scaleToInt16(pressure, LOG_PRESSURE_SCALE) : 0;
+    rec.batPercentage = batPercentage;
+    rec.flags = hasPressure ? LOG_FLAG_HAS_PRESSURE : 0;
+    logRecordSeal(rec);
+    return rec;
+}
+
+// CRC-16/CCITT-FALSE, bitwise - 12 bytes per record don't justify a table
+uint16_t logRecordCrc(const LogRecord &rec) {
+    const uint8_t *data = (const uint8_t*)&rec;
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < offsetof(LogRecord, crc); i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Same line format the CSV logs always had: timestamp,temp,humidity,pressure,battery
+size_t logFormatCSVLine(const LogRecord &rec, char *buffer, size_t len) {
+    int written = snprintf(buffer, len, "%d,%.2f,%.1f,%.1f,%d\n", (int)rec.timestamp,
+                           logRecordTemperature(rec), logRecordHumidity(rec),
+                           logRecordPressure(rec), rec.batPercentage);
+    if (written < 0) return 0;
+    return min((size_t)written, len - 1);
+}
+
+//################## Months ##################
+
+uint32_t logMonthOf(int32_t timestamp) {
+    time_t t = timestamp;
+    struct tm timeinfo;
+    gmtime_r(&t, &timeinfo);
+    return (timeinfo.tm_year + 1900) * 100 + timeinfo.tm_mon + 1;
+}
+
+uint32_t logNextMonth(uint32_t month) {
+    return (month % 100 == 12) ? (month / 100 + 1) * 100 + 1 : month + 1;
+}
+
+static uint32_t monthsBefore(uint32_t month, int months) {
+    int total = (month / 100) * 12 + (month % 100 - 1) - months;
+    return (total / 12) * 100 + total % 12 + 1;
+}
+
+// First second of the month in UTC (days-from-civil, newlib has no timegm)
+int32_t logMonthStart(uint32_t month) {
+    int y = month / 100;
+    int m = month % 100;
+    y -= m <= 2;
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int32_t)(era * 146097 + doe - 719468) * 86400;
+}
+
+bool logSegmentPath(const char *sensor, uint32_t month, char *path, size_t len) {
+    int written = snprintf(path, len, LOG_DIR "/%s_%06u.bin", sensor, (unsigned)month);
+    return written > 0 && (size_t)written < len;
+}
+
+// Plain or compressed file of a manifest segment
+bool logSegmentFilePath(const LogSegmentInfo &segment, char *path, size_t len) {
+    int written = snprintf(path, len, LOG_DIR "/%s_%06u.%s", segment.sensor, (unsigned)segment.month,
+                           segment.compressed ? "arc" : "bin");
+    return written > 0 && (size_t)written < len;
+}
+
+// "<sensor>_<YYYYMM>.bin" / ".arc" -> sensor, month, compressed
+static bool parseSegmentName(const char *name, char *sensor, uint32_t &month, bool *compressed = NULL) {
+    const char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+
+    const char *sep = strrchr(base, '_');
+    if (!sep || (size_t)(sep - base) >= LOG_SENSOR_NAME_MAX || strlen(sep) != 11) return false;
+    if (strcmp(sep + 7, ".bin") != 0 && strcmp(sep + 7, ".arc") != 0) return false;
+    if (compressed) *compressed = strcmp(sep + 7, ".arc") == 0;
+
+    unsigned parsed;
+    if (sscanf(sep + 1, "%6u", &parsed) != 1 || parsed < 200001) return false;
+
+    memcpy(sensor, base, sep - base);
+    sensor[sep - base] = '\0';
+    month = parsed;
+    return true;
+}
+
+//################## Manifest ##################
+
+static LogSegmentInfo* findSegment(const char *sensor, uint32_t month) {
+    for (size_t i = 0; i < manifestCount; i++) {
+        if (manifest[i].month == month && strcmp(manifest[i].sensor, sensor) == 0) {
+            return &manifest[i];
+        }
+    }
+    return NULL;
+}
+
+// Keeps the manifest ordered by month, so readers walk segments in time order
+static LogSegmentInfo* addSegment(const char *sensor, uint32_t month) {
+    if (manifestCount >= LOG_MAX_SEGMENTS) {
+        Serial.printf("[ERROR] Log manifest full (%d segments), lower LOG_RETENTION_MONTHS\n", LOG_MAX_SEGMENTS);
+        return NULL;
+    }
+
+    size_t pos = manifestCount;
+    while (pos > 0 && manifest[pos - 1].month > month) {
+        manifest[pos] = manifest[pos - 1];
+        pos--;
+    }
+
+    LogSegmentInfo &segment = manifest[pos];
+    memset(&segment, 0, sizeof(segment));
+    strncpy(segment.sensor, sensor, LOG_SENSOR_NAME_MAX - 1);
+    segment.month = month;
+    manifestCount++;
+    return &segment;
+}
+
+static void removeSegment(size_t pos) {
+    for (size_t i = pos; i + 1 < manifestCount; i++) {
+        manifest[i] = manifest[i + 1];
+    }
+    manifestCount--;
+}
+
+// Re-reads count and time span of a segment from its file - O(1), first and last record only
+static bool refreshSegment(LogSegmentInfo &segment) {
+    char path[48];
+    logSegmentFilePath(segment, path, sizeof(path));
+    if (!segment.compressed && !logRecoverSegment(path)) return false;
+
+    LogReader reader;
+    if (!reader.open(path) || reader.recordCount() == 0) return false;
+
+    LogRecord rec;
+    segment.count = reader.recordCount();
+    if (reader.next(rec)) {
+        segment.firstTs = rec.timestamp;
+        segment.downsampled = (rec.flags & LOG_FLAG_DOWNSAMPLED) != 0;
+    }
+    if (reader.seekRecord(segment.count - 1) && reader.next(rec)) segment.lastTs = rec.timestamp;
+    reader.close();
+
+    if (!segment.compressed) logIndexSync(path);
+    return true;
+}
+
+static void saveManifest() {
+    const char *tempPath = LOG_DIR "/manifest.tmp";
+    File file = SD.open(tempPath, FILE_WRITE);
+    if (!file) {
+        Serial.println("[ERROR] Failed to write log manifest");
+        return;
+    }
+
+    for (size_t i = 0; i < manifestCount; i++) {
+        file.printf("%s,%06u,%d,%d,%u,%u,%u\n", manifest[i].sensor, (unsigned)manifest[i].month,
+                    (int)manifest[i].firstTs, (int)manifest[i].lastTs, (unsigned)manifest[i].count,
+                    (unsigned)manifest[i].compressed, (unsigned)manifest[i].downsampled);
+    }
+    file.close();
+
+    SD.remove(LOG_MANIFEST_FILE);
+    SD.rename(tempPath, LOG_MANIFEST_FILE);
+}
+
+// Manifest is missing or unreadable - rebuild it from the segment files
+static void rebuildManifest() {
+    manifestCount = 0;
+
+    File dir = SD.open(LOG_DIR);
+    if (!dir) return;
+
+    File file = dir.openNextFile();
+    while (file) {
+        char sensor[LOG_SENSOR_NAME_MAX];
+        uint32_t month;
+        bool compressed;
+        if (!file.isDirectory() && parseSegmentName(file.name(), sensor, month, &compressed)) {
+            // Both files exist if compression was interrupted after the rename - the archive is complete
+            LogSegmentInfo *segment = findSegment(sensor, month);
+            if (segment == NULL) {
+                segment = addSegment(sensor, month);
+            } else if (!compressed) {
+                segment = NULL;
+            }
+            if (segment) {
+                segment->compressed = compressed;
+                if (!refreshSegment(*segment)) removeSegment(segment - manifest);
+            }
+        }
+        file.close();
+        file = dir.openNextFile();
+    }
+    dir.close();
+
+    // Leftovers of an interrupted compression
+    for (size_t i = 0; i < manifestCount; i++) {
+        if (!manifest[i].compressed) continue;
+        char path[48], indexPath[48];
+        logSegmentPath(manifest[i].sensor, manifest[i].month, path, sizeof(path));
+        logIndexPath(path, indexPath, sizeof(indexPath));
+        if (SD.exists(path)) SD.remove(path);
+        if (SD.exists(indexPath)) SD.remove(indexPath);
+    }
+
+    Serial.printf("[INFO] Log manifest rebuilt from %u segment files\n", (unsigned)manifestCount);
+    saveManifest();
+}
+
+static void loadManifest() {
+    if (!SD.exists(LOG_DIR)) SD.mkdir(LOG_DIR);
+
+    lockManifest();
+    manifestCount = 0;
+
+    LogCSVScanner file;
+    if (!file.open(LOG_MANIFEST_FILE)) {
+        rebuildManifest();
+        manifestLoaded = true;
+        unlockManifest();
+        return;
+    }
+
+    char *line;
+    size_t len;
+    while (file.nextLine(line, len)) {
+        LogSegmentInfo info;
+        unsigned month, count, compressed = 0, downsampled = 0;
+        int firstTs, lastTs;
+        if (sscanf(line, "%11[^,],%u,%d,%d,%u,%u,%u", info.sensor, &month, &firstTs, &lastTs, &count,
+                   &compressed, &downsampled) < 5) continue;
+
+        LogSegmentInfo *segment = addSegment(info.sensor, month);
+        if (!segment) break;
+        segment->firstTs = firstTs;
+        segment->lastTs = lastTs;
+        segment->count = count;
+        segment->compressed = compressed;
+        segment->downsampled = downsampled;
+    }
+    file.close();
+
+    // Older segments are immutable, only the newest one per sensor may have grown since the last save
+    for (size_t i = manifestCount; i-- > 0;) {
+        bool newest = true;
+        for (size_t j = i + 1; j < manifestCount; j++) {
+            if (strcmp(manifest[j].sensor, manifest[i].sensor) == 0) newest = false;
+        }
+        if (newest && !refreshSegment(manifest[i])) {
+            Serial.printf("[WARNING] Segment %s/%06u missing, dropped from manifest\n",
+                          manifest[i].sensor, (unsigned)manifest[i].month);
+            removeSegment(i);
+        }
+    }
+
+    manifestLoaded = true;
+    unlockManifest();
+    Serial.printf("[INFO] Log manifest loaded, %u segments\n", (unsigned)manifestCount);
+}
+
+size_t logListSegments(const char *sensor, LogSegmentInfo *out, size_t maxCount) {
+    size_t found = 0;
+    lockManifest();
+    for (size_t i = 0; i < manifestCount; i++) {
+        if (sensor != NULL && strcmp(manifest[i].sensor, sensor) != 0) continue;
+        if (out != NULL) {
+            if (found >= maxCount) break;
+            out[found] = manifest[i];
+        }
+        found++;
+    }
+    unlockManifest();
+    return found;
+}
+
+void logApplyRetention() {
+    if (LOG_RETENTION_MONTHS <= 0) return;
+
+    time_t now = time(nullptr);
+    if (now < 1700000000) return; // No valid time yet
+
+    uint32_t cutoff = monthsBefore(logMonthOf(now), LOG_RETENTION_MONTHS);
+    while (true) {
+        // One segment at a time - like compression below, the archiving runs without holding the
+        // manifest, so appends and readers aren't held up for a whole month's compression
+        LogSegmentInfo segment;
+        bool found = false;
+        lockManifest();
+        for (size_t i = manifestCount; i-- > 0 && !found;) {
+            if (manifest[i].month < cutoff) {
+                segment = manifest[i];
+                found = true;
+            }
+        }
+        unlockManifest();
+        if (!found) return;
+
+        char path[48], indexPath[48], archivePath[64];
+        logSegmentFilePath(segment, path, sizeof(path));
+        logIndexPath(path, indexPath, sizeof(indexPath));
+
+        // Archive directory keeps compressed segments only. The segment leaves the manifest only
+        // once its data is in the archive, a failed move is retried with the next rollover
+        bool removeSource = !LOG_ARCHIVE_EXPIRED;
+        if (LOG_ARCHIVE_EXPIRED) {
+            if (!SD.exists(LOG_ARCHIVE_DIR)) SD.mkdir(LOG_ARCHIVE_DIR);
+            snprintf(archivePath, sizeof(archivePath), LOG_ARCHIVE_DIR "/%s_%06u.arc",
+                     segment.sensor, (unsigned)segment.month);
+            removeSource = !segment.compressed && logArchiveCompress(path, archivePath);
+            if (!removeSource) {
+                if (!segment.compressed) {
+                    snprintf(archivePath, sizeof(archivePath), LOG_ARCHIVE_DIR "%s", strrchr(path, '/'));
+                }
+                if (!SD.rename(path, archivePath)) {
+                    Serial.printf("[ERROR] Retention: failed to move %s to %s\n", path, archivePath);
+                    return;
+                }
+            }
+        }
+
+        lockManifest();
+        LogSegmentInfo *entry = findSegment(segment.sensor, segment.month);
+        if (entry) removeSegment(entry - manifest);
+        saveManifest();
+        unlockManifest();
+
+        SD.remove(indexPath);
+        if (removeSource) SD.remove(path);
+        if (LOG_ARCHIVE_EXPIRED) {
+            fileCatalogAdd(archivePath);
+            Serial.printf("[INFO] Retention: archived %s to %s\n", path, archivePath);
+        } else {
+            Serial.printf("[INFO] Retention: removed %s\n", path);
+        }
+    }
+}
+
+// Compresses closed segments - at most one month per sensor was still open for late records
+void logCompressClosedSegments() {
+    time_t now = time(nullptr);
+    if (now < 1700000000) return; // No valid time yet
+
+    uint32_t cutoff = monthsBefore(logMonthOf(now), LOG_COMPRESS_AFTER_MONTHS);
+    while (true) {
+        // Pick one segment at a time, compression runs without holding the manifest
+        LogSegmentInfo segment;
+        bool found = false;
+        lockManifest();
+        for (size_t i = 0; i < manifestCount && !found; i++) {
+            if (!manifest[i].compressed && manifest[i].month <= cutoff) {
+                segment = manifest[i];
+                found = true;
+            }
+        }
+        unlockManifest();
+        if (!found) return;
+
+        char path[48], archivePath[48], indexPath[48];
+        logSegmentFilePath(segment, path, sizeof(path));
+        segment.compressed = 1;
+        logSegmentFilePath(segment, archivePath, sizeof(archivePath));
+        if (!logArchiveCompress(path, archivePath)) return;
+
+        // Readers pick up the archive from now on, the plain file goes afterwards
+        lockManifest();
+        LogSegmentInfo *entry = findSegment(segment.sensor, segment.month);
+        if (entry) entry->compressed = 1;
+        saveManifest();
+        unlockManifest();
+
+        SD.remove(path);
+        if (logIndexPath(path, indexPath, sizeof(indexPath))) SD.remove(indexPath);
+    }
+}
+
+//################## Writing ##################
+
+static void fillHeader(LogFileHeader &header) {
+    memset(&header, 0, sizeof(header));
+    header.magic = LOG_FILE_MAGIC;
+    header.version = LOG_FORMAT_VERSION;
+    header.recordSize = LOG_RECORD_SIZE;
+}
+
+// Logical record count - the header's count for preallocated files, bounded by what the file holds
+static uint32_t headerRecordCount(const LogFileHeader &header, size_t size) {
+    if (size < LOG_HEADER_SIZE || header.recordSize == 0) return 0;
+    uint32_t stored = (size - LOG_HEADER_SIZE) / header.recordSize;
+    return (header.flags & LOG_HEADER_PREALLOCATED) ? min(header.recordCount, stored) : stored;
+}
+
+uint32_t logRecordCount(File &file) {
+    LogFileHeader header;
+    if (!file.seek(0) || file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != LOG_FILE_MAGIC) return 0;
+    return headerRecordCount(header, file.size());
+}
+
+// Zero fills the file from its end up to newSize, sector aligned writes after the first
+static bool extendFile(File &file, size_t newSize) {
+    static const uint8_t zeros[512] = {0};
+    size_t size = file.size();
+    if (!file.seek(size)) return false;
+    while (size < newSize) {
+        size_t chunk = min(sizeof(zeros) - size % sizeof(zeros), newSize - size);
+        if (file.write(zeros, chunk) != chunk) return false;
+        size += chunk;
+    }
+    return true;
+}
+
+// Single open/write/close for a run of records, index sidecar updated when a boundary is crossed.
+// Records go into the preallocated tail and the header count is committed after them - the FAT
+// and the directory entry's size only change when a new LOG_PREALLOC_BYTES extent is needed.
+// A merge passes its insert point as replaceFrom, the records from there on are overwritten.
+static bool appendToFile(const char *path, const LogRecord *recs, size_t count, uint32_t replaceFrom = UINT32_MAX) {
+    SDOpTimer timer(SD_OP_APPEND);
+
+    // "r+" - append mode ignores seeks, the header is rewritten in place
+    bool created = !SD.exists(path);
+    File file = SD.open(path, created ? FILE_WRITE : "r+");
+    if (!file) {
+        Serial.printf("[ERROR] Failed to open %s for writing!\n", path);
+        timer.done(false);
+        return false;
+    }
+
+    LogFileHeader header;
+    uint32_t priorCount = 0;
+    if (created) {
+        fillHeader(header);
+    } else if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+               header.magic != LOG_FILE_MAGIC || header.recordSize != LOG_RECORD_SIZE) {
+        Serial.printf("[ERROR] %s is not a writable log file\n", path);
+        file.close();
+        timer.done(false);
+        return false;
+    } else {
+        priorCount = headerRecordCount(header, file.size());
+    }
+    // Files written before preallocation are taken over at their current length
+    header.flags |= LOG_HEADER_PREALLOCATED;
+
+    uint32_t start = min(priorCount, replaceFrom);
+    size_t dataEnd = LOG_HEADER_SIZE + start * LOG_RECORD_SIZE;
+    size_t bytes = count * LOG_RECORD_SIZE;
+    bool ok = true;
+    if (dataEnd + bytes > file.size()) {
+        size_t newSize = (dataEnd + bytes + LOG_PREALLOC_BYTES - 1) / LOG_PREALLOC_BYTES * LOG_PREALLOC_BYTES;
+        ok = extendFile(file, newSize);
+    }
+
+    size_t written = 0;
+    if (ok && file.seek(dataEnd)) written = file.write((const uint8_t*)recs, bytes);
+    ok = written == bytes;
+    if (ok) {
+        header.recordCount = start + count;
+        ok = file.seek(0) && file.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+    }
+    file.close();
+    timer.done(ok, written);
+    if (!ok) {
+        Serial.printf("[ERROR] Failed to append %u records to %s\n", (unsigned)count, path);
+        return false;
+    }
+
+    uint32_t nextIndexed = (start + LOG_INDEX_INTERVAL - 1) / LOG_INDEX_INTERVAL * LOG_INDEX_INTERVAL;
+    if (start < priorCount) {
+        logIndexSync(path, start);
+    } else if (nextIndexed < start + count) {
+        logIndexSync(path);
+    }
+    return true;
+}
+
+static LogLateStats lateStats;     // Guarded by the manifest lock
+static uint32_t dataVersion = 0;
+static time_t dataChangedAt = 0;
+
+// Time order for a batch, stable so the first of equal timestamps stays first - insertion sort,
+// batches are short and mostly sorted already
+static void sortByTime(LogRecord *recs, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        LogRecord rec = recs[i];
+        size_t pos = i;
+        while (pos > 0 && recs[pos - 1].timestamp > rec.timestamp) {
+            recs[pos] = recs[pos - 1];
+            pos--;
+        }
+        recs[pos] = rec;
+    }
+}
+
+// Timestamp of the record at index, INT32_MIN if it can't be read
+static int32_t timestampAt(LogReader &reader, uint32_t index) {
+    LogRecord rec;
+    return reader.seekRecord(index) && reader.next(rec) ? rec.timestamp : INT32_MIN;
+}
+
+// Merges sorted records that reach back behind the end of a plain segment. The log after the
+// insert point is read back, merged and rewritten from there, records repeating a logged
+// timestamp are skipped. On return recs[0..count) holds the records actually inserted.
+// A reset during the rewrite can lose records after the insert point, never the ones before it.
+static bool mergeIntoFile(const char *path, LogRecord *recs, size_t &count, LogLateStats &late) {
+    LogReader reader;
+    if (!reader.open(path) || reader.recordSize() != LOG_RECORD_SIZE) {
+        Serial.printf("[ERROR] Can't merge late records into %s\n", path);
+        return false;
+    }
+    uint32_t total = reader.recordCount();
+
+    // Rewrite is bounded - records before the oldest one it may touch are too late
+    uint32_t low = total > LOG_MERGE_MAX_RECORDS ? total - LOG_MERGE_MAX_RECORDS : 0;
+    if (low > 0) {
+        int32_t floorTs = timestampAt(reader, low);
+        size_t tooOld = 0;
+        while (tooOld < count && recs[tooOld].timestamp < floorTs) tooOld++;
+        if (tooOld > 0) {
+            Serial.printf("[WARNING] %u records more than %d records behind the end of %s dropped\n",
+                          (unsigned)tooOld, LOG_MERGE_MAX_RECORDS, path);
+            memmove(recs, recs + tooOld, (count - tooOld) * sizeof(LogRecord));
+            count -= tooOld;
+            late.dropped += tooOld;
+            if (count == 0) return true;
+        }
+    }
+
+    // Insert point - first record not older than the oldest late one
+    uint32_t high = total;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (timestampAt(reader, mid) < recs[0].timestamp) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    uint32_t insertAt = low;
+    size_t tailCount = total - insertAt;
+
+    // Tail is read in behind room for the late records, the merge then runs front to back in place
+    LogRecord *merged = (LogRecord*)ps_malloc((tailCount + count) * sizeof(LogRecord));
+    if (!merged) merged = (LogRecord*)malloc((tailCount + count) * sizeof(LogRecord));
+    if (!merged) {
+        Serial.printf("[ERROR] Failed to allocate merge buffer for %s\n", path);
+        return false;
+    }
+    size_t tailRead = 0;
+    if (reader.seekRecord(insertAt)) {
+        while (tailRead < tailCount && reader.next(merged[count + tailRead])) tailRead++;
+    }
+    reader.close();
+    if (tailRead != tailCount) {
+        free(merged);
+        Serial.printf("[ERROR] Failed to read %s for a merge\n", path);
+        return false;
+    }
+
+    // Output never overtakes the unread tail - it trails it by the late records not yet taken
+    size_t out = 0, tail = count, next = 0, inserted = 0;
+    int32_t lastTs = INT32_MIN;
+    while (next < count || tail < count + tailCount) {
+        if (next >= count || (tail < count + tailCount && merged[tail].timestamp <= recs[next].timestamp)) {
+            lastTs = merged[tail].timestamp;
+            merged[out++] = merged[tail++];
+        } else if (recs[next].timestamp == lastTs) {
+            late.duplicates++;
+            next++;
+        } else {
+            lastTs = recs[next].timestamp;
+            merged[out++] = recs[next];
+            recs[inserted++] = recs[next++];
+        }
+    }
+
+    // Records from insertAt on move - readers wait, then find their place again
+    bool ok = true;
+    if (inserted > 0) {
+        logRewriteBegin();
+        ok = appendToFile(path, merged, out, insertAt);
+        logRewriteUnlock();
+    }
+    free(merged);
+    if (ok) late.merged += inserted;
+    count = inserted;
+    return ok;
+}
+
+// Drops repeated timestamps from sorted records, keeping the first; returns the new count
+static size_t dropDuplicates(LogRecord *recs, size_t count, LogLateStats &late) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (kept > 0 && recs[i].timestamp == recs[kept - 1].timestamp) {
+            late.duplicates++;
+            continue;
+        }
+        recs[kept++] = recs[i];
+    }
+    return kept;
+}
+
+LogLateStats logGetLateStats() {
+    lockManifest();
+    LogLateStats copy = lateStats;
+    unlockManifest();
+    return copy;
+}
+
+uint32_t logDataVersion(time_t *changedAt) {
+    lockManifest();
+    uint32_t version = dataVersion;
+    if (changedAt) *changedAt = dataChangedAt;
+    unlockManifest();
+    return version;
+}
+
+bool logAppendBatch(const char *sensor, const LogRecord *recs, size_t count) {
+    if (!manifestLoaded) loadManifest();
+
+    bool ok = true;
+    bool segmentCreated = false;
+    uint32_t newestCreated = 0;
+    LogLateStats late;
+    memset(&late, 0, sizeof(late));
+    size_t i = 0;
+    while (i < count) {
+        // Run of records falling into the same monthly segment
+        uint32_t month = logMonthOf(recs[i].timestamp);
+        size_t runEnd = i + 1;
+        bool inOrder = true;
+        while (runEnd < count && logMonthOf(recs[runEnd].timestamp) == month) {
+            if (recs[runEnd].timestamp <= recs[runEnd - 1].timestamp) inOrder = false;
+            runEnd++;
+        }
+
+        // Compressed months are closed - records that late are not kept
+        lockManifest();
+        LogSegmentInfo *existing = findSegment(sensor, month);
+        bool hasSegment = existing != NULL;
+        bool compressed = existing && existing->compressed;
+        bool behind = existing && recs[i].timestamp <= existing->lastTs;
+        unlockManifest();
+        if (compressed) {
+            Serial.printf("[WARNING] %u %s records for archived month %06u dropped\n",
+                          (unsigned)(runEnd - i), sensor, (unsigned)month);
+            late.dropped += runEnd - i;
+            i = runEnd;
+            continue;
+        }
+
+        char path[48];
+        if (!logSegmentPath(sensor, month, path, sizeof(path))) {
+            ok = false;
+            i = runEnd;
+            continue;
+        }
+
+        // The common case appends as is; unsorted runs, and runs reaching back behind the end of
+        // the segment, are sorted in a copy and merged
+        const LogRecord *run = recs + i;
+        size_t runCount = runEnd - i;
+        LogRecord *sorted = NULL;
+        bool written;
+        if (inOrder && !behind) {
+            written = appendToFile(path, run, runCount);
+        } else {
+            sorted = (LogRecord*)ps_malloc(runCount * sizeof(LogRecord));
+            if (!sorted) sorted = (LogRecord*)malloc(runCount * sizeof(LogRecord));
+            if (!sorted) {
+                Serial.printf("[ERROR] Failed to allocate %u late %s records\n", (unsigned)runCount, sensor);
+                ok = false;
+                i = runEnd;
+                continue;
+            }
+            memcpy(sorted, run, runCount * sizeof(LogRecord));
+            sortByTime(sorted, runCount);
+            if (hasSegment) {
+                written = mergeIntoFile(path, sorted, runCount, late);
+                if (written && runCount > 0) {
+                    Serial.printf("[INFO] %u late %s records merged into %s\n", (unsigned)runCount, sensor, path);
+                }
+            } else {
+                runCount = dropDuplicates(sorted, runCount, late);
+                written = appendToFile(path, sorted, runCount);
+            }
+            run = sorted;
+        }
+        if (!written) ok = false;
+
+        if (written && runCount > 0) {
+            // Chart and min/max aggregates follow the log
+            logRollupAdd(sensor, run, runCount);
+
+            lockManifest();
+            LogSegmentInfo *segment = findSegment(sensor, month);
+            if (segment == NULL) {
+                segment = addSegment(sensor, month);
+                segmentCreated = true;
+                newestCreated = max(newestCreated, month);
+                if (segment) segment->firstTs = run[0].timestamp;
+            }
+            if (segment) {
+                for (size_t r = 0; r < runCount; r++) {
+                    segment->firstTs = min(segment->firstTs, run[r].timestamp);
+                    segment->lastTs = max(segment->lastTs, run[r].timestamp);
+                }
+                segment->count += runCount;
+            }
+            dataVersion++;
+            dataChangedAt = time(nullptr);
+            unlockManifest();
+        }
+        free(sorted);
+        i = runEnd;
+    }
+
+    lockManifest();
+    lateStats.merged += late.merged;
+    lateStats.duplicates += late.duplicates;
+    lateStats.dropped += late.dropped;
+    unlockManifest();
+
+    // Manifest only changes structurally when a month rolls over - no per-append rewrite
+    if (segmentCreated) {
+        lockManifest();
+        saveManifest();
+        unlockManifest();
+        // Only a live rollover closes months - imports of old data create past months that are
+        // still being filled, logStorageInit() expires and compresses them once migration is done
+        if (newestCreated >= logMonthOf(time(nullptr))) {
+            logApplyRetention();
+            logCompressClosedSegments();
+        }
+    }
+    return ok;
+}
+
+bool logAppend(const char *sensor, const LogRecord &rec) {
+    return logAppendBatch(sensor, &rec, 1);
+}
+
+//################## Recovery ##################
+
+// Rewrites the first keepRecords records of a segment as a version 2 file - the SD library
+// can't truncate, so a shortened file is copied and swapped in
+static bool rewriteSegment(const char *path, uint32_t keepRecords) {
+    char tempPath[52];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+    LogReader reader;
+    if (!reader.open(path)) return false;
+    File output = SD.open(tempPath, FILE_WRITE);
+    if (!output) return false;
+
+    LogFileHeader header;
+    fillHeader(header);
+    bool ok = output.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+
+    LogRecord batch[32];
+    size_t batchCount = 0;
+    for (uint32_t i = 0; ok && i < keepRecords && reader.next(batch[batchCount]); i++) {
+        if (++batchCount == sizeof(batch) / sizeof(batch[0])) {
+            ok = output.write((uint8_t*)batch, sizeof(batch)) == sizeof(batch);
+            batchCount = 0;
+        }
+    }
+    if (ok && batchCount > 0) {
+        ok = output.write((uint8_t*)batch, batchCount * LOG_RECORD_SIZE) == batchCount * LOG_RECORD_SIZE;
+    }
+    output.close();
+    reader.close();
+
+    if (!ok) {
+        SD.remove(tempPath);
+        return false;
+    }
+
+    // Index offsets may point past the new end or use the old record size
+    char indexPath[48];
+    if (logIndexPath(path, indexPath, sizeof(indexPath))) SD.remove(indexPath);
+    SD.remove(path);
+    return SD.rename(tempPath, path);
+}
+
+// Preallocated segments are cut or extended through their header count. Dropped records are
+// zeroed, so a later recovery doesn't take them back in.
+static bool commitRecordCount(const char *path, LogFileHeader &header, uint32_t count, uint32_t clearTo) {
+    File file = SD.open(path, "r+");
+    if (!file) return false;
+
+    bool ok = true;
+    if (count < clearTo) {
+        LogRecord zero;
+        memset(&zero, 0, sizeof(zero));
+        ok = file.seek(LOG_HEADER_SIZE + count * LOG_RECORD_SIZE);
+        for (uint32_t i = count; ok && i < clearTo; i++) {
+            ok = file.write((uint8_t*)&zero, sizeof(zero)) == sizeof(zero);
+        }
+    }
+    header.recordCount = count;
+    ok = ok && file.seek(0) && file.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+    file.close();
+    return ok;
+}
+
+// Checks the tail of a segment that may have been written when power dropped:
+// a partial trailing record and records failing their CRC are cut off, verified records of a
+// flush that didn't get to commit its count are taken in
+bool logRecoverSegment(const char *path) {
+    File file = SD.open(path, FILE_READ);
+    if (!file) return false;
+
+    LogFileHeader header;
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || header.magic != LOG_FILE_MAGIC) {
+        file.close();
+        return false;
+    }
+
+    size_t size = file.size();
+    if (header.recordSize == LOG_RECORD_SIZE_V1) {
+        // Appends need the current record size - version 1 files are converted once
+        file.close();
+        uint32_t records = (size - LOG_HEADER_SIZE) / LOG_RECORD_SIZE_V1;
+        bool ok = rewriteSegment(path, records);
+        Serial.printf("[INFO] Recovery: %s upgraded to format version %d (%u records)%s\n",
+                      path, LOG_FORMAT_VERSION, (unsigned)records, ok ? "" : " FAILED");
+        return ok;
+    }
+    if (header.recordSize != LOG_RECORD_SIZE) {
+        file.close();
+        return false;
+    }
+
+    bool preallocated = header.flags & LOG_HEADER_PREALLOCATED;
+    uint32_t capacity = (size - LOG_HEADER_SIZE) / LOG_RECORD_SIZE;
+    uint32_t records = preallocated ? min(header.recordCount, capacity) : capacity;
+    size_t tornBytes = preallocated ? 0 : (size - LOG_HEADER_SIZE) % LOG_RECORD_SIZE;
+    LogRecord rec;
+
+    // A flush torn before its count was committed leaves verifying records behind the count,
+    // the zeroed tail of the extent stops the scan
+    uint32_t found = records;
+    if (preallocated && file.seek(LOG_HEADER_SIZE + records * LOG_RECORD_SIZE)) {
+        while (found < capacity && file.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec) &&
+               rec.timestamp != 0 && logRecordValid(rec)) {
+            found++;
+        }
+    }
+
+    // Walk back from the end to the newest record that verifies
+    uint32_t scanStart = found > LOG_RECOVERY_TAIL_RECORDS ? found - LOG_RECOVERY_TAIL_RECORDS : 0;
+    uint32_t valid = found;
+    while (valid > scanStart) {
+        if (!file.seek(LOG_HEADER_SIZE + (valid - 1) * LOG_RECORD_SIZE) ||
+            file.read((uint8_t*)&rec, sizeof(rec)) != sizeof(rec)) break;
+        if (logRecordValid(rec)) break;
+        valid--;
+    }
+    file.close();
+
+    if (tornBytes == 0 && valid == records) return true;
+
+    if (valid > records) {
+        Serial.printf("[WARNING] Recovery: %s has %u uncommitted records, taken in\n", path, (unsigned)(valid - records));
+    } else {
+        Serial.printf("[WARNING] Recovery: %s has %u corrupt records and %u torn bytes at the end, truncating to %u records\n",
+                      path, (unsigned)(records - valid), (unsigned)tornBytes, (unsigned)valid);
+    }
+    if (valid == scanStart && scanStart > 0) {
+        Serial.printf("[WARNING] Recovery: no valid record in the last %u of %s\n", LOG_RECOVERY_TAIL_RECORDS, path);
+    }
+    bool ok = preallocated ? commitRecordCount(path, header, valid, found) : rewriteSegment(path, valid);
+    if (!ok) {
+        Serial.printf("[ERROR] Recovery: failed to truncate %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+//################## Compaction ##################
+
+static_assert(LOG_DOWNSAMPLE_INTERVAL >= 60 && LOG_DOWNSAMPLE_INTERVAL <= 86400,
+              "Downsample bucket sums are int32 - at most a day of 10 s records");
+
+typedef struct {
+    int32_t bucketStart;
+    uint32_t count;
+    uint32_t pressureCount;
+    int32_t temperature;        // Sums in LogRecord units
+    int32_t humidity;
+    int32_t pressure;
+    uint8_t batPercentage;      // Last reading of the bucket
+} DownsampleBucket;
+
+static int16_t roundedMean(int32_t sum, uint32_t count) {
+    int32_t half = (int32_t)count / 2;
+    return (int16_t)((sum >= 0 ? sum + half : sum - half) / (int32_t)count);
+}
+
+static void bucketRecord(const DownsampleBucket &bucket, LogRecord &rec) {
+    rec.timestamp = bucket.bucketStart;
+    rec.temperature = roundedMean(bucket.temperature, bucket.count);
+    rec.humidity = roundedMean(bucket.humidity, bucket.count);
+    rec.pressure = bucket.pressureCount > 0 ? roundedMean(bucket.pressure, bucket.pressureCount) : 0;
+    rec.batPercentage = bucket.batPercentage;
+    rec.flags = LOG_FLAG_DOWNSAMPLED | (bucket.pressureCount > 0 ? LOG_FLAG_HAS_PRESSURE : 0);
+    logRecordSeal(rec);
+}
+
+// One mean record per LOG_DOWNSAMPLE_INTERVAL bucket of srcPath into a plain segment at dstPath,
+// count and time span of the result go to segment
+static bool downsampleSegment(const char *srcPath, const char *dstPath, LogSegmentInfo &segment) {
+    LogReader reader;
+    if (!reader.open(srcPath)) return false;
+    File output = SD.open(dstPath, FILE_WRITE);
+    if (!output) return false;
+
+    LogFileHeader header;
+    fillHeader(header);
+    bool ok = output.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+
+    LogRecord batch[32];
+    size_t batchCount = 0;
+    DownsampleBucket bucket;
+    memset(&bucket, 0, sizeof(bucket));
+    segment.count = 0;
+
+    LogRecord rec;
+    bool more = true;
+    while (ok && more) {
+        more = reader.next(rec);
+        int32_t bucketStart = more ? rec.timestamp - rec.timestamp % LOG_DOWNSAMPLE_INTERVAL : 0;
+
+        if (bucket.count > 0 && (!more || bucketStart != bucket.bucketStart)) {
+            LogRecord &out = batch[batchCount++];
+            bucketRecord(bucket, out);
+            if (segment.count == 0) segment.firstTs = out.timestamp;
+            segment.lastTs = out.timestamp;
+            segment.count++;
+            memset(&bucket, 0, sizeof(bucket));
+
+            if (batchCount == sizeof(batch) / sizeof(batch[0]) || !more) {
+                ok = output.write((uint8_t*)batch, batchCount * LOG_RECORD_SIZE) == batchCount * LOG_RECORD_SIZE;
+                batchCount = 0;
+            }
+        }
+        if (!more) break;
+
+        bucket.bucketStart = bucketStart;
+        bucket.count++;
+        bucket.temperature += rec.temperature;
+        bucket.humidity += rec.humidity;
+        if (rec.flags & LOG_FLAG_HAS_PRESSURE) {
+            bucket.pressure += rec.pressure;
+            bucket.pressureCount++;
+        }
+        bucket.batPercentage = rec.batPercentage;
+    }
+    output.close();
+    reader.close();
+    return ok && segment.count > 0;
+}
+
+// Archives past LOG_DOWNSAMPLE_AFTER_MONTHS are rewritten downsampled. The new archive replaces
+// the old one by rename (logArchiveCompress()), readers see either the raw or the compacted file.
+void logDownsampleClosedSegments() {
+    if (LOG_DOWNSAMPLE_AFTER_MONTHS <= 0) return;
+
+    time_t now = time(nullptr);
+    if (now < 1700000000) return; // No valid time yet
+
+    // Plain segments still take late records - only months already compressed are compacted
+    uint32_t cutoff = monthsBefore(logMonthOf(now), max(LOG_DOWNSAMPLE_AFTER_MONTHS, LOG_COMPRESS_AFTER_MONTHS));
+    while (true) {
+        // One segment at a time, like compression
+        LogSegmentInfo segment;
+        bool found = false;
+        lockManifest();
+        for (size_t i = 0; i < manifestCount && !found; i++) {
+            if (manifest[i].compressed && !manifest[i].downsampled && manifest[i].month <= cutoff) {
+                segment = manifest[i];
+                found = true;
+            }
+        }
+        unlockManifest();
+        if (!found) return;
+
+        char path[48], tempPath[56];
+        logSegmentFilePath(segment, path, sizeof(path));
+        snprintf(tempPath, sizeof(tempPath), "%s.dsm", path);
+
+        // The archive may have been swapped in by a pass that didn't get to save the manifest
+        LogSegmentInfo compacted = segment;
+        bool ok = refreshSegment(compacted);
+        if (ok && !compacted.downsampled) {
+            ok = downsampleSegment(path, tempPath, compacted) && logArchiveCompress(tempPath, path);
+            SD.remove(tempPath);
+        }
+        if (!ok) {
+            Serial.printf("[ERROR] Compaction of %s failed\n", path);
+            return;
+        }
+
+        lockManifest();
+        LogSegmentInfo *entry = findSegment(segment.sensor, segment.month);
+        if (entry) {
+            entry->firstTs = compacted.firstTs;
+            entry->lastTs = compacted.lastTs;
+            entry->count = compacted.count;
+            entry->downsampled = 1;
+            saveManifest();
+        }
+        unlockManifest();
+
+        // Expired by retention while it was rewritten
+        if (!entry) SD.remove(path);
+
+        Serial.printf("[INFO] Compacted %s: %u -> %u records\n", path, (unsigned)segment.count,
+                      (unsigned)compacted.count);
+    }
+}
+
+static void logCompactionTask(void *parameter) {
+    // Boot, import and hot cache warm-up go first
+    vTaskDelay(pdMS_TO_TICKS(10 * 60 * 1000UL));
+    while (true) {
+        logDownsampleClosedSegments();
+        vTaskDelay((TickType_t)LOG_COMPACTION_PERIOD_HOURS * 3600 * configTICK_RATE_HZ);
+    }
+}
+
+void logCompactionStart() {
+    if (LOG_DOWNSAMPLE_AFTER_MONTHS <= 0) return;
+    if (xTaskCreate(logCompactionTask, "LogCompactTask", 6144, NULL, 1, NULL) != pdPASS) {
+        Serial.println("[ERROR] Failed to create log compaction task");
+    }
+}
+
+//################## Index sidecar ##################
+
+// "/logs/inside_202506.bin" -> "/logs/inside_202506.idx"
+bool logIndexPath(const char *filename, char *indexPath, size_t len) {
+    const char *ext = strrchr(filename, '.');
+    size_t baseLen = ext ? (size_t)(ext - filename) : strlen(filename);
+    if (baseLen + 5 > len) return false;
+
+    memcpy(indexPath, filename, baseLen);
+    strcpy(indexPath + baseLen, ".idx");
+    return true;
+}
+
+// Brings the sidecar in line with the log - appends missing entries, rebuilds a stale one
+bool logIndexSync(const char *filename, uint32_t changedFrom) {
+    char indexPath[48];
+    if (!logIndexPath(filename, indexPath, sizeof(indexPath))) return false;
+
+    LogReader reader;
+    if (!reader.open(filename)) {
+        // No log, no index
+        if (SD.exists(indexPath)) SD.remove(indexPath);
+        return false;
+    }
+
+    uint32_t expected = (reader.recordCount() + LOG_INDEX_INTERVAL - 1) / LOG_INDEX_INTERVAL;
+    uint32_t existing = 0;
+    File indexFile = SD.open(indexPath, FILE_READ);
+    if (indexFile) {
+        existing = indexFile.size() / sizeof(LogIndexEntry);
+        indexFile.close();
+    }
+
+    if (existing > expected) {
+        // Index belongs to a longer (rotated or replaced) log
+        SD.remove(indexPath);
+        existing = 0;
+    }
+    // Entries of merged records point at other timestamps now
+    uint32_t firstChanged = changedFrom == UINT32_MAX ? UINT32_MAX :
+                            (changedFrom + LOG_INDEX_INTERVAL - 1) / LOG_INDEX_INTERVAL;
+    uint32_t kept = min(existing, firstChanged);
+    if (kept == expected) return true;
+
+    // "r+" - append mode ignores seeks
+    indexFile = existing > 0 ? SD.open(indexPath, "r+") : SD.open(indexPath, FILE_WRITE);
+    if (!indexFile || !indexFile.seek(kept * sizeof(LogIndexEntry))) return false;
+
+    for (uint32_t i = kept; i < expected; i++) {
+        LogRecord rec;
+        uint32_t recordIndex = i * LOG_INDEX_INTERVAL;
+        if (!reader.seekRecord(recordIndex) || !reader.next(rec)) break;
+
+        LogIndexEntry entry = {rec.timestamp, (uint32_t)(LOG_HEADER_SIZE + recordIndex * reader.recordSize())};
+        indexFile.write((uint8_t*)&entry, sizeof(entry));
+    }
+    indexFile.close();
+
+    Serial.printf("[INFO] Index %s synced, %u -> %u entries, %u rewritten\n", indexPath,
+                  (unsigned)existing, (unsigned)expected, (unsigned)(min(existing, expected) - kept));
+    return true;
+}
+
+//################## Reading ##################
+
+bool LogReader::open(const char *filename) {
+    close();
+    logRewriteLock();
+    bool ok = openLocked(filename);
+    logRewriteUnlock();
+    return ok;
+}
+
+bool LogReader::openLocked(const char *filename) {
+    SDOpTimer timer(SD_OP_OPEN);
+    file = SD.open(filename, FILE_READ);
+    if (!file) {
+        timer.done(false);
+        return false;
+    }
+
+    LogFileHeader header;
+    if (file.read((uint8_t*)&header, sizeof(header)) >= sizeof(uint32_t) && header.magic == LOG_ARCHIVE_MAGIC) {
+        // Compressed segment - records come from the archive decoder
+        file.close();
+        archive = new LogArchiveReader();
+        if (!archive->open(filename)) {
+            delete archive;
+            archive = NULL;
+            return false;
+        }
+        count = archive->recordCount();
+        nextIndex = 0;
+        bufCount = bufPos = 0;
+        strncpy(path, filename, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        return true;
+    }
+    if (!file.seek(0) || file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != LOG_FILE_MAGIC ||
+        (header.recordSize != LOG_RECORD_SIZE && header.recordSize != LOG_RECORD_SIZE_V1)) {
+        Serial.printf("[ERROR] %s is not a valid binary log file\n", filename);
+        file.close();
+        return false;
+    }
+
+    recSize = header.recordSize;
+    count = headerRecordCount(header, file.size());
+    nextIndex = 0;
+    bufCount = bufPos = 0;
+    generation = logRewriteGeneration();
+    strncpy(path, filename, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    return true;
+}
+
+// Header of a file rewritten since it was opened - the open handle may still hold old data
+bool LogReader::reload() {
+    file.close();
+    file = SD.open(path, FILE_READ);
+    LogFileHeader header;
+    if (!file || file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != LOG_FILE_MAGIC || header.recordSize != recSize) {
+        if (file) file.close();
+        count = nextIndex = 0;
+        return false;
+    }
+    count = headerRecordCount(header, file.size());
+    generation = logRewriteGeneration();
+    return true;
+}
+
+// After a rewrite - continues behind the last record returned, else from the last seek
+bool LogReader::resync() {
+    if (!reload()) return false;
+    if (hasLast) {
+        skipping = true;
+        return seekTimeLocked(lastTs);
+    }
+    if (seekTs != INT32_MIN) return seekTimeLocked(seekTs);
+    return position(min(nextIndex, count));
+}
+
+void LogReader::close() {
+    if (file) file.close();
+    if (archive) {
+        delete archive;
+        archive = NULL;
+    }
+    count = nextIndex = 0;
+    bufCount = bufPos = 0;
+    hasLast = skipping = false;
+    seekTs = INT32_MIN;
+}
+
+bool LogReader::seekRecord(uint32_t index) {
+    if (archive) return archive->seekRecord(index);
+    hasLast = skipping = false;
+    seekTs = INT32_MIN;
+    return position(index);
+}
+
+bool LogReader::position(uint32_t index) {
+    if (!file || index > count) return false;
+    if (!file.seek(LOG_HEADER_SIZE + index * recSize)) return false;
+    nextIndex = index;
+    bufCount = bufPos = 0;
+    return true;
+}
+
+// Positions the reader at the last indexed record not newer than startTime.
+// Binary search runs on the sidecar file, so only a handful of 8-byte reads hit the card;
+// callers still skip the (at most LOG_INDEX_INTERVAL) leading records older than startTime.
+bool LogReader::seekTime(int32_t startTime) {
+    if (archive) return archive->seekTime(startTime);
+    hasLast = skipping = false;
+    seekTs = startTime;
+
+    logRewriteLock();
+    bool ok = (generation == logRewriteGeneration() || reload()) && seekTimeLocked(startTime);
+    logRewriteUnlock();
+    return ok;
+}
+
+bool LogReader::seekTimeLocked(int32_t startTime) {
+    if (!file) return false;
+
+    char indexPath[48];
+    File indexFile;
+    if (logIndexPath(path, indexPath, sizeof(indexPath))) {
+        indexFile = SD.open(indexPath, FILE_READ);
+    }
+    if (!indexFile) return position(0);
+
+    // Entries past the end of the log (stale sidecar) are ignored
+    uint32_t entries = indexFile.size() / sizeof(LogIndexEntry);
+    entries = min(entries, (count + LOG_INDEX_INTERVAL - 1) / LOG_INDEX_INTERVAL);
+
+    // Find last entry with timestamp <= startTime
+    uint32_t low = 0, high = entries;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        LogIndexEntry entry;
+        if (!indexFile.seek(mid * sizeof(LogIndexEntry)) ||
+            indexFile.read((uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+            break;
+        }
+        if (entry.timestamp <= startTime) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    indexFile.close();
+
+    uint32_t block = low > 0 ? low - 1 : 0;
+    return position(block * LOG_INDEX_INTERVAL);
+}
+
+// Next block of records, read under the rewrite lock so a merge can't move them mid-read
+bool LogReader::fill() {
+    logRewriteLock();
+    if (generation != logRewriteGeneration() && !resync()) {
+        logRewriteUnlock();
+        return false;
+    }
+    if (!file || nextIndex >= count) {
+        logRewriteUnlock();
+        return false;
+    }
+
+    size_t toRead = min((size_t)(count - nextIndex), (size_t)BUFFER_RECORDS);
+    size_t bytesRead = file.read((uint8_t*)buffer, toRead * recSize);
+    logRewriteUnlock();
+    bufCount = bytesRead / recSize;
+    bufPos = 0;
+    nextIndex += bufCount;
+    if (bufCount == 0) return false;
+
+    // Version 1 records are packed without CRC - spread them out back to front and seal
+    if (recSize != LOG_RECORD_SIZE) {
+        for (size_t i = bufCount; i-- > 0;) {
+            memmove(&buffer[i], (uint8_t*)buffer + i * recSize, recSize);
+            logRecordSeal(buffer[i]);
+        }
+    }
+    return true;
+}
+
+bool LogReader::next(LogRecord &rec) {
+    if (archive) return archive->next(rec);
+    while (true) {
+        if (bufPos >= bufCount && !fill()) return false;
+        rec = buffer[bufPos++];
+
+        // Records up to the last one returned before a rewrite were already read
+        if (skipping && rec.timestamp <= lastTs) continue;
+        skipping = false;
+        lastTs = rec.timestamp;
+        hasLast = true;
+        return true;
+    }
+}
+
+// Newest records of a sensor, walking segments from the newest one backwards. Each segment is
+// entered at the offset of its k-th last record, so the cost is O(n) whatever the log length
+size_t logReadLastRecords(const char *sensor, LogRecord *out, size_t n) {
+    size_t remaining = n;
+    uint32_t beforeMonth = UINT32_MAX;
+
+    while (remaining > 0) {
+        char path[48];
+        bool found = false;
+        lockManifest();
+        for (size_t i = manifestCount; i-- > 0;) {
+            if (manifest[i].month < beforeMonth && strcmp(manifest[i].sensor, sensor) == 0) {
+                logSegmentFilePath(manifest[i], path, sizeof(path));
+                beforeMonth = manifest[i].month;
+                found = true;
+                break;
+            }
+        }
+        unlockManifest();
+        if (!found) break;
+
+        // Older segments fill the output from the back
+        LogReader reader;
+        if (!reader.open(path) || reader.recordCount() == 0) continue;
+        size_t take = min(remaining, (size_t)reader.recordCount());
+        if (!reader.seekRecord(reader.recordCount() - take)) continue;
+
+        LogRecord *dest = out + remaining - take;
+        size_t got = 0;
+        while (got < take && reader.next(dest[got])) got++;
+        if (got < take) {
+            memmove(out + remaining - got, dest, got * sizeof(LogRecord));
+        }
+        remaining -= got;
+    }
+
+    // Fewer records than asked for - move them to the front
+    if (remaining > 0 && remaining < n) {
+        memmove(out, out + remaining, (n - remaining) * sizeof(LogRecord));
+    }
+    return n - remaining;
+}
+
+bool logReadLastRecord(const char *sensor, LogRecord &rec) {
+    return logReadLastRecords(sensor, &rec, 1) == 1;
+}
+
+bool LogQuery::open(const char *sensorName, int32_t start, int32_t end) {
+    close();
+    strncpy(sensor, sensorName, LOG_SENSOR_NAME_MAX - 1);
+    sensor[LOG_SENSOR_NAME_MAX - 1] = '\0';
+    startTime = start;
+    endTime = end;
+    month = 0;
+    singleFile = false;
+    done = false;
+    return logListSegments(sensor, NULL, 0) > 0;
+}
+
+// Reads one log file from start to end, e.g. an archived segment outside the manifest
+bool LogQuery::openFile(const char *filename) {
+    close();
+    startTime = INT32_MIN;
+    endTime = INT32_MAX;
+    singleFile = true;
+    done = !reader.open(filename);
+    return !done;
+}
+
+void LogQuery::close() {
+    reader.close();
+    done = true;
+}
+
+// Advances to the next segment (in month order) whose time span overlaps the query
+bool LogQuery::openNextSegment() {
+    reader.close();
+    while (true) {
+        uint32_t nextMonth = 0;
+        char path[48];
+        lockManifest();
+        for (size_t i = 0; i < manifestCount; i++) {
+            const LogSegmentInfo &segment = manifest[i];
+            if (segment.month > month && strcmp(segment.sensor, sensor) == 0 &&
+                segment.lastTs >= startTime && segment.firstTs <= endTime) {
+                nextMonth = segment.month;
+                logSegmentFilePath(segment, path, sizeof(path));
+                break;
+            }
+        }
+        unlockManifest();
+
+        if (nextMonth == 0) {
+            done = true;
+            return false;
+        }
+
+        month = nextMonth;
+        if (reader.open(path)) {
+            reader.seekTime(startTime);
+            return true;
+        }
+    }
+}
+
+bool LogQuery::next(LogRecord &rec) {
+    while (!done) {
+        LogRecord candidate;
+        if (!reader.next(candidate)) {
+            if (singleFile || !openNextSegment()) {
+                done = true;
+                return false;
+            }
+            continue;
+        }
+
+        if (candidate.timestamp < startTime) continue;
+
+        // Records and segments are in time order - nothing more to read past the range end
+        if (candidate.timestamp > endTime) {
+            close();
+            return false;
+        }
+
+        rec = candidate;
+        return true;
+    }
+    return false;
+}
+
+//################## CSV conversion ##################
+
+bool LogCSVStream::open(const char *sensor, int32_t start, int32_t end) {
+    pendingLen = pendingPos = 0;
+    opened = query.open(sensor, start, end);
+    return opened;
+}
+
+bool LogCSVStream::openFile(const char *filename) {
+    pendingLen = pendingPos = 0;
+    opened = query.openFile(filename);
+    return opened;
+}
+
+// Maps a download name onto log data:
+//   "<sensor>_log.csv"     - whole history of the sensor
+//   "<sensor>_YYYYMM.csv"  - one monthly segment, from the manifest or the archive directory
+bool LogCSVStream::openName(const char *csvName) {
+    opened = false;
+
+    const char *base = strrchr(csvName, '/');
+    base = base ? base + 1 : csvName;
+
+    size_t len = strlen(base);
+    if (len < 5 || len >= 40 || strcmp(base + len - 4, ".csv") != 0) return false;
+
+    char name[40];
+    memcpy(name, base, len - 4);
+    name[len - 4] = '\0';
+
+    const char *sep = strrchr(name, '_');
+    if (!sep || (size_t)(sep - name) >= LOG_SENSOR_NAME_MAX) return false;
+
+    char sensor[LOG_SENSOR_NAME_MAX];
+    memcpy(sensor, name, sep - name);
+    sensor[sep - name] = '\0';
+
+    if (strcmp(sep + 1, "log") == 0) {
+        return open(sensor, INT32_MIN, INT32_MAX);
+    }
+
+    char segmentName[48];
+    uint32_t month;
+    snprintf(segmentName, sizeof(segmentName), "%s.bin", name);
+    if (!parseSegmentName(segmentName, sensor, month)) return false;
+
+    lockManifest();
+    bool inManifest = findSegment(sensor, month) != NULL;
+    unlockManifest();
+    if (inManifest) {
+        return open(sensor, logMonthStart(month), logMonthStart(logNextMonth(month)) - 1);
+    }
+
+    // Expired segments are kept compressed, older card contents may still hold plain ones
+    char archivePath[64];
+    snprintf(archivePath, sizeof(archivePath), LOG_ARCHIVE_DIR "/%s.arc", name);
+    if (SD.exists(archivePath)) return openFile(archivePath);
+    snprintf(archivePath, sizeof(archivePath), LOG_ARCHIVE_DIR "/%s", segmentName);
+    return SD.exists(archivePath) && openFile(archivePath);
+}
+
+size_t LogCSVStream::read(uint8_t *dest, size_t maxLen) {
+    size_t total = 0;
+    while (total < maxLen) {
+        if (pendingPos >= pendingLen) {
+            LogRecord rec;
+            if (!query.next(rec)) break;
+            pendingLen = logFormatCSVLine(rec, pending, sizeof(pending));
+            pendingPos = 0;
+        }
+        size_t chunk = min(pendingLen - pendingPos, maxLen - total);
+        memcpy(dest + total, pending + pendingPos, chunk);
+        pendingPos += chunk;
+        total += chunk;
+    }
+    return total;
+}
+
+//################## Legacy log migration ##################
+
+// Format: /bacMMDDYY.<basename>
+bool logBackupFilename(const char *filename, char *backupFilename, size_t len) {
+    time_t now;
+    struct tm timeinfo;
+    time(&now);
+    localtime_r(&now, &timeinfo);
+
+    // Extract just the basename from path
+    const char *baseFilename = strrchr(filename, '/');
+    if (baseFilename != NULL) {
+        baseFilename++; // Skip the '/' character
+    } else {
+        baseFilename = filename; // No directory in path
+    }
+
+    int written = snprintf(backupFilename, len, "/bac%02d%02d%02d.%s",
+                           timeinfo.tm_mon + 1, timeinfo.tm_mday, timeinfo.tm_year % 100, baseFilename);
+    return written > 0 && (size_t)written < len;
+}
+
+// Imports CSV log lines (timestamp,temp,humidity,pressure,battery) into sensor segments
+static bool importCSV(const char *csvPath, const char *sensor, bool hasPressure) {
+    LogCSVScanner input;
+    if (!input.open(csvPath)) return false;
+
+    LogRecord batch[32];
+    size_t batchCount = 0;
+    uint32_t imported = 0, skipped = 0;
+    bool ok = true;
+
+    char *line;
+    size_t len;
+    while (input.nextLine(line, len)) {
+        LogRecord &rec = batch[batchCount];
+        if (!logParseCSVRecord(line, len, hasPressure, rec) || rec.timestamp < 1700000000) {
+            skipped++;
+            continue;
+        }
+
+        if (++batchCount == sizeof(batch) / sizeof(batch[0])) {
+            ok &= logAppendBatch(sensor, batch, batchCount);
+            imported += batchCount;
+            batchCount = 0;
+        }
+    }
+    if (batchCount > 0) {
+        ok &= logAppendBatch(sensor, batch, batchCount);
+        imported += batchCount;
+    }
+    skipped += input.skippedLines();
+    input.close();
+
+    Serial.printf("[INFO] Imported %u records from %s into %s segments (%u lines skipped)\n",
+                  imported, csvPath, sensor, skipped);
+    return ok;
+}
+
+// Imports a single-file binary log written by older firmware into sensor segments
+static bool importBinaryLog(const char *path, const char *sensor) {
+    LogReader reader;
+    if (!reader.open(path)) return false;
+
+    LogRecord batch[32];
+    size_t batchCount = 0;
+    bool ok = true;
+    while (reader.next(batch[batchCount])) {
+        if (++batchCount == sizeof(batch) / sizeof(batch[0])) {
+            ok &= logAppendBatch(sensor, batch, batchCount);
+            batchCount = 0;
+        }
+    }
+    if (batchCount > 0) {
+        ok &= logAppendBatch(sensor, batch, batchCount);
+    }
+
+    Serial.printf("[INFO] Imported %u records from %s into %s segments\n",
+                  reader.recordCount(), path, sensor);
+    return ok;
+}
+
+static void removeWithIndex(const char *path) {
+    char indexPath[64];
+    SD.remove(path);
+    fileCatalogRemove(path);
+    if (logIndexPath(path, indexPath, sizeof(indexPath))) SD.remove(indexPath);
+}
+
+// Moves logs of older firmware into segments:
+//   /<sensor>_log.csv                - CSV log, kept afterwards as a regular bacMMDDYY backup
+//   /bac*.<sensor>_log.bin, /<sensor>_log.bin - single-file binary logs, removed once imported
+static void migrateLegacyLogs(const char *sensor, bool hasPressure) {
+    char csvPath[32], binPath[32], binSuffix[32];
+    snprintf(csvPath, sizeof(csvPath), "/%s_log.csv", sensor);
+    snprintf(binPath, sizeof(binPath), "/%s_log.bin", sensor);
+    snprintf(binSuffix, sizeof(binSuffix), ".%s_log.bin", sensor);
+
+    if (SD.exists(csvPath)) {
+        if (importCSV(csvPath, sensor, hasPressure)) {
+            char backupFilename[64];
+            if (logBackupFilename(csvPath, backupFilename, sizeof(backupFilename))) {
+                if (SD.exists(backupFilename)) SD.remove(backupFilename);
+                SD.rename(csvPath, backupFilename);
+                fileCatalogRename(csvPath, backupFilename);
+                Serial.printf("[INFO] Legacy log %s kept as %s\n", csvPath, backupFilename);
+            }
+        } else {
+            Serial.printf("[ERROR] Failed to migrate %s, keeping CSV log\n", csvPath);
+        }
+    }
+
+    // Rotated binary backups first, ordered by their first record, the active log last
+    struct { char path[48]; int32_t firstTs; } sources[16];
+    size_t sourceCount = 0;
+
+    size_t backupCount = fileCatalogList(FILE_KIND_LEGACY_LOG, binSuffix, NULL, 0);
+    FileCatalogEntry *backups = (FileCatalogEntry*)malloc(max(backupCount, (size_t)1) * sizeof(FileCatalogEntry));
+    if (backups) {
+        backupCount = fileCatalogList(FILE_KIND_LEGACY_LOG, binSuffix, backups, backupCount);
+        for (size_t i = 0; i < backupCount && sourceCount < sizeof(sources) / sizeof(sources[0]); i++) {
+            if (strncmp(backups[i].path, "/bac", 4) != 0) continue;
+            strncpy(sources[sourceCount].path, backups[i].path, sizeof(sources[0].path) - 1);
+            sources[sourceCount].path[sizeof(sources[0].path) - 1] = '\0';
+            sources[sourceCount].firstTs = 0;
+            sourceCount++;
+        }
+        free(backups);
+    }
+
+    for (size_t i = 0; i < sourceCount; i++) {
+        LogReader reader;
+        LogRecord rec;
+        if (reader.open(sources[i].path) && reader.next(rec)) sources[i].firstTs = rec.timestamp;
+    }
+    for (size_t i = 1; i < sourceCount; i++) {
+        for (size_t j = i; j > 0 && sources[j - 1].firstTs > sources[j].firstTs; j--) {
+            auto tmp = sources[j];
+            sources[j] = sources[j - 1];
+            sources[j - 1] = tmp;
+        }
+    }
+    if (SD.exists(binPath) && sourceCount < sizeof(sources) / sizeof(sources[0])) {
+        strcpy(sources[sourceCount++].path, binPath);
+    }
+
+    for (size_t i = 0; i < sourceCount; i++) {
+        if (importBinaryLog(sources[i].path, sensor)) {
+            removeWithIndex(sources[i].path);
+        } else {
+            Serial.printf("[ERROR] Failed to migrate %s, keeping it\n", sources[i].path);
+        }
+    }
+}
+
+void logStorageInit() {
+    loadManifest();
+    logRollupInit();
+    migrateLegacyLogs(insideLogName, false);
+    migrateLegacyLogs(outsideLogName, true);
+    logApplyRetention();
+    logCompressClosedSegments();
+}
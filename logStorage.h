@@ -0,0 +1,309 @@
+#ifndef LOGSTORAGE_H
+#define LOGSTORAGE_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Binary sensor log format
+// File layout: one LogFileHeader followed by fixed-size LogRecords, so record n
+// is located at LOG_HEADER_SIZE + n * sizeof(LogRecord) without parsing anything.
+//
+// Active segments are preallocated (LOG_HEADER_PREALLOCATED): the header keeps the record count
+// and readers ignore the zeroed tail behind it.
+//
+// Every sensor logs into time-partitioned segments, one file per calendar month (UTC):
+//   /logs/<sensor>_<YYYYMM>.bin  + .idx sidecar
+// /logs/manifest.csv keeps time span and record count of each segment, so range
+// queries open only the segments overlapping the requested window.
+// Closed months are compressed into <sensor>_<YYYYMM>.arc (logArchive.h), LogReader reads both.
+
+#define LOG_FILE_MAGIC 0x474F4C57   // "WLOG" little endian
+#define LOG_FORMAT_VERSION 2        // 2: records carry a CRC, version 1 files (no CRC) are still read
+
+// Fixed point scaling of the stored values (same precision the CSV lines had)
+#define LOG_TEMP_SCALE 100.0f       // 0.01 °C
+#define LOG_HUMIDITY_SCALE 10.0f    // 0.1 %
+#define LOG_PRESSURE_SCALE 10.0f    // 0.1 hPa
+
+// LogRecord.flags
+#define LOG_FLAG_HAS_PRESSURE 0x01  // Pressure field is valid (outside sensor)
+#define LOG_FLAG_DOWNSAMPLED 0x02   // Mean of a LOG_DOWNSAMPLE_INTERVAL bucket, written by compaction
+
+// LogFileHeader.flags
+#define LOG_HEADER_PREALLOCATED 0x0001  // recordCount is the logical length, the file has a zeroed tail
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t recordSize;
+    uint16_t flags;             // LOG_HEADER_*, 0 in files written before preallocation
+    uint32_t recordCount;       // Records in use with LOG_HEADER_PREALLOCATED, file size counts otherwise
+    uint32_t reserved;
+} LogFileHeader;
+
+typedef struct __attribute__((packed)) {
+    int32_t timestamp;
+    int16_t temperature;    // °C * LOG_TEMP_SCALE
+    int16_t humidity;       // % * LOG_HUMIDITY_SCALE
+    int16_t pressure;       // hPa * LOG_PRESSURE_SCALE, 0 if not available
+    uint8_t batPercentage;
+    uint8_t flags;          // LOG_FLAG_*
+    uint16_t crc;           // CRC-16/CCITT of the fields above, set by logRecordSeal()
+} LogRecord;
+
+#define LOG_HEADER_SIZE sizeof(LogFileHeader)
+#define LOG_RECORD_SIZE sizeof(LogRecord)
+#define LOG_RECORD_SIZE_V1 (LOG_RECORD_SIZE - sizeof(uint16_t))
+
+// Boot recovery checks this many records at the end of each active segment - a torn
+// write only ever damages the last batch, so the rest of the file is not read
+#ifndef LOG_RECOVERY_TAIL_RECORDS
+#define LOG_RECOVERY_TAIL_RECORDS 64
+#endif
+
+// Segments grow in zeroed extents of this many bytes (a multiple of the card's cluster size), so
+// an append rewrites records and the header sector but no FAT chain or directory size
+#ifndef LOG_PREALLOC_BYTES
+#define LOG_PREALLOC_BYTES 32768
+#endif
+
+// Late records - a batch reaching back behind the newest record of its segment is merged into
+// place: the records after the insert point are read back and rewritten in time order, at most
+// this many. Anything older than that is dropped, as are records repeating a logged timestamp.
+#ifndef LOG_MERGE_MAX_RECORDS
+#define LOG_MERGE_MAX_RECORDS 4096
+#endif
+
+// Longest CSV line produced by logFormatCSVLine(), including '\n'
+#define LOG_CSV_LINE_MAX 48
+
+// Sparse index sidecar (<segment>.idx) - one entry for every LOG_INDEX_INTERVAL-th record
+#define LOG_INDEX_INTERVAL 256
+
+typedef struct __attribute__((packed)) {
+    int32_t timestamp;      // Timestamp of the indexed record
+    uint32_t offset;        // Byte offset of the indexed record in the log file
+} LogIndexEntry;
+
+// Segment storage
+#define LOG_DIR "/logs"
+#define LOG_ARCHIVE_DIR "/logs/archive"
+#define LOG_MANIFEST_FILE "/logs/manifest.csv"
+#define LOG_SENSOR_NAME_MAX 12
+
+// Sensors with their own log partition (see sensorRegistry.h) - sizes the per-sensor
+// tables of the write buffer, rollups and hot cache
+#ifndef LOG_MAX_SENSORS
+#define LOG_MAX_SENSORS 16
+#endif
+
+#ifndef LOG_MAX_SEGMENTS
+#define LOG_MAX_SEGMENTS 240        // Manifest capacity, e.g. 2 sensors * 10 years
+#endif
+
+// Retention policy - segments older than LOG_RETENTION_MONTHS full months are expired,
+// 0 keeps everything. Expired segments are moved to LOG_ARCHIVE_DIR (still downloadable)
+// when LOG_ARCHIVE_EXPIRED is set, deleted otherwise.
+#ifndef LOG_RETENTION_MONTHS
+#define LOG_RETENTION_MONTHS 0
+#endif
+#ifndef LOG_ARCHIVE_EXPIRED
+#define LOG_ARCHIVE_EXPIRED 1
+#endif
+
+// Segments this many months before the current one are compressed - the previous month stays
+// plain binary, so late records still have somewhere to go
+#ifndef LOG_COMPRESS_AFTER_MONTHS
+#define LOG_COMPRESS_AFTER_MONTHS 2
+#endif
+
+// Compaction - raw records of segments this many months before the current one are replaced by
+// one mean record per LOG_DOWNSAMPLE_INTERVAL seconds, 0 keeps raw data forever. Min/max of the
+// same buckets stay in the hour rollup tier (logRollup.h), which charts of such ranges read anyway.
+// Runs in a low priority task every LOG_COMPACTION_PERIOD_HOURS, never before compression.
+#ifndef LOG_DOWNSAMPLE_AFTER_MONTHS
+#define LOG_DOWNSAMPLE_AFTER_MONTHS 12
+#endif
+#ifndef LOG_DOWNSAMPLE_INTERVAL
+#define LOG_DOWNSAMPLE_INTERVAL 3600
+#endif
+#ifndef LOG_COMPACTION_PERIOD_HOURS
+#define LOG_COMPACTION_PERIOD_HOURS 24
+#endif
+
+typedef struct {
+    char sensor[LOG_SENSOR_NAME_MAX];
+    uint32_t month;         // YYYYMM
+    int32_t firstTs;
+    int32_t lastTs;
+    uint32_t count;
+    uint8_t compressed;     // Stored as .arc
+    uint8_t downsampled;    // Raw records replaced by LOG_FLAG_DOWNSAMPLED means
+} LogSegmentInfo;
+
+typedef struct {
+    uint32_t merged;        // Late records merged into place
+    uint32_t duplicates;    // Dropped, timestamp already logged for the sensor
+    uint32_t dropped;       // Too late - compressed month or behind LOG_MERGE_MAX_RECORDS
+} LogLateStats;
+
+// Sensor log names - one segment set per sensor
+extern const char* insideLogName;
+extern const char* outsideLogName;
+
+// Record conversion helpers
+LogRecord logMakeRecord(int32_t timestamp, float temperature, float humidity, float pressure,
+                        uint8_t batPercentage, bool hasPressure);
+inline float logRecordTemperature(const LogRecord &rec) { return rec.temperature / LOG_TEMP_SCALE; }
+inline float logRecordHumidity(const LogRecord &rec) { return rec.humidity / LOG_HUMIDITY_SCALE; }
+inline float logRecordPressure(const LogRecord &rec) { return rec.pressure / LOG_PRESSURE_SCALE; }
+size_t logFormatCSVLine(const LogRecord &rec, char *buffer, size_t len);
+
+// Record checksum - persisted records are sealed, recovery drops records that don't verify
+uint16_t logRecordCrc(const LogRecord &rec);
+inline void logRecordSeal(LogRecord &rec) { rec.crc = logRecordCrc(rec); }
+inline bool logRecordValid(const LogRecord &rec) { return rec.crc == logRecordCrc(rec); }
+
+// Startup - manifest load, rollup catch-up, legacy migration, retention; needs a mounted card
+void logStorageInit();
+// Truncates a torn or corrupt tail of a segment, takes in records a torn flush left uncommitted,
+// upgrades version 1 files; false if unusable
+bool logRecoverSegment(const char *path);
+
+// Writing
+bool logAppend(const char *sensor, const LogRecord &rec);
+// Batches may be unsorted and reach back into the log - late records are merged into place
+bool logAppendBatch(const char *sensor, const LogRecord *recs, size_t count);
+uint32_t logRecordCount(File &file);
+LogLateStats logGetLateStats();
+// Bumped whenever records reach the log, with the time of the last change - validators for
+// web responses built from the log
+uint32_t logDataVersion(time_t *changedAt = NULL);
+
+// Segments and manifest
+uint32_t logMonthOf(int32_t timestamp);
+uint32_t logNextMonth(uint32_t month);
+int32_t logMonthStart(uint32_t month);
+bool logSegmentPath(const char *sensor, uint32_t month, char *path, size_t len);
+bool logSegmentFilePath(const LogSegmentInfo &segment, char *path, size_t len);
+size_t logListSegments(const char *sensor, LogSegmentInfo *out, size_t maxCount);
+void logApplyRetention();
+void logCompressClosedSegments();
+void logDownsampleClosedSegments();
+// Starts the background compaction task (logDownsampleClosedSegments() periodically)
+void logCompactionStart();
+
+// In-place rewrites - late records merged into a segment, rollup rows moved up for a late bucket.
+// The writer holds the rewrite lock for the whole rewrite and bumps the generation; readers hold
+// it for each block they read and find their place again when the generation moved on
+void logRewriteLock();
+void logRewriteUnlock();
+// Lock and bump the generation, released with logRewriteUnlock()
+void logRewriteBegin();
+// Read under the lock
+uint32_t logRewriteGeneration();
+
+// Index sidecar
+bool logIndexPath(const char *filename, char *indexPath, size_t len);
+// Entries for records from changedFrom on are rewritten, after a merge rewrote them
+bool logIndexSync(const char *filename, uint32_t changedFrom = UINT32_MAX);
+
+// Reading
+bool logReadLastRecord(const char *sensor, LogRecord &rec);
+// Last n records in time order, fewer if the log is shorter; returns the count
+size_t logReadLastRecords(const char *sensor, LogRecord *out, size_t n);
+bool logBackupFilename(const char *filename, char *backupFilename, size_t len);
+
+class LogArchiveReader;
+
+// Sequential reader of a single log file with a small block buffer, avoids per-record SD calls.
+// Compressed archives are detected by their magic and decoded through LogArchiveReader.
+class LogReader {
+    public:
+        LogReader() : archive(NULL), recSize(LOG_RECORD_SIZE), count(0), nextIndex(0), bufCount(0), bufPos(0),
+                      generation(0), seekTs(INT32_MIN), lastTs(0), hasLast(false), skipping(false) { path[0] = '\0'; }
+        ~LogReader() { close(); }
+
+        bool open(const char *filename);
+        void close();
+        bool isOpen() { return file || archive; }
+
+        uint32_t recordCount() const { return count; }
+        uint8_t recordSize() const { return recSize; }
+        bool seekRecord(uint32_t index);
+        bool seekTime(int32_t startTime);
+        bool next(LogRecord &rec);
+
+    private:
+        static const size_t BUFFER_RECORDS = 32;
+
+        bool openLocked(const char *filename);
+        bool reload();
+        bool resync();
+        bool position(uint32_t index);
+        bool seekTimeLocked(int32_t startTime);
+        bool fill();
+
+        File file;
+        LogArchiveReader *archive;
+        char path[48];
+        uint8_t recSize;            // On-disk record size, LOG_RECORD_SIZE_V1 for version 1 files
+        uint32_t count;
+        uint32_t nextIndex;
+        LogRecord buffer[BUFFER_RECORDS];
+        size_t bufCount;
+        size_t bufPos;
+        uint32_t generation;        // logRewriteGeneration() the open file matches
+        int32_t seekTs;             // Last seekTime(), INT32_MIN after seekRecord()
+        int32_t lastTs;             // Last record returned since the last seek
+        bool hasLast;
+        bool skipping;              // Passing records already returned before a rewrite
+};
+
+// Time range query over all segments of one sensor. Only segments overlapping
+// [startTime, endTime] are opened, next() returns in-range records only.
+class LogQuery {
+    public:
+        LogQuery() : startTime(0), endTime(0), month(0), singleFile(false), done(true) { sensor[0] = '\0'; }
+
+        bool open(const char *sensorName, int32_t start, int32_t end);
+        bool openFile(const char *filename);
+        void close();
+        bool next(LogRecord &rec);
+
+    private:
+        bool openNextSegment();
+
+        LogReader reader;
+        char sensor[LOG_SENSOR_NAME_MAX];
+        int32_t startTime;
+        int32_t endTime;
+        uint32_t month;         // Month of the currently open segment
+        bool singleFile;
+        bool done;
+};
+
+// Converts binary logs to CSV text on the fly, for /download and ZIP archives.
+// A line that doesn't fit into dest is kept and continued on the next read() call.
+class LogCSVStream {
+    public:
+        LogCSVStream() : pendingLen(0), pendingPos(0), opened(false) {}
+
+        bool openName(const char *csvName);
+        bool open(const char *sensor, int32_t start, int32_t end);
+        bool openFile(const char *filename);
+        bool isOpen() { return opened; }
+        size_t read(uint8_t *dest, size_t maxLen);
+
+    private:
+        LogQuery query;
+        char pending[LOG_CSV_LINE_MAX];
+        size_t pendingLen;
+        size_t pendingPos;
+        bool opened;
+};
+
+#endif /* LOGSTORAGE_H */
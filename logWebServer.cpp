@@ -1,4 +1,14 @@
 #include "logWebServer.h"
+#include "logStorage.h"
+#include "chartCache.h"
+#include "chartBinary.h"
+#include "logHotCache.h"
+#include "logWriteBuffer.h"
+#include "sdStats.h"
+#include "sensorRegistry.h"
+#include "fileCatalog.h"
+#include "logPipeline.h"
+#include "staticAssets.h"
 #include <FS.h>
 #include <time.h>
 
@@ -8,72 +18,264 @@ extern int sht4xRetryCount;
 extern const int MAX_SHT4X_RETRIES;
 extern unsigned long sht4xLastRetryTime;
 
-const char* insideLogFile = "/inside_log.csv";
-const char* outsideLogFile = "/outside_log.csv";
-
 AsyncWebServer logServer(80);
 
 // Cache file validity time 15 minutes (in seconds)
 const int JSON_CACHE_VALIDITY = 900;
 
-// Track JSON generation status to prevent concurrent operations
-volatile bool jsonGenerationInProgress = false;
+// Most records /recent returns - 3 days at 15 min interval
+const int RECENT_MAX_RECORDS = 288;
 
-// Queue for latest sensor readings
-typedef struct {
-    int32_t timestamp;
-    float temperature;
-    float humidity;
-    float pressure;
-    const char *filename;  // Name of the file to store data - "/outside_log.csv" or "/inside_log.csv"
-    uint8_t batPercentage;
-} SensorData;
+// Most rollup rows /minmax reads for a range - logRangeStats() picks the finest tier within it
+const uint32_t MINMAX_MAX_ROLLUP_ROWS = 400;
 
-SensorData latestOutside, latestInside;
+// Track JSON generation status to prevent concurrent operations
+volatile bool jsonGenerationInProgress = false;
 
 // Handles
 TaskHandle_t maintenanceTaskHandle = NULL;
-QueueHandle_t serverLatestQueue;
 
 
 void maintenanceTask(void *parameter) {
-    SensorData tempData;
-    uint8_t cleanCounter = 0;
     while(1) {
-        // Queue for receiving data for /latest display - to avoid SD wear - requires both sensors to be successfully received
-        for (int i = 0; i < 2; i++) {
-            if (xQueueReceive(serverLatestQueue, &tempData, portMAX_DELAY) == pdTRUE){
-                if (strcmp(tempData.filename, "/outside_log.csv") == 0) {
-                    latestOutside = tempData;
-                } else if (strcmp(tempData.filename, "/inside_log.csv") == 0) {
-                    latestInside = tempData;
-                }
-            }
-        }
-        cleanCounter++;
-        // After receiving 12 data sets (every 15 min) - roughly 3 hours, run cleanup for custom json's
-        if(cleanCounter > 12){
-            cleanupOldCustomJSONs();
-            cleanCounter = 0;
-        }
+        // Latest readings for /latest are kept in the sensor registry by dataDistributorTask
+        // Roughly every 3 hours run cleanup for custom json's
+        vTaskDelay((TickType_t)3 * 3600 * configTICK_RATE_HZ);
+        cleanupOldCustomJSONs();
+    }
+}
+
+// ?sensors=inside,node-a1b2c3 - registry names, the dashboard's inside and outside when absent;
+// 0 if a name is unknown or there are more than CHART_MAX_SENSORS
+static size_t requestSensors(AsyncWebServerRequest *request, SensorId *ids) {
+    if (!request->hasParam("sensors")) {
+        ids[0] = SENSOR_ID_INSIDE;
+        ids[1] = SENSOR_ID_OUTSIDE;
+        return 2;
+    }
+    String list = request->getParam("sensors")->value();
+    size_t count = 0;
+    int start = 0;
+    while (start <= (int)list.length()) {
+        int comma = list.indexOf(',', start);
+        if (comma < 0) comma = list.length();
+        SensorId id = sensorRegistryFind(list.substring(start, comma).c_str());
+        if (id == SENSOR_ID_NONE || count >= CHART_MAX_SENSORS) return 0;
+        ids[count++] = id;
+        start = comma + 1;
     }
+    return count;
+}
+
+// Validators of /chart-data and /minmax - derived from RAM state only, so a client polling an
+// unchanged range is answered with 304 before anything is read from the card
+typedef struct {
+    char etag[16];
+    char lastModified[32];
+    time_t changedAt;
+} DataValidator;
+
+static void formatHttpDate(time_t t, char *buffer, size_t len) {
+    struct tm timeinfo;
+    gmtime_r(&t, &timeinfo);
+    strftime(buffer, len, "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
+}
+
+// IMF-fixdate as sent back by browsers, 0 if it can't be parsed
+static time_t parseHttpDate(const char *text) {
+    static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4];
+    int day, year, hour, minute, second;
+    if (sscanf(text, "%*3s, %d %3s %d %d:%d:%d", &day, month, &year, &hour, &minute, &second) != 6) return 0;
+    const char *found = strstr(months, month);
+    if (found == NULL || (found - months) % 3 != 0) return 0;
+    int mon = (found - months) / 3 + 1;
+
+    // Days since 1970-01-01 of a proleptic Gregorian date
+    int y = year - (mon <= 2);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long days = (long)era * 146097 + doe - 719468;
+    return (time_t)days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// FNV-1a
+static uint32_t hashBytes(uint32_t hash, const void *data, size_t len) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Changes with every ingested reading (hot cache) and every record written to the log (rollups,
+// chart caches); fixed ranges also every JSON_CACHE_VALIDITY as their window slides on
+static void makeDataValidator(const char *endpoint, const char *range, const SensorId *ids, size_t count,
+                              DataValidator &validator) {
+    time_t changedAt;
+    uint32_t version = logDataVersion(&changedAt);
+    uint32_t hash = hashBytes(2166136261u, endpoint, strlen(endpoint));
+    hash = hashBytes(hash, range, strlen(range));
+    hash = hashBytes(hash, &version, sizeof(version));
+    hash = hashBytes(hash, ids, count * sizeof(SensorId));
+
+    for (size_t i = 0; i < count; i++) {
+        SensorId id = ids[i];
+        SensorData latest;
+        int32_t newest = sensorRegistryGetLatest(id, latest) ? latest.timestamp : 0;
+        hash = hashBytes(hash, &newest, sizeof(newest));
+        changedAt = max(changedAt, (time_t)newest);
+    }
+    if (strncmp(range, "custom_", 7) != 0) {
+        int32_t window = time(nullptr) / JSON_CACHE_VALIDITY;
+        hash = hashBytes(hash, &window, sizeof(window));
+        // Last-Modified moves with the window too, or If-Modified-Since keeps a stale window current
+        changedAt = max(changedAt, (time_t)window * JSON_CACHE_VALIDITY);
+    }
+
+    snprintf(validator.etag, sizeof(validator.etag), "\"%08x\"", (unsigned)hash);
+    validator.changedAt = changedAt;
+    formatHttpDate(changedAt, validator.lastModified, sizeof(validator.lastModified));
+}
+
+// If-None-Match wins over If-Modified-Since, as in RFC 9110
+static bool clientHasCurrent(AsyncWebServerRequest *request, const DataValidator &validator) {
+    if (request->hasHeader("If-None-Match")) {
+        String tags = request->header("If-None-Match");
+        return tags.indexOf(validator.etag) >= 0 || tags == "*";
+    }
+    if (request->hasHeader("If-Modified-Since") && validator.changedAt > 0) {
+        time_t since = parseHttpDate(request->header("If-Modified-Since").c_str());
+        return since > 0 && validator.changedAt <= since;
+    }
+    return false;
+}
+
+static void addValidatorHeaders(AsyncWebServerResponse *response, const DataValidator &validator) {
+    response->addHeader("ETag", validator.etag);
+    if (validator.changedAt > 0) response->addHeader("Last-Modified", validator.lastModified);
+    // Browsers revalidate on every poll instead of guessing a freshness lifetime
+    response->addHeader("Cache-Control", "no-cache");
+}
+
+// 304 with the validators if the client's copy is current
+static bool sendNotModified(AsyncWebServerRequest *request, const DataValidator &validator) {
+    if (!clientHasCurrent(request, validator)) return false;
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    addValidatorHeaders(response, validator);
+    request->send(response);
+    return true;
+}
+
+// Chunked /chart-data response, the stream lives until the last chunk is sent
+static void sendChartStream(AsyncWebServerRequest *request, std::shared_ptr<ChartJSONStream> stream,
+                            const DataValidator &validator, const char *source) {
+    Serial.printf("[DEBUG] Response: %u bytes known ahead - %s\n", (unsigned)stream->length(), source);
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return stream->read(buffer, maxLen);
+        });
+    addValidatorHeaders(response, validator);
+    request->send(response);
+}
+
+// /chart-data?fmt=bin - the requested series in the columnar layout of chartBinary.h, built in memory;
+// points=N min/max decimates them to at most N points (about twice the chart width in pixels)
+static void sendChartBinary(AsyncWebServerRequest *request, const char *range, const SensorId *ids, size_t count,
+                            uint32_t targetPoints, const DataValidator &validator) {
+    int rangeHours = getTimeLimitHours(range);
+    int32_t end = time(nullptr);
+    int32_t start = end - rangeHours * 3600;
+    if (strncmp(range, "custom_", 7) == 0 && sscanf(range, "custom_%d_%d", &start, &end) != 2) {
+        request->send(400, "text/plain", "Invalid custom range");
+        return;
+    }
+    LogRollupTier tier = logRollupTierForStep(getAggregationStep(rangeHours));
+
+    const char* sensors[CHART_MAX_SENSORS];
+    for (size_t i = 0; i < count; i++) {
+        sensors[i] = sensorName(ids[i]);
+    }
+    std::shared_ptr<ChartBinary> payload(new ChartBinary, [](ChartBinary *binary) {
+        chartBinaryFree(*binary);
+        delete binary;
+    });
+    SDOpTimer timer(SD_OP_JSON);
+    bool built = chartBinaryBuild(sensors, count, start, end, tier, targetPoints, *payload);
+    timer.done(built, built ? payload->size : 0);
+    if (!built) {
+        request->send(500, "text/plain", "Failed to generate data");
+        return;
+    }
+
+    if (targetPoints > 0) {
+        Serial.printf("[DEBUG] Response: %u bytes - binary, decimated to %u points\n", (unsigned)payload->size, targetPoints);
+    } else {
+        Serial.printf("[DEBUG] Response: %u bytes - binary, tier %ds\n", (unsigned)payload->size, logRollupTierSeconds[tier]);
+    }
+    AsyncWebServerResponse *response = request->beginResponse("application/octet-stream", payload->size,
+        [payload](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            size_t chunk = min(maxLen, payload->size - index);
+            memcpy(buffer, payload->data + index, chunk);
+            return chunk;
+        });
+    addValidatorHeaders(response, validator);
+    request->send(response);
 }
 
 void setupLogWebServer() {
     // Create maintenance task
     xTaskCreate(maintenanceTask, "maintenanceTask", 4096, NULL, 1, &maintenanceTaskHandle);
 
+    // Dashboard from PSRAM (gzipped index.html.gz), straight from the card only as a fallback
+    staticAssetLoad(SD, "/index.html", "text/html");
     logServer.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SD, "/index.html", "text/html");
+        if (!staticAssetSend(request, SD, "/index.html", "text/html")) {
+            request->send(SD, "/index.html", "text/html");
+        }
     });
 
     //Fetching latest
     logServer.on("/latest", HTTP_GET, [](AsyncWebServerRequest *request) {
+        // One sensor by registry name - {"T","H","P","tS","bat"}, the dashboard pair otherwise
+        if (request->hasParam("sensor")) {
+            SensorId id = sensorRegistryFind(request->getParam("sensor")->value().c_str());
+            if (id == SENSOR_ID_NONE) {
+                request->send(404, "text/plain", "Unknown sensor");
+                return;
+            }
+            StaticJsonDocument<256> sensorDoc;
+            SensorData latest;
+            LogRecord rec;
+            if (sensorRegistryGetLatest(id, latest)) {
+                sensorDoc["T"] = roundToOneDecimal(latest.temperature);
+                sensorDoc["H"] = roundToOneDecimal(latest.humidity);
+                if (sensorHasPressure(id)) sensorDoc["P"] = roundToOneDecimal(latest.pressure);
+                sensorDoc["tS"] = latest.timestamp;
+                sensorDoc["bat"] = latest.batPercentage;
+            } else if (logHotCacheLast(sensorName(id), rec) || logReadLastRecord(sensorName(id), rec)) {
+                sensorDoc["T"] = roundToOneDecimal(logRecordTemperature(rec));
+                sensorDoc["H"] = roundToOneDecimal(logRecordHumidity(rec));
+                if (rec.flags & LOG_FLAG_HAS_PRESSURE) sensorDoc["P"] = roundToOneDecimal(logRecordPressure(rec));
+                sensorDoc["tS"] = rec.timestamp;
+                sensorDoc["bat"] = rec.batPercentage;
+            }
+            char sensorResponse[128];
+            serializeJson(sensorDoc, sensorResponse, sizeof(sensorResponse));
+            request->send(200, "application/json", sensorResponse);
+            return;
+        }
+
         StaticJsonDocument<512> jsonDoc;
+        SensorData latestInside = {}, latestOutside = {};
+        sensorRegistryGetLatest(SENSOR_ID_INSIDE, latestInside);
+        sensorRegistryGetLatest(SENSOR_ID_OUTSIDE, latestOutside);
         
-        // Check if queue has fresh data
+        // Check if the registry has fresh data
         if (time(NULL) - ((latestOutside.timestamp + latestInside.timestamp)/2) <= 900) {
-            Serial.println("[DEBUG] Using queue data for /latest.");
+            Serial.println("[DEBUG] Using registry data for /latest.");
             jsonDoc["iT"] = roundToOneDecimal(latestInside.temperature);
             jsonDoc["iH"] = roundToOneDecimal(latestInside.humidity);
             jsonDoc["itS"] = latestInside.timestamp;
@@ -90,58 +292,24 @@ void setupLogWebServer() {
                 
         } else {
             // Fallback to file reading if queue data isn't available
-            Serial.println("[ERROR] /latest queue data outdated or invalid, falling back to file reading");
-            char buffer[64];
-
-            // Process inside data
-            File file = SD.open(insideLogFile, FILE_READ);
-            if (file) {
-                char lastLine[64] = {0};
-                while (file.available()) {
-                    memset(buffer, 0, sizeof(buffer));
-                    size_t bytesRead = file.readBytesUntil('\n', buffer, sizeof(buffer)-1);
-                    if (bytesRead > 0) {
-                        memcpy(lastLine, buffer, min(bytesRead, sizeof(lastLine)-1));
-                        lastLine[min(bytesRead, sizeof(lastLine)-1)] = '\0';
-                    }
-                }
-                file.close();
-                
-                if (strlen(lastLine) > 0) {
-                    int timestamp;
-                    float temperature, humidity;
-                    sscanf(lastLine, "%d,%f,%f", &timestamp, &temperature, &humidity);
-                    jsonDoc["iT"] = roundToOneDecimal(temperature);
-                    jsonDoc["iH"] = roundToOneDecimal(humidity);
-                    jsonDoc["itS"] = timestamp;
-                    jsonDoc["iBat"] = latestInside.batPercentage;
-                }
+            Serial.println("[ERROR] /latest registry data outdated or invalid, falling back to file reading");
+            LogRecord rec;
+
+            // Process inside data - hot cache first, else last record located by offset, no scanning
+            if (logHotCacheLast(insideLogName, rec) || logReadLastRecord(insideLogName, rec)) {
+                jsonDoc["iT"] = roundToOneDecimal(logRecordTemperature(rec));
+                jsonDoc["iH"] = roundToOneDecimal(logRecordHumidity(rec));
+                jsonDoc["itS"] = rec.timestamp;
+                jsonDoc["iBat"] = rec.batPercentage;
             }
 
             // Process outside data
-            file = SD.open(outsideLogFile, FILE_READ);
-            if (file) {
-                char lastLine[64] = {0};
-                while (file.available()) {
-                    memset(buffer, 0, sizeof(buffer));
-                    size_t bytesRead = file.readBytesUntil('\n', buffer, sizeof(buffer)-1);
-                    if (bytesRead > 0) {
-                        memcpy(lastLine, buffer, min(bytesRead, sizeof(lastLine)-1));
-                        lastLine[min(bytesRead, sizeof(lastLine)-1)] = '\0';
-                    }
-                }
-                file.close();
-                
-                if (strlen(lastLine) > 0) {
-                    int timestamp;
-                    float temperature, humidity, pressure;
-                    sscanf(lastLine, "%d,%f,%f,%f", &timestamp, &temperature, &humidity, &pressure);
-                    jsonDoc["oT"] = roundToOneDecimal(temperature);
-                    jsonDoc["oH"] = roundToOneDecimal(humidity);
-                    jsonDoc["oP"] = roundToOneDecimal(pressure);
-                    jsonDoc["otS"] = timestamp;
-                    jsonDoc["oBat"] = latestOutside.batPercentage;
-                }
+            if (logHotCacheLast(outsideLogName, rec) || logReadLastRecord(outsideLogName, rec)) {
+                jsonDoc["oT"] = roundToOneDecimal(logRecordTemperature(rec));
+                jsonDoc["oH"] = roundToOneDecimal(logRecordHumidity(rec));
+                jsonDoc["oP"] = roundToOneDecimal(logRecordPressure(rec));
+                jsonDoc["otS"] = rec.timestamp;
+                jsonDoc["oBat"] = rec.batPercentage;
             }
             
             // Add sensor status information (same for both branches)
@@ -155,6 +323,68 @@ void setupLogWebServer() {
         request->send(200, "application/json", response);
     });
 
+    // Last n raw records of one sensor - hot cache, else tail of the newest log segments
+    logServer.on("/recent", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!request->hasParam("sensor")) {
+            request->send(400, "text/plain", "Missing sensor parameter");
+            return;
+        }
+        SensorId id = sensorRegistryFind(request->getParam("sensor")->value().c_str());
+        if (id == SENSOR_ID_NONE) {
+            request->send(404, "text/plain", "Unknown sensor");
+            return;
+        }
+        const char* sensor = sensorName(id);
+        int n = request->hasParam("n") ? request->getParam("n")->value().toInt() : 12;
+        n = constrain(n, 1, RECENT_MAX_RECORDS);
+
+        LogRecord *recs = (LogRecord*)ps_malloc(2 * n * sizeof(LogRecord));
+        if (!recs) recs = (LogRecord*)malloc(2 * n * sizeof(LogRecord));
+        if (!recs) {
+            request->send(500, "text/plain", "Out of memory");
+            return;
+        }
+
+        size_t count = logHotCacheTail(sensor, recs, n);
+        if (count < (size_t)n) {
+            // Card history, then the hot cache records it doesn't have yet (still in the write buffer)
+            LogRecord *hot = recs + n;
+            size_t hotCount = count;
+            memcpy(hot, recs, hotCount * sizeof(LogRecord));
+            count = logReadLastRecords(sensor, recs, n);
+            int32_t lastStored = count > 0 ? recs[count - 1].timestamp : INT32_MIN;
+            for (size_t i = 0; i < hotCount; i++) {
+                if (hot[i].timestamp <= lastStored) continue;
+                if (count == (size_t)n) {
+                    memmove(recs, recs + 1, (n - 1) * sizeof(LogRecord));
+                    count--;
+                }
+                recs[count++] = hot[i];
+            }
+        }
+
+        String json = "[";
+        json.reserve(count * 56 + 2);
+        char point[80];
+        for (size_t i = 0; i < count; i++) {
+            const LogRecord &rec = recs[i];
+            if (rec.flags & LOG_FLAG_HAS_PRESSURE) {
+                snprintf(point, sizeof(point), "%s{\"tS\":%d,\"T\":%.2f,\"H\":%.1f,\"P\":%.1f,\"bat\":%d}",
+                         i ? "," : "", (int)rec.timestamp, logRecordTemperature(rec), logRecordHumidity(rec),
+                         logRecordPressure(rec), rec.batPercentage);
+            } else {
+                snprintf(point, sizeof(point), "%s{\"tS\":%d,\"T\":%.2f,\"H\":%.1f,\"bat\":%d}",
+                         i ? "," : "", (int)rec.timestamp, logRecordTemperature(rec), logRecordHumidity(rec),
+                         rec.batPercentage);
+            }
+            json += point;
+        }
+        json += "]";
+        free(recs);
+
+        request->send(200, "application/json", json);
+    });
+
     // Min/Max/Avg Data
     logServer.on("/minmax", HTTP_GET, [](AsyncWebServerRequest *request) {
         if (!request->hasParam("range")) {
@@ -164,15 +394,31 @@ void setupLogWebServer() {
 
         const char* range = request->getParam("range")->value().c_str();
         int range_hours = getTimeLimitHours(range);
+        SensorId ids[CHART_MAX_SENSORS];
+        size_t sensorCount = requestSensors(request, ids);
+        if (sensorCount == 0) {
+            request->send(400, "text/plain", "Unknown sensor or too many sensors");
+            return;
+        }
+
+        DataValidator validator;
+        makeDataValidator("/minmax", range, ids, sensorCount, validator);
+        if (sendNotModified(request, validator)) {
+            return;
+        }
         
         Serial.printf("[DEBUG] /minmax endpoint called with range='%s' (%d hours)\\n", range, range_hours);
-        StaticJsonDocument<1024> jsonDoc;
-        calculateMinMaxAvg(insideLogFile, range_hours, jsonDoc, "inside");
-        calculateMinMaxAvg(outsideLogFile, range_hours, jsonDoc, "outside");
+        // Fields are prefixed with the sensor name - inside_temp_min, outside_pressure_avg...
+        DynamicJsonDocument jsonDoc(512 * sensorCount);
+        for (size_t i = 0; i < sensorCount; i++) {
+            calculateMinMaxAvg(sensorName(ids[i]), range_hours, jsonDoc, sensorName(ids[i]));
+        }
 
-        char response[1024];
-        serializeJson(jsonDoc, response, sizeof(response));
-        request->send(200, "application/json", response);
+        String json;
+        serializeJson(jsonDoc, json);
+        AsyncWebServerResponse *response = request->beginResponse(200, "application/json", json);
+        addValidatorHeaders(response, validator);
+        request->send(response);
     });
 
     // JSON data for charts with streaming
@@ -184,111 +430,337 @@ void setupLogWebServer() {
         }
     
         const char* range = request->getParam("range")->value().c_str();
-        Serial.printf("[DEBUG] Received /chart-data request for range: %s\n", range);
-    
-        char insideFile[32], outsideFile[32];
-        snprintf(insideFile, sizeof(insideFile), "/inside_%s.json", range);
-        snprintf(outsideFile, sizeof(outsideFile), "/outside_%s.json", range);
-    
-        Serial.printf("[DEBUG] Expected file names: %s | %s\n", insideFile, outsideFile);
+        SensorId ids[CHART_MAX_SENSORS];
+        size_t sensorCount = requestSensors(request, ids);
+        if (sensorCount == 0) {
+            request->send(400, "text/plain", "Unknown sensor or too many sensors");
+            return;
+        }
+
+        bool binary = request->hasParam("fmt") && request->getParam("fmt")->value() == "bin";
+        // Target point count - binary payload only, the JSON files are cached per fixed bucket size
+        uint32_t targetPoints = 0;
+        if (binary && request->hasParam("points")) {
+            targetPoints = constrain(request->getParam("points")->value().toInt(), 0, CHART_BINARY_MAX_POINTS);
+        }
+
+        // Nothing new since the client's copy - answered without touching the card
+        char endpoint[48];
+        snprintf(endpoint, sizeof(endpoint), binary ? "/chart-data?fmt=bin&points=%u" : "/chart-data",
+                 (unsigned)targetPoints);
+        DataValidator validator;
+        makeDataValidator(endpoint, range, ids, sensorCount, validator);
+        if (sendNotModified(request, validator)) {
+            Serial.printf("[DEBUG] /chart-data %s not modified\n", range);
+            return;
+        }
+        Serial.printf("[DEBUG] Received /chart-data request for range: %s%s\n", range, binary ? " (binary)" : "");
+
+        if (binary) {
+            sendChartBinary(request, range, ids, sensorCount, targetPoints, validator);
+            return;
+        }
     
-        // Check if files exist and are up-to-date (15 min)
-        bool needsGeneration = true;
-        
-        if (SD.exists(insideFile) && SD.exists(outsideFile)) {
-            File file = SD.open(insideFile, FILE_READ);
-            if (file) {
-                time_t fileTime = file.getLastWrite();
-                time_t currentTime = time(nullptr);
-                file.close();
-                
-                if (currentTime - fileTime < JSON_CACHE_VALIDITY) {
-                    needsGeneration = false;
-                    Serial.printf("[INFO] Using cached JSON files for displaying chart data (age: %ld seconds)\n", 
-                                  currentTime - fileTime);
+        // One JSON object, a key per sensor name: {"inside":[...],"outside":[...]}
+        char key[LOG_SENSOR_NAME_MAX + 8];
+        auto addKey = [&](std::shared_ptr<ChartJSONStream> &stream, size_t i, const char *open) {
+            snprintf(key, sizeof(key), "%s\"%s\":%s", i == 0 ? "{" : ",", sensorName(ids[i]), open);
+            stream->addText(key);
+        };
+
+        // Fixed ranges - hot cache in PSRAM, else sliding window cache on SD that appends only newly completed buckets
+        std::shared_ptr<ChartJSONStream> stream = std::make_shared<ChartJSONStream>();
+        if (strncmp(range, "custom_", 7) != 0) {
+            int rangeHours = getTimeLimitHours(range);
+            LogRollupTier tier = logRollupTierForStep(getAggregationStep(rangeHours));
+            int currentTime = time(nullptr);
+            int startTime = currentTime - rangeHours * 3600;
+
+            // Buckets are aggregated from PSRAM while the response is sent
+            bool hot = true;
+            for (size_t i = 0; i < sensorCount && hot; i++) {
+                hot = logHotCacheCovers(sensorName(ids[i]), startTime);
+            }
+            if (hot) {
+                for (size_t i = 0; i < sensorCount; i++) {
+                    addKey(stream, i, "");
+                    stream->addHotCache(sensorName(ids[i]), startTime, currentTime, tier, sensorHasPressure(ids[i]));
                 }
+                stream->addText("}");
+                sendChartStream(request, stream, validator, "hot cache");
+                return;
             }
+
+            ChartCacheWindow windows[CHART_MAX_SENSORS];
+            SDOpTimer cacheTimer(SD_OP_CHART_CACHE);
+            bool cached = true;
+            for (size_t i = 0; i < sensorCount && cached; i++) {
+                cached = chartCacheRefresh(sensorName(ids[i]), range, rangeHours * 3600, tier,
+                                           sensorHasPressure(ids[i]), windows[i]);
+            }
+            cacheTimer.done(cached);
+            if (cached) {
+                // Cache files are copied from the card while the response is sent
+                for (size_t i = 0; i < sensorCount; i++) {
+                    addKey(stream, i, "[");
+                    stream->addFileRange(windows[i].path, windows[i].offset, windows[i].length);
+                    stream->addText(windows[i].tail + "]");
+                }
+                stream->addText("}");
+                sendChartStream(request, stream, validator, "incremental cache");
+                return;
+            }
+            Serial.println("[WARNING] Incremental chart cache unavailable, regenerating from log");
         }
-    
-        // Check if files exist before generation
-        if (needsGeneration) {
-            if (!generateStreamingJSONData(range)) {
-                request->send(500, "text/plain", "Failed to generate data");
+
+        // Per sensor file /<sensor>_<range>.json, regenerated when missing or older than JSON_CACHE_VALIDITY
+        bool generatedAny = false;
+        for (size_t i = 0; i < sensorCount; i++) {
+            char file[48];
+            snprintf(file, sizeof(file), "/%s_%s.json", sensorName(ids[i]), range);
+
+            SDOpTimer existsTimer(SD_OP_EXISTS);
+            bool fileExists = SD.exists(file);
+            existsTimer.done(true);
+            bool needsGeneration = true;
+            if (fileExists) {
+                File cached = SD.open(file, FILE_READ);
+                if (cached) {
+                    time_t fileTime = cached.getLastWrite();
+                    time_t currentTime = time(nullptr);
+                    cached.close();
+
+                    if (currentTime - fileTime < JSON_CACHE_VALIDITY) {
+                        needsGeneration = false;
+                        Serial.printf("[INFO] Using cached JSON file %s (age: %ld seconds)\n", file, currentTime - fileTime);
+                    }
+                }
+            }
+
+            // Files still copied into an earlier response are served as they are, regenerated next time
+            if (needsGeneration && fileExists && chartCachePinned(file)) {
+                Serial.printf("[INFO] %s still being sent, not regenerated\n", file);
+                needsGeneration = false;
+            }
+
+            if (needsGeneration) {
+                SDOpTimer jsonTimer(SD_OP_JSON);
+                bool generated = generateStreamingJSONData(sensorName(ids[i]), range, sensorHasPressure(ids[i]));
+                jsonTimer.done(generated);
+                if (!generated) {
+                    request->send(500, "text/plain", "Failed to generate data");
+                    return;
+                }
+                generatedAny = true;
+            }
+
+            // Verify the file exists after potential generation
+            if (!SD.exists(file)) {
+                Serial.printf("[ERROR] Missing JSON file %s after generation\n", file);
+                request->send(500, "text/plain", "Missing data files");
                 return;
             }
+
+            // Files are copied from the card in response-sized chunks instead of read into Strings
+            addKey(stream, i, "");
+            stream->addFile(file, "[]");
         }
+        stream->addText("}");
+        sendChartStream(request, stream, validator, generatedAny ? "generated" : "cached");
+    });
+
+    // New endpoint to list available files for download
+    logServer.on("/list-files", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument jsonDoc(8192);
+        JsonArray filesArray = jsonDoc.createNestedArray("files");
         
-        // Verify files exist after potential generation
-        if (!SD.exists(insideFile) || !SD.exists(outsideFile)) {
-            Serial.println("[ERROR] Missing JSON files after generation");
-            request->send(500, "text/plain", "Missing data files");
-            return;
+        // Log segments of every registered sensor are offered as CSV, /download converts them on the fly
+        const char* sensors[SENSOR_REGISTRY_MAX];
+        size_t sensorCount = 0;
+        for (SensorId id = 0; id < SENSOR_REGISTRY_MAX; id++) {
+            if (sensorName(id) != NULL) sensors[sensorCount++] = sensorName(id);
         }
-    
-        // Read Inside JSON with optimized memory allocation
-        String insideData = "[]";
-        File file = SD.open(insideFile, FILE_READ);
-        if (file) {
-            size_t size = file.size();
-            if (size > 0) {
-                insideData.reserve(size);
-                insideData = file.readString();
-            }
-            file.close();
-        } else {
-            Serial.printf("[ERROR] Missing file: %s\n", insideFile);
+        for (size_t s = 0; s < sensorCount; s++) {
+            const char* sensor = sensors[s];
+            size_t segmentCount = logListSegments(sensor, NULL, 0);
+            if (segmentCount == 0) continue;
+
+            LogSegmentInfo *segments = (LogSegmentInfo*)malloc(segmentCount * sizeof(LogSegmentInfo));
+            if (!segments) continue;
+            segmentCount = logListSegments(sensor, segments, segmentCount);
+
+            // Whole history ("<sensor>_log.csv") is a static option of the page
+            char csvName[32];
+            for (size_t i = 0; i < segmentCount; i++) {
+                snprintf(csvName, sizeof(csvName), "%s_%06u.csv", sensor, (unsigned)segments[i].month);
+                filesArray.add(csvName);
+            }
+            free(segments);
         }
-    
-        // Read Outside JSON with optimized memory allocation
-        String outsideData = "[]";
-        file = SD.open(outsideFile, FILE_READ);
-        if (file) {
-            size_t size = file.size();
-            if (size > 0) {
-                outsideData.reserve(size);
-                outsideData = file.readString();
-            }
-            file.close();
-        } else {
-            Serial.printf("[ERROR] Missing file: %s\n", outsideFile);
+
+        // Segments expired by the retention policy, CSV backups of older firmware
+        for (size_t s = 0; s < sensorCount; s++) {
+            const char* sensor = sensors[s];
+            char prefix[LOG_SENSOR_NAME_MAX + 1];
+            snprintf(prefix, sizeof(prefix), "%s_", sensor);
+            size_t fileCount = fileCatalogList(FILE_KIND_ARCHIVED | FILE_KIND_CSV_BACKUP, prefix, NULL, 0);
+            if (fileCount == 0) continue;
+
+            FileCatalogEntry *files = (FileCatalogEntry*)malloc(fileCount * sizeof(FileCatalogEntry));
+            if (!files) continue;
+            fileCount = fileCatalogList(FILE_KIND_ARCHIVED | FILE_KIND_CSV_BACKUP, prefix, files, fileCount);
+
+            char csvName[FILE_CATALOG_PATH_MAX];
+            for (size_t i = 0; i < fileCount; i++) {
+                const char *name = strrchr(files[i].path, '/') + 1;
+                if (files[i].kind == FILE_KIND_ARCHIVED) {
+                    // .bin / .arc -> .csv
+                    snprintf(csvName, sizeof(csvName), "%.*s.csv", (int)strlen(name) - 4, name);
+                    filesArray.add(csvName);
+                } else {
+                    filesArray.add(name);
+                }
+            }
+            free(files);
         }
-    
-        // Build response with pre-allocated memory to prevent fragmentation
-        String response;
-        response.reserve(insideData.length() + outsideData.length() + 30);
-        response = "{\"inside\":" + insideData + ",\"outside\":" + outsideData + "}";
-        
-        // Single debug line with comprehensive info
-        Serial.printf("[DEBUG] Response: %d bytes (I:%d O:%d) - %s\n", 
-                     response.length(), insideData.length(), outsideData.length(),
-                     needsGeneration ? "generated" : "cached");
         
+        String response;
+        serializeJson(jsonDoc, response);
         request->send(200, "application/json", response);
     });
 
-    // New endpoint to list available files for download
-    logServer.on("/list-files", HTTP_GET, [](AsyncWebServerRequest *request) {
-        File root = SD.open("/");
-        if (!root) {
-            request->send(500, "text/plain", "Failed to open root directory");
+    // SD card I/O instrumentation - latency histograms, errors, reinits and write buffer state
+    logServer.on("/sd-stats", HTTP_GET, [](AsyncWebServerRequest *request) {
+        SDOpStats ops[SD_OP_COUNT];
+        SDCardStats card;
+        sdStatsGet(ops, card);
+        LogBufferStats buffer = logBufferGetStats();
+        LogLateStats late = logGetLateStats();
+        LogPipelineStats pipeline = logPipelineGetStats();
+
+        DynamicJsonDocument jsonDoc(6144);
+        jsonDoc["uptimeS"] = millis() / 1000;
+
+        JsonObject cardObj = jsonDoc.createNestedObject("card");
+        cardObj["initialized"] = sdCardInitialized;
+        cardObj["healthFailures"] = card.healthFailures;
+        cardObj["reinitAttempts"] = card.reinitAttempts;
+        cardObj["reinits"] = card.reinits;
+
+        // Upper bound of each histogram bucket in ms, the last one is open-ended
+        JsonArray bucketsArray = jsonDoc.createNestedArray("histogramMs");
+        for (int i = 0; i < SD_STATS_BUCKETS - 1; i++) {
+            bucketsArray.add(1 << i);
+        }
+
+        JsonObject opsObj = jsonDoc.createNestedObject("ops");
+        for (int op = 0; op < SD_OP_COUNT; op++) {
+            const SDOpStats &stats = ops[op];
+            if (stats.count == 0) continue;
+
+            JsonObject opObj = opsObj.createNestedObject(sdStatsOpName((SDOp)op));
+            opObj["count"] = stats.count;
+            opObj["errors"] = stats.errors;
+            opObj["bytes"] = stats.bytes;
+            opObj["avgUs"] = (uint32_t)(stats.totalUs / stats.count);
+            opObj["maxUs"] = stats.maxUs;
+            JsonArray histogram = opObj.createNestedArray("histogram");
+            for (int i = 0; i < SD_STATS_BUCKETS; i++) {
+                histogram.add(stats.histogram[i]);
+            }
+        }
+
+        JsonObject bufferObj = jsonDoc.createNestedObject("writeBuffer");
+        bufferObj["buffered"] = buffer.buffered;
+        bufferObj["recordsAdded"] = buffer.recordsAdded;
+        bufferObj["recordsWritten"] = buffer.recordsWritten;
+        bufferObj["recordsDropped"] = buffer.recordsDropped;
+        bufferObj["recordsReordered"] = buffer.recordsReordered;
+        bufferObj["recordsDuplicate"] = buffer.recordsDuplicate;
+        bufferObj["flushesSize"] = buffer.flushes[LOG_FLUSH_SIZE];
+        bufferObj["flushesTime"] = buffer.flushes[LOG_FLUSH_TIME];
+        bufferObj["flushesIdle"] = buffer.flushes[LOG_FLUSH_IDLE];
+        bufferObj["flushErrors"] = buffer.flushErrors;
+        bufferObj["lastFlushMs"] = buffer.lastFlushMs;
+        bufferObj["oldestAgeS"] = buffer.oldestAgeS;
+
+        JsonObject lateObj = jsonDoc.createNestedObject("lateRecords");
+        lateObj["merged"] = late.merged;
+        lateObj["duplicates"] = late.duplicates;
+        lateObj["dropped"] = late.dropped;
+
+        JsonObject pipelineObj = jsonDoc.createNestedObject("pipeline");
+        pipelineObj["readings"] = pipeline.readings;
+        pipelineObj["renderDropped"] = pipeline.renderDropped;
+        pipelineObj["logDropped"] = pipeline.logDropped;
+        pipelineObj["logQueueMax"] = pipeline.logQueueMax;
+        pipelineObj["logQueueLength"] = CSV_LOG_QUEUE_LENGTH;
+        pipelineObj["outages"] = pipeline.outages;
+        pipelineObj["lastOutageMs"] = pipeline.lastOutageMs;
+        pipelineObj["maxOutageMs"] = pipeline.maxOutageMs;
+        pipelineObj["outageForMs"] = pipeline.outageSinceMs ? millis() - pipeline.outageSinceMs : 0;
+
+        String response;
+        serializeJson(jsonDoc, response);
+        request->send(200, "application/json", response);
+    });
+
+    // Pairing window for new ESP-NOW nodes - /sensors/pair?seconds=N (default 120, 0 closes it)
+    logServer.on("/sensors/pair", HTTP_POST, [](AsyncWebServerRequest *request) {
+        uint32_t seconds = 120;
+        if (request->hasParam("seconds")) {
+            seconds = constrain(request->getParam("seconds")->value().toInt(), 0, SENSOR_PAIRING_MAX_S);
+        }
+        sensorRegistryOpenPairing(seconds);
+        request->send(200, "text/plain", seconds > 0 ? "Pairing open" : "Pairing closed");
+    });
+
+    // Forget a paired node - /sensors/remove?id=N, its logs stay on the card
+    logServer.on("/sensors/remove", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (!request->hasParam("id")) {
+            request->send(400, "text/plain", "Missing id parameter");
             return;
         }
-        
-        StaticJsonDocument<1024> jsonDoc;
-        JsonArray filesArray = jsonDoc.createNestedArray("files");
-        
-        File file = root.openNextFile();
-        while (file) {
-            const char* filename = file.name();
-            if (strstr(filename, ".csv") != NULL && 
-                (strstr(filename, "inside_log") != NULL || strstr(filename, "outside_log") != NULL)) {
-                filesArray.add(filename);
+        long id = request->getParam("id")->value().toInt();
+        if (id < 0 || id >= SENSOR_REGISTRY_MAX || !sensorRegistryRemove((SensorId)id)) {
+            request->send(404, "text/plain", "No removable sensor with this id");
+            return;
+        }
+        request->send(200, "text/plain", "Sensor removed");
+    });
+
+    // Sensor registry - every node with its log partition and latest reading
+    logServer.on("/sensors", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument jsonDoc(4096);
+        JsonArray sensorsArray = jsonDoc.to<JsonArray>();
+
+        for (SensorId id = 0; id < SENSOR_REGISTRY_MAX; id++) {
+            SensorInfo info;
+            if (!sensorRegistryGet(id, info)) continue;
+
+            JsonObject sensorObj = sensorsArray.createNestedObject();
+            sensorObj["id"] = id;
+            sensorObj["name"] = info.name;
+            sensorObj["label"] = info.label;
+            if (info.hasMac) {
+                char mac[18];
+                snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+                         info.mac[0], info.mac[1], info.mac[2], info.mac[3], info.mac[4], info.mac[5]);
+                sensorObj["mac"] = mac;
+            }
+
+            SensorData latest;
+            if (sensorRegistryGetLatest(id, latest)) {
+                sensorObj["tS"] = latest.timestamp;
+                sensorObj["T"] = roundToOneDecimal(latest.temperature);
+                sensorObj["H"] = roundToOneDecimal(latest.humidity);
+                if (info.flags & SENSOR_FLAG_PRESSURE) {
+                    sensorObj["P"] = roundToOneDecimal(latest.pressure);
+                }
+                sensorObj["bat"] = latest.batPercentage;
             }
-            file.close();
-            file = root.openNextFile();
         }
-        root.close();
-        
+
         String response;
         serializeJson(jsonDoc, response);
         request->send(200, "application/json", response);
@@ -314,6 +786,18 @@ void setupLogWebServer() {
             filename = "/" + filename;
         }
         
+        // Log segments are streamed as CSV through a converter
+        std::shared_ptr<LogCSVStream> csvStream = std::make_shared<LogCSVStream>();
+        if (csvStream->openName(filename.c_str())) {
+            AsyncWebServerResponse *response = request->beginChunkedResponse("text/csv",
+                [csvStream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                    return csvStream->read(buffer, maxLen);
+                });
+            response->addHeader("Content-Disposition", "attachment; filename=" + filename.substring(filename.lastIndexOf('/') + 1));
+            request->send(response);
+            return;
+        }
+        
         if (!SD.exists(filename)) {
             request->send(404, "text/plain", "File not found");
             return;
@@ -348,40 +832,49 @@ void setupLogWebServer() {
             request->send(500, "text/plain", "Failed to create zip file");
             return;
         }
+        fileCatalogAdd(zipFilename.c_str());
         
-        // Find matching files
-        File root = SD.open("/");
-        if (!root) {
-            request->send(500, "text/plain", "Failed to open root directory");
-            return;
-        }
-        
+        const char* sensor = (pattern == "all_inside") ? insideLogName : outsideLogName;
         bool filesAdded = false;
-        File file = root.openNextFile();
-        while (file) {
-            String filename = file.name();
-            
-            bool shouldInclude = false;
-            if (pattern == "all_inside" && filename.indexOf("inside_log") >= 0) {
-                shouldInclude = true;
-            } else if (pattern == "all_outside" && filename.indexOf("outside_log") >= 0) {
-                shouldInclude = true;
+        
+        // One CSV per monthly segment
+        size_t segmentCount = logListSegments(sensor, NULL, 0);
+        LogSegmentInfo *segments = (LogSegmentInfo*)malloc(max(segmentCount, (size_t)1) * sizeof(LogSegmentInfo));
+        if (segments) {
+            segmentCount = logListSegments(sensor, segments, segmentCount);
+            for (size_t i = 0; i < segmentCount; i++) {
+                char csvName[32];
+                snprintf(csvName, sizeof(csvName), "%s_%06u.csv", sensor, (unsigned)segments[i].month);
+                filesAdded |= zipper.addLogAsCSV(csvName);
             }
-            
-            if (shouldInclude) {
-                zipper.addFile(filename.c_str());
-                filesAdded = true;
+            free(segments);
+        }
+        
+        // Archived segments and CSV backups of older firmware
+        char prefix[LOG_SENSOR_NAME_MAX + 1];
+        snprintf(prefix, sizeof(prefix), "%s_", sensor);
+        size_t fileCount = fileCatalogList(FILE_KIND_ARCHIVED | FILE_KIND_CSV_BACKUP, prefix, NULL, 0);
+        FileCatalogEntry *files = (FileCatalogEntry*)malloc(max(fileCount, (size_t)1) * sizeof(FileCatalogEntry));
+        if (files) {
+            fileCount = fileCatalogList(FILE_KIND_ARCHIVED | FILE_KIND_CSV_BACKUP, prefix, files, fileCount);
+            for (size_t i = 0; i < fileCount; i++) {
+                const char *name = strrchr(files[i].path, '/') + 1;
+                if (files[i].kind == FILE_KIND_ARCHIVED) {
+                    char csvName[FILE_CATALOG_PATH_MAX];
+                    snprintf(csvName, sizeof(csvName), "%.*s.csv", (int)strlen(name) - 4, name);
+                    filesAdded |= zipper.addLogAsCSV(csvName);
+                } else {
+                    filesAdded |= zipper.addFile(files[i].path);
+                }
             }
-            
-            file.close();
-            file = root.openNextFile();
+            free(files);
         }
-        root.close();
         
         // Zipper destructor will finalize the ZIP file
         
         if (!filesAdded) {
             SD.remove(zipFilename);
+            fileCatalogRemove(zipFilename.c_str());
             request->send(404, "text/plain", "No matching files found");
             return;
         }
@@ -391,9 +884,8 @@ void setupLogWebServer() {
         response->addHeader("Content-Disposition", "attachment; filename=" + zipFilename.substring(zipFilename.lastIndexOf('/') + 1));
         request->send(response);
         
-        // Note: You might want to delete the ZIP file after serving it,
-        // but AsyncWebServer doesn't provide an easy way to do this.
-        // You may need to implement a cleanup task to remove old ZIP files.
+        // AsyncWebServer can't tell when the download is done - cleanupOldCustomJSONs() removes
+        // ZIP files after the same 12 hours as custom range JSONs
     });
 
     logServer.begin();
@@ -420,15 +912,21 @@ int getTimeLimitHours(const char* range) {
     return 24;  // Default
 }
 
-// Min/Max/Avg calculation
-void calculateMinMaxAvg(const char* filename, int range_hours, JsonDocument &jsonDoc, const char* prefix) {
-    File file = SD.open(filename, FILE_READ);
-    if (!file) return;
+// Dynamic Averaging Rules
+int getAggregationStep(int rangeHours) {
+    if (rangeHours > 8760) return 604800;  // Weekly averages if selected range >1 year
+    if (rangeHours > 672) return 86400;    // Daily averages if selected range >30 days
+    if (rangeHours > 168) return 3600;     // Hourly averages if selected range >7 days
+    return 300;                            // Default: 5-minute intervals
+}
 
+// Min/Max/Avg calculation
+void calculateMinMaxAvg(const char* sensor, int range_hours, JsonDocument &jsonDoc, const char* prefix) {
+    bool hasPressure = sensorHasPressure(sensorRegistryFind(sensor));
     float minTemp = 999, maxTemp = -999, sumTemp = 0;
     float minHumidity = 999, maxHumidity = -999, sumHumidity = 0;
     float minPressure = 9999, maxPressure = -9999, sumPressure = 0;
-    int count = 0, currentTime = time(nullptr);
+    int count = 0, pressureCount = 0, currentTime = time(nullptr);
     int timeLimit = currentTime - (range_hours * 3600);
     
 
@@ -436,58 +934,99 @@ void calculateMinMaxAvg(const char* filename, int range_hours, JsonDocument &jso
     int minHumidityTime = 0, maxHumidityTime = 0;
     int minPressureTime = 0, maxPressureTime = 0;
 
-    char line[64];
-    while (file.available()) {
-        size_t bytesRead = file.readBytesUntil('\n', line, sizeof(line)-1);
-        line[bytesRead] = '\0';
-        
-        int timestamp;
-        float temperature, humidity, pressure = 0;
-        if (strcmp(prefix, "outside") == 0) {
-            sscanf(line, "%d,%f,%f,%f", &timestamp, &temperature, &humidity, &pressure);
-        } else {
-            sscanf(line, "%d,%f,%f", &timestamp, &temperature, &humidity);
+    auto addRecord = [&](const LogRecord &rec) {
+        int timestamp = rec.timestamp;
+        float temperature = logRecordTemperature(rec);
+        float humidity = logRecordHumidity(rec);
+        float pressure = logRecordPressure(rec);
+
+        // Temperature
+        if (temperature < minTemp) {
+            minTemp = temperature;
+            minTempTime = timestamp;
+        }
+        if (temperature > maxTemp) {
+            maxTemp = temperature;
+            maxTempTime = timestamp;
         }
+        sumTemp += temperature;
 
-        if (timestamp >= timeLimit) {
-            // Temperature
-            if (temperature < minTemp) {
-                minTemp = temperature;
-                minTempTime = timestamp;
-            }
-            if (temperature > maxTemp) {
-                maxTemp = temperature;
-                maxTempTime = timestamp;
-            }
-            sumTemp += temperature;
+        // Humidity
+        if (humidity < minHumidity) {
+            minHumidity = humidity;
+            minHumidityTime = timestamp;
+        }
+        if (humidity > maxHumidity) {
+            maxHumidity = humidity;
+            maxHumidityTime = timestamp;
+        }
+        sumHumidity += humidity;
 
-            // Humidity
-            if (humidity < minHumidity) {
-                minHumidity = humidity;
-                minHumidityTime = timestamp;
+        // Pressure (only sensors with a BME280, records of failed readings carry none)
+        if (hasPressure && (rec.flags & LOG_FLAG_HAS_PRESSURE)) {
+            if (pressure < minPressure) {
+                minPressure = pressure;
+                minPressureTime = timestamp;
             }
-            if (humidity > maxHumidity) {
-                maxHumidity = humidity;
-                maxHumidityTime = timestamp;
+            if (pressure > maxPressure) {
+                maxPressure = pressure;
+                maxPressureTime = timestamp;
             }
-            sumHumidity += humidity;
+            sumPressure += pressure;
+            pressureCount++;
+        }
+        count++;
+    };
 
-            // Pressure (Only for outside)
-            if (strcmp(prefix, "outside") == 0) {
-                if (pressure < minPressure) {
-                    minPressure = pressure;
-                    minPressureTime = timestamp;
-                }
-                if (pressure > maxPressure) {
-                    maxPressure = pressure;
-                    maxPressureTime = timestamp;
-                }
-                sumPressure += pressure;
+    // Hot cache - exact values straight from PSRAM when the range is recent enough
+    bool fromHotCache = false;
+    LogHotCacheReader hotReader;
+    if (logHotCacheCovers(sensor, timeLimit) && hotReader.open(sensor, timeLimit, currentTime)) {
+        LogRecord rec;
+        while (hotReader.next(rec)) {
+            addRecord(rec);
+        }
+        fromHotCache = true;
+    }
+
+    // Rollup rows for the buckets entirely inside the range, raw records only at its two edges
+    LogRangeStats stats;
+    bool fromRollup = !fromHotCache && logRangeStats(sensor, timeLimit, currentTime, MINMAX_MAX_ROLLUP_ROWS, stats);
+    if (fromRollup) {
+        minTemp = stats.temperature.min / LOG_TEMP_SCALE;
+        minTempTime = stats.temperature.minTs;
+        maxTemp = stats.temperature.max / LOG_TEMP_SCALE;
+        maxTempTime = stats.temperature.maxTs;
+        sumTemp = stats.temperature.sum / LOG_TEMP_SCALE;
+
+        minHumidity = stats.humidity.min / LOG_HUMIDITY_SCALE;
+        minHumidityTime = stats.humidity.minTs;
+        maxHumidity = stats.humidity.max / LOG_HUMIDITY_SCALE;
+        maxHumidityTime = stats.humidity.maxTs;
+        sumHumidity = stats.humidity.sum / LOG_HUMIDITY_SCALE;
+
+        if (hasPressure && stats.pressureCount > 0) {
+            minPressure = stats.pressure.min / LOG_PRESSURE_SCALE;
+            minPressureTime = stats.pressure.minTs;
+            maxPressure = stats.pressure.max / LOG_PRESSURE_SCALE;
+            maxPressureTime = stats.pressure.maxTs;
+            sumPressure = stats.pressure.sum / LOG_PRESSURE_SCALE;
+            pressureCount = stats.pressureCount;
+        }
+        count = stats.count;
+    } else if (!fromHotCache) {
+        // Raw log fallback - only segments overlapping the range are opened, index sidecar jumps to the range start
+        LogQuery query;
+        if (!query.open(sensor, timeLimit, currentTime)) return;
+
+        LogRecord rec;
+        while (query.next(rec)) {
+            if (rec.timestamp >= timeLimit) {
+                addRecord(rec);
             }
-            count++;
         }
+        query.close();
     }
-    file.close();
 
     if (count > 0) {
         char fieldName[32];
@@ -524,13 +1063,22 @@ void calculateMinMaxAvg(const char* filename, int range_hours, JsonDocument &jso
         snprintf(fieldName, sizeof(fieldName), "%s_humidity_avg", prefix);
         jsonDoc[fieldName] = roundToOneDecimal(sumHumidity / count);
 
-        // Pressure (only for outside)
-        if (strcmp(prefix, "outside") == 0) {
-            jsonDoc["outside_pressure_min"] = roundToOneDecimal(minPressure);
-            jsonDoc["outside_pressure_min_time"] = minPressureTime;
-            jsonDoc["outside_pressure_max"] = roundToOneDecimal(maxPressure);
-            jsonDoc["outside_pressure_max_time"] = maxPressureTime;
-            jsonDoc["outside_pressure_avg"] = roundToOneDecimal(sumPressure / count);
+        // Pressure (only sensors with a BME280)
+        if (pressureCount > 0) {
+            snprintf(fieldName, sizeof(fieldName), "%s_pressure_min", prefix);
+            jsonDoc[fieldName] = roundToOneDecimal(minPressure);
+
+            snprintf(fieldName, sizeof(fieldName), "%s_pressure_min_time", prefix);
+            jsonDoc[fieldName] = minPressureTime;
+
+            snprintf(fieldName, sizeof(fieldName), "%s_pressure_max", prefix);
+            jsonDoc[fieldName] = roundToOneDecimal(maxPressure);
+
+            snprintf(fieldName, sizeof(fieldName), "%s_pressure_max_time", prefix);
+            jsonDoc[fieldName] = maxPressureTime;
+
+            snprintf(fieldName, sizeof(fieldName), "%s_pressure_avg", prefix);
+            jsonDoc[fieldName] = roundToOneDecimal(sumPressure / pressureCount);
         }
         
         Serial.printf("[DEBUG] MinMax %s sensor: Found %d data points in last %d hours\\n", prefix, count, range_hours);
@@ -539,9 +1087,9 @@ void calculateMinMaxAvg(const char* filename, int range_hours, JsonDocument &jso
     }
 }
 
-// This function streams data and writes directly to file
-bool generateStreamingJSONData(const char* range) {
-    char insideFilename[32], outsideFilename[32];
+// This function streams one sensor's data and writes directly to /<sensor>_<range>.json
+bool generateStreamingJSONData(const char* sensor, const char* range, bool isOutsideData) {
+    char filename[48];
     int startTime = 0, endTime = 0;
     bool isCustom = false;
 
@@ -551,12 +1099,8 @@ bool generateStreamingJSONData(const char* range) {
             Serial.printf("[ERROR] Invalid custom range format: %s\n", range);
             return false;
         }
-        snprintf(insideFilename, sizeof(insideFilename), "/inside_%s.json", range);
-        snprintf(outsideFilename, sizeof(outsideFilename), "/outside_%s.json", range);
-    } else {
-        snprintf(insideFilename, sizeof(insideFilename), "/inside_%s.json", range);
-        snprintf(outsideFilename, sizeof(outsideFilename), "/outside_%s.json", range);
     }
+    snprintf(filename, sizeof(filename), "/%s_%s.json", sensor, range);
 
     if (jsonGenerationInProgress) {
         Serial.printf("[WARNING] JSON generation already in progress. Skipping request for: %s\n", range);
@@ -564,42 +1108,301 @@ bool generateStreamingJSONData(const char* range) {
     }
     jsonGenerationInProgress = true;
 
-    Serial.printf("[INFO] Generating JSON for range: %s\n", range);
+    Serial.printf("[INFO] Generating JSON for %s, range: %s\n", sensor, range);
     
     int currentTime = time(nullptr);
     int timeLimit = isCustom ? startTime : (currentTime - getTimeLimitHours(range) * 3600);
     
-    // Dynamic Averaging Rules
-    int aggregationStep = 300;  // Default: 5-minute intervals
-    if (getTimeLimitHours(range) > 168) aggregationStep = 3600;  // Hourly averages if selected range >7 days
-    if (getTimeLimitHours(range) > 672) aggregationStep = 86400;  // Daily averages if selected range >30 days
-    if (getTimeLimitHours(range) > 8760) aggregationStep = 604800;  // Weekly averages if selected range >1 year
-
-    // Process inside data - stream to file
-    if (!streamProcessLogToJSON(insideLogFile, insideFilename, timeLimit, aggregationStep, false, 
+    int aggregationStep = getAggregationStep(getTimeLimitHours(range));
+
+    // Rollup tier matching the step, raw log only if the rollup isn't available
+    LogRollupTier tier = logRollupTierForStep(aggregationStep);
+    int rangeEnd = isCustom ? endTime : currentTime;
+
+    // Stream to file
+    if (!streamRollupToJSON(sensor, filename, tier, timeLimit, rangeEnd, isOutsideData) &&
+        !streamProcessLogToJSON(sensor, filename, timeLimit, aggregationStep, isOutsideData,
                     startTime, endTime, isCustom)) {
         jsonGenerationInProgress = false;
         return false;
     }
+
+    // Custom ranges are listed for cleanupOldCustomJSONs()
+    fileCatalogAdd(filename);
+
+    jsonGenerationInProgress = false;
+    return true;
+}
+
+// Stream pre-aggregated rollup rows directly to JSON file - one data point per bucket
+bool streamRollupToJSON(const char* sensor, const char* outputFilename, LogRollupTier tier,
+                        int startTime, int endTime, bool isOutsideData) {
+    LogRollupReader rollup;
+    if (!rollup.open(sensor, tier)) {
+        return false;
+    }
     
-    // Process outside data - stream to file
-    if (!streamProcessLogToJSON(outsideLogFile, outsideFilename, timeLimit, aggregationStep, true, 
-                   startTime, endTime, isCustom)) {
-        jsonGenerationInProgress = false;
+    // Remove output file if exists
+    if (SD.exists(outputFilename)) {
+        SD.remove(outputFilename);
+    }
+    
+    File outputFile = SD.open(outputFilename, FILE_WRITE);
+    if (!outputFile) {
+        Serial.printf("[ERROR] Failed to create output file: %s\n", outputFilename);
         return false;
     }
+    
+    // Start JSON array
+    outputFile.print("[");
+    
+    bool firstObject = true;
+    int points = 0;
+    rollup.seek(startTime);
+    
+    LogRollupRow row;
+    while (rollup.next(row)) {
+        if (row.bucketStart > endTime) {
+            break;
+        }
+        if (row.count == 0 || row.bucketStart + logRollupTierSeconds[tier] <= startTime) {
+            continue;
+        }
+        
+        if (!firstObject) {
+            outputFile.print(",");
+        }
+        firstObject = false;
+        
+        outputFile.print("{\"tS\":");
+        outputFile.print(row.bucketStart);
+        outputFile.print(",\"T\":");
+        outputFile.print(roundToOneDecimal(logRollupAverage(row.temperature, row.count, LOG_TEMP_SCALE)), 1);
+        outputFile.print(",\"H\":");
+        outputFile.print(roundToOneDecimal(logRollupAverage(row.humidity, row.count, LOG_HUMIDITY_SCALE)), 1);
+        
+        if (isOutsideData) {
+            outputFile.print(",\"P\":");
+            outputFile.print(roundToOneDecimal(logRollupAverage(row.pressure, row.pressureCount, LOG_PRESSURE_SCALE)), 1);
+        }
+        
+        outputFile.print("}");
+        points++;
+    }
+    
+    // Close JSON array
+    outputFile.print("]");
+    
+    rollup.close();
+    outputFile.close();
+    
+    Serial.printf("[DEBUG] %s: %d points from rollup tier %ds\n", outputFilename, points, logRollupTierSeconds[tier]);
+    return true;
+}
 
-    jsonGenerationInProgress = false;
+// Chart JSON pieces for a chunked response
+bool ChartJSONStream::addText(const String &text) {
+    if (pieceCount >= CHART_STREAM_MAX_PIECES) return false;
+    Piece &piece = pieces[pieceCount++];
+    piece.type = PIECE_TEXT;
+    piece.text = text;
+    piece.path[0] = '\0';
+    piece.pinned = false;
+    piece.offset = 0;
+    piece.length = text.length();
+    return true;
+}
+
+bool ChartJSONStream::addFileRange(const char *path, uint32_t offset, uint32_t length) {
+    if (pieceCount >= CHART_STREAM_MAX_PIECES || strlen(path) >= sizeof(pieces[0].path)) return false;
+    Piece &piece = pieces[pieceCount++];
+    piece.type = PIECE_FILE;
+    memset(piece.path, 0, sizeof(piece.path));
+    strncpy(piece.path, path, sizeof(piece.path) - 1);
+    piece.offset = offset;
+    piece.length = length;
+    piece.pinned = chartCachePin(path);
+    if (!piece.pinned) {
+        Serial.printf("[WARNING] Chart file pin table full, %s streamed unpinned\n", path);
+    }
     return true;
 }
 
-// Stream process data from CSV file directly to JSON file
-bool streamProcessLogToJSON(const char* inputFilename, const char* outputFilename, int timeLimit, 
+bool ChartJSONStream::addFile(const char *path, const char *fallback) {
+    File source = SD.open(path, FILE_READ);
+    size_t size = source ? source.size() : 0;
+    if (source) source.close();
+    if (size == 0) {
+        Serial.printf("[ERROR] Missing file: %s\n", path);
+        return addText(fallback);
+    }
+    return addFileRange(path, 0, size);
+}
+
+bool ChartJSONStream::addHotCache(const char *sensor, int32_t start, int32_t end, LogRollupTier tier, bool isOutside) {
+    if (pieceCount >= CHART_STREAM_MAX_PIECES || strlen(sensor) >= sizeof(pieces[0].path) ||
+        !logHotCacheCovers(sensor, start)) return false;
+    Piece &piece = pieces[pieceCount++];
+    piece.type = PIECE_HOT_CACHE;
+    memset(piece.path, 0, sizeof(piece.path));
+    strncpy(piece.path, sensor, sizeof(piece.path) - 1);
+    piece.offset = 0;
+    piece.length = 0;
+    piece.pinned = false;
+    piece.start = start;
+    piece.end = end;
+    piece.tier = tier;
+    piece.isOutside = isOutside;
+    return true;
+}
+
+// Response done or client gone - files not sent completely are released here
+ChartJSONStream::~ChartJSONStream() {
+    if (file) file.close();
+    for (size_t i = 0; i < pieceCount; i++) {
+        if (pieces[i].pinned) chartCacheUnpin(pieces[i].path);
+    }
+}
+
+size_t ChartJSONStream::length() {
+    size_t total = 0;
+    for (size_t i = 0; i < pieceCount; i++) {
+        total += pieces[i].length;
+    }
+    return total;
+}
+
+// Formats the next part of a hot cache piece into point - "[", one point per completed bucket,
+// "]"; false once the piece is complete
+bool ChartJSONStream::nextHotPoint(const Piece &piece) {
+    pointLen = pointPos = 0;
+    if (hotPhase == HOT_OPEN) {
+        // Evicted since addHotCache() - the array stays valid, just empty
+        hotPhase = hotReader.open(piece.path, piece.start, piece.end) ? HOT_POINTS : HOT_CLOSE;
+        count = pressureCount = 0;
+        tempSum = humiditySum = pressureSum = 0;
+        firstPoint = true;
+        point[pointLen++] = '[';
+        return true;
+    }
+    if (hotPhase == HOT_CLOSE) {
+        hotPhase = HOT_DONE;
+        point[pointLen++] = ']';
+        return true;
+    }
+    if (hotPhase == HOT_DONE) {
+        hotPhase = HOT_OPEN;
+        return false;
+    }
+
+    LogRecord rec;
+    while (true) {
+        bool more = hotReader.next(rec);
+        int32_t recordBucket = more ? logRollupBucketStart(rec.timestamp, piece.tier) : 0;
+
+        // Bucket complete - its data point, same values the rollup tier gives
+        if (count > 0 && (!more || recordBucket != bucket)) {
+            float temperature = roundToOneDecimal(tempSum / (float)count / LOG_TEMP_SCALE);
+            float humidity = roundToOneDecimal(humiditySum / (float)count / LOG_HUMIDITY_SCALE);
+            int written;
+            if (piece.isOutside) {
+                float pressure = pressureCount > 0 ? roundToOneDecimal(pressureSum / (float)pressureCount / LOG_PRESSURE_SCALE) : 0;
+                written = snprintf(point, sizeof(point), "%s{\"tS\":%d,\"T\":%.1f,\"H\":%.1f,\"P\":%.1f}",
+                                   firstPoint ? "" : ",", (int)bucket, temperature, humidity, pressure);
+            } else {
+                written = snprintf(point, sizeof(point), "%s{\"tS\":%d,\"T\":%.1f,\"H\":%.1f}",
+                                   firstPoint ? "" : ",", (int)bucket, temperature, humidity);
+            }
+            pointLen = written > 0 ? min((size_t)written, sizeof(point) - 1) : 0;
+            firstPoint = false;
+            count = pressureCount = 0;
+            tempSum = humiditySum = pressureSum = 0;
+        }
+        if (!more) {
+            hotPhase = HOT_CLOSE;
+            return pointLen > 0 || nextHotPoint(piece);
+        }
+
+        bucket = recordBucket;
+        tempSum += rec.temperature;
+        humiditySum += rec.humidity;
+        if (rec.flags & LOG_FLAG_HAS_PRESSURE) {
+            pressureSum += rec.pressure;
+            pressureCount++;
+        }
+        count++;
+        if (pointLen > 0) return true;
+    }
+}
+
+// A file that can't be read ends the response early - the client gets truncated JSON instead of a hang
+size_t ChartJSONStream::read(uint8_t *dest, size_t maxLen) {
+    size_t total = 0;
+    while (total < maxLen && current < pieceCount) {
+        Piece &piece = pieces[current];
+        size_t chunk = min((size_t)(piece.length - pieceOffset), maxLen - total);
+
+        if (piece.type == PIECE_HOT_CACHE) {
+            // Length unknown - the piece ends when the generator has nothing left
+            if (pointPos >= pointLen && !nextHotPoint(piece)) {
+                current++;
+                pieceOffset = 0;
+                continue;
+            }
+            chunk = min(pointLen - pointPos, maxLen - total);
+            memcpy(dest + total, point + pointPos, chunk);
+            pointPos += chunk;
+            total += chunk;
+            continue;
+        }
+
+        if (piece.type == PIECE_TEXT) {
+            memcpy(dest + total, piece.text.c_str() + pieceOffset, chunk);
+        } else if (chunk > 0) {
+            SDOpTimer timer(SD_OP_READ);
+            if (!file) {
+                file = SD.open(piece.path, FILE_READ);
+                if (!file || !file.seek(piece.offset + pieceOffset)) {
+                    timer.done(false);
+                    Serial.printf("[ERROR] Failed to stream %s\n", piece.path);
+                    current = pieceCount;
+                    break;
+                }
+            }
+            size_t bytesRead = file.read(dest + total, chunk);
+            timer.done(bytesRead > 0, bytesRead);
+            if (bytesRead == 0) {
+                Serial.printf("[ERROR] Failed to stream %s\n", piece.path);
+                current = pieceCount;
+                break;
+            }
+            chunk = bytesRead;
+        }
+
+        total += chunk;
+        pieceOffset += chunk;
+        if (pieceOffset >= piece.length) {
+            if (file) file.close();
+            if (piece.pinned) {
+                chartCacheUnpin(piece.path);
+                piece.pinned = false;
+            }
+            current++;
+            pieceOffset = 0;
+        }
+    }
+    if (current >= pieceCount && file) file.close();
+    return total;
+}
+
+// Stream process data from binary log file directly to JSON file
+bool streamProcessLogToJSON(const char* sensor, const char* outputFilename, int timeLimit, 
                            int aggregationStep, bool isOutsideData, int startTime = 0, 
                            int endTime = 0, bool isCustom = false) {
-    File inputFile = SD.open(inputFilename, FILE_READ);
-    if (!inputFile) {
-        Serial.printf("[ERROR] Failed to open log file: %s\n", inputFilename);
+    // Only segments overlapping the range are opened, index sidecar jumps to the range start
+    LogQuery query;
+    if (!query.open(sensor, isCustom ? startTime : timeLimit, isCustom ? endTime : INT32_MAX)) {
+        Serial.printf("[ERROR] No log segments for sensor: %s\n", sensor);
         return false;
     }
     
@@ -611,7 +1414,6 @@ bool streamProcessLogToJSON(const char* inputFilename, const char* outputFilenam
     File outputFile = SD.open(outputFilename, FILE_WRITE);
     if (!outputFile) {
         Serial.printf("[ERROR] Failed to create output file: %s\n", outputFilename);
-        inputFile.close();
         return false;
     }
     
@@ -622,19 +1424,12 @@ bool streamProcessLogToJSON(const char* inputFilename, const char* outputFilenam
     float tempSum = 0, humiditySum = 0, pressureSum = 0;
     bool firstObject = true;
     
-    char line[64];
-    while (inputFile.available()) {
-        size_t bytesRead = inputFile.readBytesUntil('\n', line, sizeof(line)-1);
-        line[bytesRead] = '\0';
-        
-        int timestamp;
-        float temperature, humidity, pressure = 0;
-        
-        if (isOutsideData) {
-            sscanf(line, "%d,%f,%f,%f", &timestamp, &temperature, &humidity, &pressure);
-        } else {
-            sscanf(line, "%d,%f,%f", &timestamp, &temperature, &humidity);
-        }
+    LogRecord rec;
+    while (query.next(rec)) {
+        int timestamp = rec.timestamp;
+        float temperature = logRecordTemperature(rec);
+        float humidity = logRecordHumidity(rec);
+        float pressure = logRecordPressure(rec);
         
         bool inRange;
         if (isCustom) {
@@ -708,34 +1503,32 @@ bool streamProcessLogToJSON(const char* inputFilename, const char* outputFilenam
     // Close JSON array
     outputFile.print("]");
     
-    inputFile.close();
+    query.close();
     outputFile.close();
     
     return true;
 }
 
-// Cleanup old custom JSON files (older than 12h)
+// Cleanup old custom JSON files and ZIP downloads (older than 12h)
 void cleanupOldCustomJSONs() {
-    File root = SD.open("/");
-    if (!root) {
-        Serial.println("[ERROR] Failed to open root directory for cleanup");
+    size_t fileCount = fileCatalogList(FILE_KIND_CUSTOM_JSON | FILE_KIND_ZIP, NULL, NULL, 0);
+    if (fileCount == 0) return;
+
+    FileCatalogEntry *files = (FileCatalogEntry*)malloc(fileCount * sizeof(FileCatalogEntry));
+    if (!files) {
+        Serial.println("[ERROR] Failed to allocate file list for cleanup");
         return;
     }
-    
-    File file = root.openNextFile();
-    while (file) {
-        const char* name = file.name();
-        if (strncmp(name, "/custom_", 8) == 0) {
-            time_t createdTime = file.getLastWrite();
-            if (time(nullptr) - createdTime > 43200) {  // 12 hours
-                file.close();
-                SD.remove(name);
-                Serial.printf("[INFO] Removed old custom JSON: %s\n", name);
-                file = root.openNextFile();
-                continue;
-            }
+    fileCount = fileCatalogList(FILE_KIND_CUSTOM_JSON | FILE_KIND_ZIP, NULL, files, fileCount);
+
+    time_t now = time(nullptr);
+    for (size_t i = 0; i < fileCount; i++) {
+        if (now - files[i].modified > 43200 && !chartCachePinned(files[i].path)) {  // 12 hours, not being sent
+            SD.remove(files[i].path);
+            fileCatalogRemove(files[i].path);
+            Serial.printf("[INFO] Removed old %s: %s\n",
+                          files[i].kind == FILE_KIND_ZIP ? "ZIP download" : "custom JSON", files[i].path);
         }
-        file = root.openNextFile();
     }
-    root.close();
-}
\ No newline at end of file
+    free(files);
+}
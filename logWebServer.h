@@ -8,11 +8,11 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <freertos/queue.h>
+#include "logStorage.h"
+#include "logRollup.h"
+#include "logHotCache.h"
 
 
-// Queue handle for sensor data from main
-extern QueueHandle_t serverLatestQueue;
-
 class SimpleZipCreator {
     private:
         File zipFile;
@@ -93,6 +93,50 @@ class SimpleZipCreator {
             fileCount++;
             return true;
         }
+
+        // Adds log data converted to CSV (see LogCSVStream::openName) - sizes are patched into the header afterwards
+        bool addLogAsCSV(const char* csvName) {
+            LogCSVStream csvStream;
+            if (!csvStream.openName(csvName)) {
+                return false;
+            }
+
+            size_t headerPos = zipFile.position();
+            uint16_t nameLength = strlen(csvName);
+            uint32_t dataSize = 0;
+
+            // Local file header, same layout as addFile()
+            zipFile.write((uint8_t*)"\x50\x4b\x03\x04", 4); // Local file header signature
+            zipFile.write((uint8_t*)"\x0a\x00", 2);         // Version needed to extract
+            zipFile.write((uint8_t*)"\x00\x00", 2);         // General purpose bit flag
+            zipFile.write((uint8_t*)"\x00\x00", 2);         // Compression method (0=store)
+            zipFile.write((uint8_t*)"\x00\x00", 2);         // File last modification time
+            zipFile.write((uint8_t*)"\x00\x00", 2);         // File last modification date
+            zipFile.write((uint8_t*)"\x00\x00\x00\x00", 4); // CRC-32 (0 for simplicity)
+            zipFile.write((uint8_t*)&dataSize, 4);          // Compressed size - patched below
+            zipFile.write((uint8_t*)&dataSize, 4);          // Uncompressed size - patched below
+            zipFile.write((uint8_t*)&nameLength, 2);        // File name length
+            zipFile.write((uint8_t*)"\x00\x00", 2);         // Extra field length
+            zipFile.write((uint8_t*)csvName, nameLength);
+
+            // File data
+            uint8_t buffer[512];
+            size_t bytesRead;
+            while ((bytesRead = csvStream.read(buffer, sizeof(buffer))) > 0) {
+                zipFile.write(buffer, bytesRead);
+                dataSize += bytesRead;
+            }
+
+            // Patch sizes and return to the end of the archive
+            size_t endPos = zipFile.position();
+            zipFile.seek(headerPos + 18);
+            zipFile.write((uint8_t*)&dataSize, 4);
+            zipFile.write((uint8_t*)&dataSize, 4);
+            zipFile.seek(endPos);
+
+            fileCount++;
+            return true;
+        }
         
     private:
         void writeEndOfCentralDirectory() {
@@ -111,12 +155,77 @@ class SimpleZipCreator {
         }
     };
 
+// Sensors of one /chart-data or /minmax request - ?sensors=name,name, inside and outside by default
+#define CHART_MAX_SENSORS 4
+
+// Chart JSON assembled from text pieces, file ranges copied straight from SD and hot cache
+// buckets aggregated on the fly, all in response-sized chunks - peak memory stays one response
+// buffer however large the cached files or the hot cache ranges are
+#define CHART_STREAM_MAX_PIECES (3 * CHART_MAX_SENSORS + 1)
+
+class ChartJSONStream {
+    public:
+        ChartJSONStream() : pieceCount(0), current(0), pieceOffset(0), hotPhase(HOT_OPEN), pointLen(0), pointPos(0) {}
+        ~ChartJSONStream();
+
+        bool addText(const String &text);
+        // Bytes [offset, offset + length) of path, pinned (chartCachePin) until they are sent
+        bool addFileRange(const char *path, uint32_t offset, uint32_t length);
+        // Whole file, fallback text if it is missing or empty
+        bool addFile(const char *path, const char *fallback);
+        // JSON array of the sensor's hot cache records in [start, end] averaged per bucket of tier -
+        // same points the rollup tier gives; false if the hot cache doesn't cover start
+        bool addHotCache(const char *sensor, int32_t start, int32_t end, LogRollupTier tier, bool isOutside);
+        // Bytes of the text and file pieces, hot cache pieces aren't known ahead
+        size_t length();
+        size_t read(uint8_t *dest, size_t maxLen);
+
+    private:
+        typedef enum { PIECE_TEXT, PIECE_FILE, PIECE_HOT_CACHE } PieceType;
+        typedef enum { HOT_OPEN, HOT_POINTS, HOT_CLOSE, HOT_DONE } HotPhase;
+
+        typedef struct {
+            PieceType type;
+            String text;
+            char path[48];          // File path, sensor name of hot cache pieces
+            uint32_t offset;
+            uint32_t length;
+            bool pinned;            // File piece not sent yet
+            int32_t start;          // Hot cache range and buckets
+            int32_t end;
+            LogRollupTier tier;
+            bool isOutside;
+        } Piece;
+
+        bool nextHotPoint(const Piece &piece);
+
+        Piece pieces[CHART_STREAM_MAX_PIECES];
+        size_t pieceCount;
+        size_t current;
+        uint32_t pieceOffset;       // Bytes of the current piece already sent
+        File file;                  // Open while a file piece is being sent
+
+        // Hot cache piece being sent - one bucket is summed up, its point formatted into point
+        LogHotCacheReader hotReader;
+        HotPhase hotPhase;
+        int32_t bucket;
+        uint32_t count, pressureCount;
+        int32_t tempSum, humiditySum, pressureSum;
+        bool firstPoint;
+        char point[80];
+        size_t pointLen;
+        size_t pointPos;
+};
+
 void setupLogWebServer();
 float roundToOneDecimal(float value);
 int getTimeLimitHours(const char* range);
-void calculateMinMaxAvg(const char* filename, int range_hours, JsonDocument &jsonDoc, const char* prefix);
-bool generateStreamingJSONData(const char* range);
-bool streamProcessLogToJSON(const char* inputFilename, const char* outputFilename, int timeLimit, 
+int getAggregationStep(int rangeHours);
+void calculateMinMaxAvg(const char* sensor, int range_hours, JsonDocument &jsonDoc, const char* prefix);
+bool generateStreamingJSONData(const char* sensor, const char* range, bool isOutsideData);
+bool streamRollupToJSON(const char* sensor, const char* outputFilename, LogRollupTier tier,
+                        int startTime, int endTime, bool isOutsideData);
+bool streamProcessLogToJSON(const char* sensor, const char* outputFilename, int timeLimit, 
                           int aggregationStep, bool isOutsideData, int startTime, int endTime, bool isCustom);
 void cleanupOldCustomJSONs();
 
@@ -0,0 +1,204 @@
+#include "logWriteBuffer.h"
+
+// One contiguous record array per sensor, so a flush is a single logAppendBatch() per sensor
+typedef struct {
+    const char *sensor;
+    LogRecord *recs;
+    size_t count;
+} LogBufferSlot;
+
+static LogBufferSlot slots[LOG_BUFFER_MAX_SENSORS];
+static uint32_t oldestMillis = 0;       // millis() of the oldest buffered record
+static uint32_t retryMillis = 0;        // millis() of the last failed flush
+static bool retryPending = false;
+static LogBufferStats stats;
+static SemaphoreHandle_t statsMutex = NULL;
+
+static const char* flushReasonNames[LOG_FLUSH_REASONS] = {"size", "time", "idle"};
+
+bool logBufferInit() {
+    memset(&stats, 0, sizeof(stats));
+    statsMutex = xSemaphoreCreateMutex();
+
+    // Record arrays are allocated when a sensor first logs
+    for (int i = 0; i < LOG_BUFFER_MAX_SENSORS; i++) {
+        slots[i].sensor = NULL;
+        slots[i].recs = NULL;
+        slots[i].count = 0;
+    }
+
+    Serial.printf("[INFO] Log write buffer ready: flush at %d records or %d s\n",
+                  LOG_BUFFER_FLUSH_RECORDS, LOG_BUFFER_MAX_AGE_S);
+    return true;
+}
+
+static LogBufferSlot* slotFor(const char *sensor) {
+    for (int i = 0; i < LOG_BUFFER_MAX_SENSORS; i++) {
+        if (slots[i].sensor != NULL && strcmp(slots[i].sensor, sensor) == 0) return &slots[i];
+    }
+    for (int i = 0; i < LOG_BUFFER_MAX_SENSORS; i++) {
+        if (slots[i].sensor == NULL) {
+            // PSRAM preferred, internal RAM as fallback
+            slots[i].recs = (LogRecord*)ps_malloc(LOG_BUFFER_CAPACITY * sizeof(LogRecord));
+            if (!slots[i].recs) {
+                slots[i].recs = (LogRecord*)malloc(LOG_BUFFER_CAPACITY * sizeof(LogRecord));
+            }
+            if (!slots[i].recs) {
+                Serial.printf("[ERROR] Failed to allocate log write buffer for %s\n", sensor);
+                return NULL;
+            }
+            slots[i].sensor = sensor;
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t logBufferCount() {
+    uint32_t count = 0;
+    for (int i = 0; i < LOG_BUFFER_MAX_SENSORS; i++) count += slots[i].count;
+    return count;
+}
+
+static void updateStats() {
+    xSemaphoreTake(statsMutex, portMAX_DELAY);
+    stats.buffered = logBufferCount();
+    stats.oldestAgeS = stats.buffered > 0 ? (millis() - oldestMillis) / 1000 : 0;
+    xSemaphoreGive(statsMutex);
+}
+
+// Counters are read by the web server task through logBufferGetStats()
+static void countRecord(uint32_t &counter) {
+    xSemaphoreTake(statsMutex, portMAX_DELAY);
+    counter++;
+    xSemaphoreGive(statsMutex);
+}
+
+void logBufferAdd(const char *sensor, const LogRecord &rec) {
+    LogBufferSlot *slot = slotFor(sensor);
+    if (slot == NULL || slot->recs == NULL) {
+        Serial.printf("[ERROR] No log write buffer slot for %s, record dropped\n", sensor);
+        countRecord(stats.recordsDropped);
+        return;
+    }
+
+    // Time order - a late reading moves in behind the newest older one, a resend is dropped
+    size_t pos = slot->count;
+    while (pos > 0 && slot->recs[pos - 1].timestamp > rec.timestamp) pos--;
+    if (pos > 0 && slot->recs[pos - 1].timestamp == rec.timestamp) {
+        countRecord(stats.recordsDuplicate);
+        return;
+    }
+
+    if (logBufferCount() == 0) oldestMillis = millis();
+
+    // Card unavailable for a long time - keep the newest records
+    if (slot->count >= LOG_BUFFER_CAPACITY) {
+        countRecord(stats.recordsDropped);
+        if (pos == 0) return;
+        memmove(slot->recs, slot->recs + 1, (LOG_BUFFER_CAPACITY - 1) * sizeof(LogRecord));
+        slot->count--;
+        pos--;
+    }
+
+    if (pos < slot->count) {
+        memmove(slot->recs + pos + 1, slot->recs + pos, (slot->count - pos) * sizeof(LogRecord));
+        countRecord(stats.recordsReordered);
+    }
+    slot->recs[pos] = rec;
+    slot->count++;
+    countRecord(stats.recordsAdded);
+    updateStats();
+}
+
+// Milliseconds until a failed flush may be retried, 0 if none is pending
+static uint32_t retryWaitMs() {
+    if (!retryPending) return 0;
+    uint32_t elapsed = millis() - retryMillis;
+    return elapsed >= LOG_BUFFER_RETRY_S * 1000UL ? 0 : LOG_BUFFER_RETRY_S * 1000UL - elapsed;
+}
+
+void logBufferRetryLater() {
+    retryMillis = millis();
+    retryPending = true;
+}
+
+int logBufferFlushDue() {
+    uint32_t count = logBufferCount();
+    if (count == 0) return -1;
+    if (retryWaitMs() > 0) return -1;
+    if (count >= LOG_BUFFER_FLUSH_RECORDS) return LOG_FLUSH_SIZE;
+    if (millis() - oldestMillis >= LOG_BUFFER_MAX_AGE_S * 1000UL) return LOG_FLUSH_TIME;
+    return -1;
+}
+
+bool logBufferFlushBeforeIdle(uint32_t idleSeconds, bool deepSleep) {
+    if (logBufferCount() == 0) return false;
+    if (deepSleep) return true;
+    if (retryWaitMs() > 0) return false;
+    return (millis() - oldestMillis) / 1000 + idleSeconds >= LOG_BUFFER_MAX_AGE_S;
+}
+
+TickType_t logBufferWaitTicks() {
+    if (logBufferCount() == 0) return portMAX_DELAY;
+    uint32_t retryWait = retryWaitMs();
+    if (retryWait > 0) return pdMS_TO_TICKS(retryWait);
+
+    uint32_t age = millis() - oldestMillis;
+    uint32_t window = LOG_BUFFER_MAX_AGE_S * 1000UL;
+    return age >= window ? 0 : pdMS_TO_TICKS(window - age);
+}
+
+bool logBufferFlush(LogFlushReason reason) {
+    uint32_t startMillis = millis();
+    uint32_t written = 0;
+    bool ok = true;
+
+    for (int i = 0; i < LOG_BUFFER_MAX_SENSORS; i++) {
+        LogBufferSlot &slot = slots[i];
+        if (slot.count == 0) continue;
+
+        // A failed batch stays buffered - records of it that made it to the card are dropped as
+        // duplicates when the retry merges them
+        if (logAppendBatch(slot.sensor, slot.recs, slot.count)) {
+            written += slot.count;
+            slot.count = 0;
+        } else {
+            Serial.printf("[ERROR] Flushing %u buffered %s records failed\n", (unsigned)slot.count, slot.sensor);
+            ok = false;
+        }
+    }
+
+    // Leftovers keep their age, the next attempt waits for the retry backoff instead
+    if (ok) {
+        retryPending = false;
+    } else {
+        logBufferRetryLater();
+    }
+
+    xSemaphoreTake(statsMutex, portMAX_DELAY);
+    stats.recordsWritten += written;
+    stats.flushes[reason]++;
+    if (!ok) stats.flushErrors++;
+    stats.lastFlushMs = millis() - startMillis;
+    xSemaphoreGive(statsMutex);
+    updateStats();
+
+    Serial.printf("[INFO] Log buffer flush (%s): %u records in %u ms, flushes size/time/idle: %u/%u/%u\n",
+                  flushReasonNames[reason], (unsigned)written, (unsigned)stats.lastFlushMs,
+                  (unsigned)stats.flushes[LOG_FLUSH_SIZE], (unsigned)stats.flushes[LOG_FLUSH_TIME],
+                  (unsigned)stats.flushes[LOG_FLUSH_IDLE]);
+    return ok;
+}
+
+LogBufferStats logBufferGetStats() {
+    LogBufferStats copy;
+    memset(&copy, 0, sizeof(copy));
+    if (statsMutex == NULL) return copy;
+
+    updateStats();
+    xSemaphoreTake(statsMutex, portMAX_DELAY);
+    copy = stats;
+    xSemaphoreGive(statsMutex);
+    return copy;
+}
@@ -0,0 +1,74 @@
+#ifndef LOGWRITEBUFFER_H
+#define LOGWRITEBUFFER_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "logStorage.h"
+
+// Write-behind buffer for sensor log records
+// SDLogTask collects records here (PSRAM) and writes them to the SD card in batches - one
+// open/append/close per sensor segment instead of one per reading. Flush triggers:
+//   - size:  LOG_BUFFER_FLUSH_RECORDS records buffered (all sensors together)
+//   - time:  oldest buffered record reaches LOG_BUFFER_MAX_AGE_S - the maximum data-loss window
+//            on power loss / reset
+//   - idle:  IdleTask going into deep sleep (PSRAM is lost), or into an idle period that would
+//            push the oldest record past the data-loss window
+// The buffer is also the reorder window - each slot is kept in time order and a reading repeating
+// a buffered timestamp is dropped, readings arriving after their neighbours were flushed are
+// merged into place by logAppendBatch().
+
+#ifndef LOG_BUFFER_CAPACITY
+#define LOG_BUFFER_CAPACITY 256         // Records per sensor slot, kept while the card is unavailable
+#endif
+#ifndef LOG_BUFFER_FLUSH_RECORDS
+#define LOG_BUFFER_FLUSH_RECORDS 16     // All sensors together - two at 15 min log 8 per hour, so MAX_AGE flushes first
+#endif
+#ifndef LOG_BUFFER_MAX_AGE_S
+#define LOG_BUFFER_MAX_AGE_S 3600       // Maximum data-loss window
+#endif
+#ifndef LOG_BUFFER_RETRY_S
+#define LOG_BUFFER_RETRY_S 60           // Backoff after a failed flush
+#endif
+#define LOG_BUFFER_MAX_SENSORS LOG_MAX_SENSORS
+
+typedef enum {
+    LOG_FLUSH_SIZE = 0,
+    LOG_FLUSH_TIME,
+    LOG_FLUSH_IDLE,
+    LOG_FLUSH_REASONS
+} LogFlushReason;
+
+typedef struct {
+    uint32_t buffered;                  // Records currently waiting in the buffer
+    uint32_t recordsAdded;
+    uint32_t recordsWritten;
+    uint32_t recordsDropped;            // Overwritten while the buffer was full (card unavailable)
+    uint32_t recordsReordered;          // Arrived behind a newer buffered reading
+    uint32_t recordsDuplicate;          // Timestamp already buffered, dropped
+    uint32_t flushes[LOG_FLUSH_REASONS];
+    uint32_t flushErrors;
+    uint32_t lastFlushMs;               // Duration of the last flush
+    uint32_t oldestAgeS;                // Age of the oldest buffered record
+} LogBufferStats;
+
+bool logBufferInit();
+void logBufferAdd(const char *sensor, const LogRecord &rec);
+uint32_t logBufferCount();
+
+// Flush reason due right now (size or time), -1 if none or a failed flush is backing off
+int logBufferFlushDue();
+// Should an idle period of idleSeconds flush the buffer first
+bool logBufferFlushBeforeIdle(uint32_t idleSeconds, bool deepSleep);
+// Ticks until the time threshold expires (or a retry backoff ends), portMAX_DELAY with an empty buffer
+TickType_t logBufferWaitTicks();
+
+// Writes all buffered records, records of a failed sensor stay buffered for the next attempt
+bool logBufferFlush(LogFlushReason reason);
+// Holds size/time flushes back for LOG_BUFFER_RETRY_S - failed flushes call it, so does the caller
+// when the card isn't there to flush to
+void logBufferRetryLater();
+
+LogBufferStats logBufferGetStats();
+
+#endif /* LOGWRITEBUFFER_H */
@@ -0,0 +1,66 @@
+#include "sdStats.h"
+
+static SDOpStats opStats[SD_OP_COUNT];
+static SDCardStats cardStats;
+static SemaphoreHandle_t statsMutex = NULL;
+
+static const char* opNames[SD_OP_COUNT] = {
+    "mount", "healthCheck", "open", "exists", "read", "append", "flush", "list", "json", "chartCache"
+};
+
+static void lockStats() {
+    if (statsMutex == NULL) {
+        statsMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(statsMutex, portMAX_DELAY);
+}
+
+static void unlockStats() {
+    xSemaphoreGive(statsMutex);
+}
+
+void sdStatsRecord(SDOp op, uint32_t elapsedUs, bool ok, uint32_t bytes) {
+    if (op >= SD_OP_COUNT) return;
+
+    // log2 of whole milliseconds
+    uint32_t ms = elapsedUs / 1000;
+    int bucket = 0;
+    while (ms > 0 && bucket < SD_STATS_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+
+    lockStats();
+    SDOpStats &stats = opStats[op];
+    stats.count++;
+    if (!ok) stats.errors++;
+    stats.bytes += bytes;
+    stats.totalUs += elapsedUs;
+    stats.maxUs = max(stats.maxUs, elapsedUs);
+    stats.histogram[bucket]++;
+    unlockStats();
+}
+
+void sdStatsHealthFailure() {
+    lockStats();
+    cardStats.healthFailures++;
+    unlockStats();
+}
+
+void sdStatsReinit(bool success) {
+    lockStats();
+    cardStats.reinitAttempts++;
+    if (success) cardStats.reinits++;
+    unlockStats();
+}
+
+const char* sdStatsOpName(SDOp op) {
+    return op < SD_OP_COUNT ? opNames[op] : "unknown";
+}
+
+void sdStatsGet(SDOpStats ops[SD_OP_COUNT], SDCardStats &card) {
+    lockStats();
+    memcpy(ops, opStats, sizeof(opStats));
+    card = cardStats;
+    unlockStats();
+}
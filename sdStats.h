@@ -0,0 +1,69 @@
+#ifndef SDSTATS_H
+#define SDSTATS_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// SD card I/O instrumentation - per operation counts, bytes, errors and latency histograms,
+// plus card health counters. Served as JSON by the log web server (/sd-stats) to find
+// which cards and code paths stall the logging pipeline.
+
+typedef enum {
+    SD_OP_MOUNT = 0,        // SD.begin() and card size check
+    SD_OP_HEALTH_CHECK,     // Root directory probe before each log flush
+    SD_OP_OPEN,             // Log segment / archive opened for reading
+    SD_OP_EXISTS,
+    SD_OP_READ,             // Cached chart JSON copied into responses
+    SD_OP_APPEND,           // Record batch appended to a segment
+    SD_OP_FLUSH,            // Write-behind buffer flush, all sensors
+    SD_OP_LIST,             // Directory listings for downloads
+    SD_OP_JSON,             // Chart JSON / binary payload generated from rollups / raw log
+    SD_OP_CHART_CACHE,      // Incremental chart cache refresh
+    SD_OP_COUNT
+} SDOp;
+
+// Latency histogram - bucket n counts operations under 2^n ms, the last one everything slower
+#define SD_STATS_BUCKETS 12
+
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    uint64_t bytes;
+    uint64_t totalUs;
+    uint32_t maxUs;
+    uint32_t histogram[SD_STATS_BUCKETS];
+} SDOpStats;
+
+typedef struct {
+    uint32_t healthFailures;    // Card found unusable during operation
+    uint32_t reinitAttempts;
+    uint32_t reinits;           // Successful reinitialisations
+} SDCardStats;
+
+void sdStatsRecord(SDOp op, uint32_t elapsedUs, bool ok, uint32_t bytes = 0);
+void sdStatsHealthFailure();
+void sdStatsReinit(bool success);
+
+const char* sdStatsOpName(SDOp op);
+// Consistent snapshot of all counters
+void sdStatsGet(SDOpStats ops[SD_OP_COUNT], SDCardStats &card);
+
+// Times one operation from construction to done(), an unfinished timer counts as success
+class SDOpTimer {
+    public:
+        SDOpTimer(SDOp operation) : op(operation), start(micros()), finished(false) {}
+        ~SDOpTimer() { if (!finished) done(true); }
+
+        void done(bool ok, uint32_t bytes = 0) {
+            sdStatsRecord(op, micros() - start, ok, bytes);
+            finished = true;
+        }
+
+    private:
+        SDOp op;
+        uint32_t start;
+        bool finished;
+};
+
+#endif /* SDSTATS_H */
@@ -0,0 +1,338 @@
+#include "sensorRegistry.h"
+#include "logCSVScanner.h"
+
+typedef struct {
+    uint8_t mac[6];
+    bool hasPressure;
+} PairingOffer;
+
+static SensorInfo sensors[SENSOR_REGISTRY_MAX];
+static volatile bool used[SENSOR_REGISTRY_MAX];
+static bool removed[SENSOR_REGISTRY_MAX];       // Removed since boot - name kept, slot not reused
+static SensorData latest[SENSOR_REGISTRY_MAX];
+static bool dirty = false;
+static SemaphoreHandle_t registryMutex = NULL;
+static QueueHandle_t pairingQueue = NULL;
+static volatile uint32_t pairingUntil = 0;      // millis() pairing closes, 0 if closed
+
+static void lockRegistry() {
+    if (registryMutex == NULL) {
+        registryMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(registryMutex, portMAX_DELAY);
+}
+
+static void unlockRegistry() {
+    xSemaphoreGive(registryMutex);
+}
+
+// Caller holds the lock; name and label are copied, mac may be NULL
+static void setEntry(SensorId id, const char *name, const char *label, const uint8_t *mac, uint8_t flags) {
+    SensorInfo &info = sensors[id];
+    memset(&info, 0, sizeof(info));
+    info.id = id;
+    strncpy(info.name, name, sizeof(info.name) - 1);
+    strncpy(info.label, label, sizeof(info.label) - 1);
+    info.hasMac = mac != NULL;
+    if (mac) memcpy(info.mac, mac, 6);
+    info.flags = flags;
+
+    latest[id] = SensorData();
+    latest[id].sensorId = id;
+    // Lock free readers (sensorRegistryForMac, sensorName) see the entry only once it is complete
+    __sync_synchronize();
+    used[id] = true;
+}
+
+static bool parseMac(const char *text, uint8_t *mac) {
+    unsigned parts[6];
+    if (sscanf(text, "%2x:%2x:%2x:%2x:%2x:%2x", &parts[0], &parts[1], &parts[2],
+               &parts[3], &parts[4], &parts[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) mac[i] = parts[i];
+    return true;
+}
+
+// Sensor names become file names - letters, digits and '-' only, the month follows the last '_'
+static bool validName(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= LOG_SENSOR_NAME_MAX) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '-') return false;
+    }
+    return true;
+}
+
+// "id,name,mac,flags,label" per line, mac "-" for local sensors. A save interrupted between
+// removing the old table and renaming the new one leaves only the temp file.
+static void loadRegistry() {
+    const char *path = SD.exists(SENSOR_REGISTRY_FILE) ? SENSOR_REGISTRY_FILE : SENSOR_REGISTRY_TEMP;
+    LogCSVScanner file;
+    if (!file.open(path)) return;
+
+    size_t loaded = 0;
+    char *line;
+    size_t len;
+    while (file.nextLine(line, len)) {
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        unsigned id, flags;
+        char name[LOG_SENSOR_NAME_MAX + 1], macText[18], label[SENSOR_LABEL_MAX];
+        label[0] = '\0';
+        int fields = sscanf(line, "%u,%12[^,],%17[^,],%u,%23[^\n]", &id, name, macText, &flags, label);
+        uint8_t mac[6];
+        bool hasMac = fields >= 3 && parseMac(macText, mac);
+        if (fields < 4 || id >= SENSOR_REGISTRY_MAX || !validName(name)) {
+            Serial.printf("[WARNING] Sensor registry: skipping line '%s'\n", line);
+            continue;
+        }
+        setEntry(id, name, fields == 5 ? label : name, hasMac ? mac : NULL, flags);
+        loaded++;
+    }
+    file.close();
+    Serial.printf("[INFO] Sensor registry: %u entries loaded from %s\n", (unsigned)loaded, path);
+}
+
+//################## Pairing ##################
+
+static void pairingTask(void *parameter) {
+    PairingOffer offer;
+    while (1) {
+        if (xQueueReceive(pairingQueue, &offer, portMAX_DELAY) != pdTRUE) continue;
+        const uint8_t *mac = offer.mac;
+
+        // Several packets of one node may be queued
+        if (sensorRegistryForMac(mac) != SENSOR_ID_NONE) continue;
+        if (!sensorRegistryPairingOpen()) {
+            Serial.printf("[INFO] Sensor registry: unknown node %02X:%02X:%02X:%02X:%02X:%02X ignored, pairing is closed\n",
+                          mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            continue;
+        }
+        sensorRegistryAdd(mac, offer.hasPressure);
+    }
+}
+
+void sensorRegistryInit(const uint8_t *outsideMac) {
+    lockRegistry();
+    setEntry(SENSOR_ID_INSIDE, insideLogName, "Room", NULL, SENSOR_FLAG_LOCAL);
+    setEntry(SENSOR_ID_OUTSIDE, outsideLogName, "Garden", outsideMac, SENSOR_FLAG_PRESSURE);
+    loadRegistry();
+    unlockRegistry();
+
+    pairingQueue = xQueueCreate(SENSOR_PAIRING_QUEUE_LENGTH, sizeof(PairingOffer));
+    if (pairingQueue == NULL || xTaskCreate(pairingTask, "SensorPairingTask", 3072, NULL, 1, NULL) != pdPASS) {
+        Serial.println("[ERROR] Failed to start sensor pairing, only known nodes are accepted");
+    }
+}
+
+SensorId sensorRegistryForMac(const uint8_t *mac) {
+    for (SensorId id = 0; id < SENSOR_REGISTRY_MAX; id++) {
+        if (used[id] && sensors[id].hasMac && memcmp(sensors[id].mac, mac, 6) == 0) return id;
+    }
+    return SENSOR_ID_NONE;
+}
+
+void sensorRegistryOfferNode(const uint8_t *mac, bool hasPressure) {
+    if (pairingQueue == NULL) return;
+    PairingOffer offer;
+    memcpy(offer.mac, mac, 6);
+    offer.hasPressure = hasPressure;
+    xQueueSend(pairingQueue, &offer, 0);
+}
+
+void sensorRegistryOpenPairing(uint32_t seconds) {
+    seconds = min(seconds, (uint32_t)SENSOR_PAIRING_MAX_S);
+    pairingUntil = seconds > 0 ? max(millis() + seconds * 1000, 1UL) : 0;
+    if (seconds > 0) {
+        Serial.printf("[INFO] Sensor registry: pairing open, new nodes accepted for %u s\n", (unsigned)seconds);
+    } else {
+        Serial.println("[INFO] Sensor registry: pairing closed");
+    }
+}
+
+bool sensorRegistryPairingOpen() {
+    uint32_t until = pairingUntil;
+    return until != 0 && (int32_t)(until - millis()) > 0;
+}
+
+// Caller holds the lock - name of another node, registered or removed since boot
+static bool nameTaken(const char *name, const uint8_t *mac) {
+    for (SensorId i = 0; i < SENSOR_REGISTRY_MAX; i++) {
+        if ((used[i] || removed[i]) && strcmp(sensors[i].name, name) == 0 &&
+            !(sensors[i].hasMac && memcmp(sensors[i].mac, mac, 6) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Log partition of a paired node, from its MAC rather than the slot - a slot freed by
+// sensorRegistryRemove() is reused after a restart, the next node there must not continue the
+// removed node's logs. A node paired again continues its own.
+static bool nodeName(const uint8_t *mac, char *name, size_t len) {
+    snprintf(name, len, "node-%02x%02x%02x", mac[3], mac[4], mac[5]);
+    if (!nameTaken(name, mac)) return true;
+    snprintf(name, len, "n%02x%02x%02x%02x%02x", mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return !nameTaken(name, mac);
+}
+
+SensorId sensorRegistryAdd(const uint8_t *mac, bool hasPressure) {
+    lockRegistry();
+    SensorId id = SENSOR_ID_NONE;
+    for (SensorId i = 0; i < SENSOR_REGISTRY_MAX; i++) {
+        if (used[i] && sensors[i].hasMac && memcmp(sensors[i].mac, mac, 6) == 0) {
+            unlockRegistry();
+            return i;
+        }
+    }
+
+    // Unbound outside sensor takes the first node paired
+    if (used[SENSOR_ID_OUTSIDE] && !sensors[SENSOR_ID_OUTSIDE].hasMac) {
+        id = SENSOR_ID_OUTSIDE;
+        memcpy(sensors[id].mac, mac, 6);
+        __sync_synchronize();
+        sensors[id].hasMac = true;
+    } else {
+        for (SensorId i = 0; i < SENSOR_REGISTRY_MAX; i++) {
+            if (!used[i] && !removed[i]) {
+                char name[LOG_SENSOR_NAME_MAX];
+                if (!nodeName(mac, name, sizeof(name))) break;
+                setEntry(i, name, name, mac, hasPressure ? SENSOR_FLAG_PRESSURE : 0);
+                id = i;
+                break;
+            }
+        }
+    }
+    if (id != SENSOR_ID_NONE) dirty = true;
+    unlockRegistry();
+
+    if (id != SENSOR_ID_NONE) {
+        Serial.printf("[INFO] Sensor registry: %02X:%02X:%02X:%02X:%02X:%02X registered as %s (id %u)\n",
+                      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], sensors[id].name, (unsigned)id);
+    } else {
+        Serial.println("[WARNING] Sensor registry full or node name taken, node ignored");
+    }
+    return id;
+}
+
+bool sensorRegistryRemove(SensorId id) {
+    if (id >= SENSOR_REGISTRY_MAX || id == SENSOR_ID_INSIDE || id == SENSOR_ID_OUTSIDE) return false;
+    lockRegistry();
+    bool found = used[id];
+    if (found) {
+        used[id] = false;
+        removed[id] = true;
+        dirty = true;
+    }
+    unlockRegistry();
+
+    if (found) Serial.printf("[INFO] Sensor registry: %s (id %u) removed\n", sensors[id].name, (unsigned)id);
+    return found;
+}
+
+//################## Lookup ##################
+
+bool sensorRegistryGet(SensorId id, SensorInfo &info) {
+    if (id >= SENSOR_REGISTRY_MAX) return false;
+    lockRegistry();
+    bool found = used[id];
+    if (found) info = sensors[id];
+    unlockRegistry();
+    return found;
+}
+
+SensorId sensorRegistryFind(const char *name) {
+    SensorId found = SENSOR_ID_NONE;
+    lockRegistry();
+    for (SensorId id = 0; id < SENSOR_REGISTRY_MAX; id++) {
+        if (used[id] && strcmp(sensors[id].name, name) == 0) {
+            found = id;
+            break;
+        }
+    }
+    unlockRegistry();
+    return found;
+}
+
+size_t sensorRegistryCount() {
+    size_t count = 0;
+    lockRegistry();
+    for (SensorId id = 0; id < SENSOR_REGISTRY_MAX; id++) {
+        if (used[id]) count++;
+    }
+    unlockRegistry();
+    return count;
+}
+
+// Names are never changed and slots not reused before a restart, so names can be read without
+// the lock - also of a node removed while its last readings are still in the queues
+const char* sensorName(SensorId id) {
+    return (id < SENSOR_REGISTRY_MAX && (used[id] || removed[id])) ? sensors[id].name : NULL;
+}
+
+bool sensorHasPressure(SensorId id) {
+    return id < SENSOR_REGISTRY_MAX && used[id] && (sensors[id].flags & SENSOR_FLAG_PRESSURE);
+}
+
+void sensorRegistrySetLatest(const SensorData &data) {
+    if (data.sensorId >= SENSOR_REGISTRY_MAX) return;
+    lockRegistry();
+    latest[data.sensorId] = data;
+    unlockRegistry();
+}
+
+bool sensorRegistryGetLatest(SensorId id, SensorData &data) {
+    if (id >= SENSOR_REGISTRY_MAX) return false;
+    lockRegistry();
+    bool found = used[id] && latest[id].timestamp != 0;
+    if (found) data = latest[id];
+    unlockRegistry();
+    return found;
+}
+
+bool sensorRegistrySave() {
+    lockRegistry();
+    if (!dirty) {
+        unlockRegistry();
+        return true;
+    }
+    SensorInfo snapshot[SENSOR_REGISTRY_MAX];
+    bool snapshotUsed[SENSOR_REGISTRY_MAX];
+    memcpy(snapshot, sensors, sizeof(snapshot));
+    for (SensorId id = 0; id < SENSOR_REGISTRY_MAX; id++) {
+        snapshotUsed[id] = used[id];
+    }
+    dirty = false;
+    unlockRegistry();
+
+    // Written aside and renamed over the table - a reset or card error mid-write keeps the old one
+    bool ok = false;
+    File file = SD.open(SENSOR_REGISTRY_TEMP, FILE_WRITE);
+    if (file) ok = file.printf("# id,name,mac,flags,label - flags: 1 pressure, 2 local\n") > 0;
+    for (SensorId id = 0; id < SENSOR_REGISTRY_MAX; id++) {
+        if (!ok || !snapshotUsed[id]) continue;
+        const SensorInfo &info = snapshot[id];
+        if (info.hasMac) {
+            ok = file.printf("%u,%s,%02X:%02X:%02X:%02X:%02X:%02X,%u,%s\n", (unsigned)id, info.name,
+                             info.mac[0], info.mac[1], info.mac[2], info.mac[3], info.mac[4], info.mac[5],
+                             (unsigned)info.flags, info.label) > 0;
+        } else {
+            ok = file.printf("%u,%s,-,%u,%s\n", (unsigned)id, info.name, (unsigned)info.flags, info.label) > 0;
+        }
+    }
+    if (file) file.close();
+    if (ok) {
+        SD.remove(SENSOR_REGISTRY_FILE);
+        ok = SD.rename(SENSOR_REGISTRY_TEMP, SENSOR_REGISTRY_FILE);
+    }
+    if (!ok) {
+        Serial.printf("[ERROR] Failed to write %s\n", SENSOR_REGISTRY_FILE);
+        lockRegistry();
+        dirty = true;
+        unlockRegistry();
+        return false;
+    }
+    Serial.printf("[INFO] Sensor registry saved to %s\n", SENSOR_REGISTRY_FILE);
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef SENSORREGISTRY_H
+#define SENSORREGISTRY_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "logStorage.h"
+
+// Sensor registry - every sensor node gets a compact numeric ID, used throughout the pipeline
+// (queues, rendering, logging, web API) instead of log name strings. The ID maps to the node's
+// metadata, its log partition (segment name prefix) and a latest-value slot.
+// The local SHT4x and the first ESP-NOW node are built in. Further ESP-NOW nodes are added to
+// SENSOR_REGISTRY_FILE by hand or paired: packets of unknown nodes are only offered to the
+// registry, a background task registers them while pairing is open (POST /sensors/pair).
+// The table is persisted to SENSOR_REGISTRY_FILE, labels and flags can be edited there.
+
+#define SENSOR_REGISTRY_MAX LOG_MAX_SENSORS
+#define SENSOR_REGISTRY_FILE "/sensors.csv"
+#define SENSOR_REGISTRY_TEMP "/sensors.tmp"
+#define SENSOR_LABEL_MAX 24
+#define SENSOR_PAIRING_QUEUE_LENGTH 4
+#define SENSOR_PAIRING_MAX_S 600        // Longest pairing window
+
+typedef uint8_t SensorId;
+
+#define SENSOR_ID_INSIDE 0          // Local SHT4x - insideLogName
+#define SENSOR_ID_OUTSIDE 1         // First ESP-NOW node - outsideLogName
+#define SENSOR_ID_NONE 0xFF
+
+// SensorInfo flags
+#define SENSOR_FLAG_PRESSURE 0x01   // Reports pressure (BME280)
+#define SENSOR_FLAG_LOCAL 0x02      // Read on this board, no MAC
+
+// Struct for transfering data in the queues - rendering, server updates, storing
+typedef struct {
+    int32_t timestamp;
+    float temperature;
+    float humidity;
+    float pressure;
+    SensorId sensorId;      // Registry ID
+    uint8_t batPercentage;
+} SensorData;
+
+typedef struct {
+    SensorId id;
+    char name[LOG_SENSOR_NAME_MAX]; // Log partition
+    char label[SENSOR_LABEL_MAX];   // Display name
+    uint8_t mac[6];
+    bool hasMac;
+    uint8_t flags;
+} SensorInfo;
+
+// Built-in sensors, then SENSOR_REGISTRY_FILE if the card is mounted, starts the pairing task;
+// outsideMac binds the outside node (NULL - the first node paired becomes "outside")
+void sensorRegistryInit(const uint8_t *outsideMac);
+
+// ID of a known node, SENSOR_ID_NONE otherwise - lock free, safe in the ESP-NOW receive callback
+SensorId sensorRegistryForMac(const uint8_t *mac);
+// Packet from an unknown node - queued for the pairing task without blocking, dropped unless
+// pairing is open when the task gets to it
+void sensorRegistryOfferNode(const uint8_t *mac, bool hasPressure);
+// Unknown nodes reporting in the next seconds are registered, 0 closes pairing
+void sensorRegistryOpenPairing(uint32_t seconds);
+bool sensorRegistryPairingOpen();
+// Registers a node right away (pairing task, tools); SENSOR_ID_NONE if the registry is full
+SensorId sensorRegistryAdd(const uint8_t *mac, bool hasPressure);
+// Forgets a paired node - its logs stay, the slot is reused after a restart. Paired nodes are
+// named after their MAC ("node-a1b2c3"), so the next node in the slot gets logs of its own.
+// Built-in sensors can't be removed.
+bool sensorRegistryRemove(SensorId id);
+
+bool sensorRegistryGet(SensorId id, SensorInfo &info);
+SensorId sensorRegistryFind(const char *name);
+size_t sensorRegistryCount();
+
+// Log partition of the sensor, NULL for unknown IDs
+const char* sensorName(SensorId id);
+bool sensorHasPressure(SensorId id);
+
+// Latest reading of each sensor, kept in RAM for the display and /latest
+void sensorRegistrySetLatest(const SensorData &data);
+bool sensorRegistryGetLatest(SensorId id, SensorData &data);
+
+// Writes the table if nodes were registered since the last save, needs a mounted card
+bool sensorRegistrySave();
+
+#endif /* SENSORREGISTRY_H */
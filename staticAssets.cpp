@@ -0,0 +1,127 @@
+#include "staticAssets.h"
+
+// A page that can't be loaded is retried after this long - until then requests fall back to the file
+#define STATIC_ASSET_RETRY_MS 60000
+
+typedef struct {
+    char path[STATIC_ASSET_PATH_MAX];
+    const char *contentType;
+    uint8_t *data;              // NULL while not loaded
+    size_t size;
+    bool gzip;
+    char etag[12];
+    uint32_t failedAt;          // millis() of the last failed load, 0 if none
+} StaticAsset;
+
+// Only touched by setup code and the async web server task
+static StaticAsset assets[STATIC_ASSET_MAX];
+static size_t assetCount = 0;
+
+static StaticAsset* findAsset(const char *path) {
+    for (size_t i = 0; i < assetCount; i++) {
+        if (strcmp(assets[i].path, path) == 0) return &assets[i];
+    }
+    return NULL;
+}
+
+// Reads a whole file into PSRAM, NULL if missing, empty or too large
+static uint8_t* readFile(fs::FS &fs, const char *path, size_t &size) {
+    File file = fs.open(path, FILE_READ);
+    if (!file) return NULL;
+    size = file.size();
+    if (size == 0 || size > STATIC_ASSET_SIZE_MAX) {
+        file.close();
+        return NULL;
+    }
+
+    uint8_t *data = (uint8_t*)ps_malloc(size);
+    if (!data) data = (uint8_t*)malloc(size);
+    if (!data) {
+        Serial.printf("[ERROR] Failed to allocate %u bytes for %s\n", (unsigned)size, path);
+        file.close();
+        return NULL;
+    }
+    size_t bytesRead = file.read(data, size);
+    file.close();
+    if (bytesRead != size) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+bool staticAssetLoad(fs::FS &fs, const char *path, const char *contentType) {
+    if (strlen(path) + 3 >= STATIC_ASSET_PATH_MAX) return false;
+
+    StaticAsset *asset = findAsset(path);
+    if (asset == NULL) {
+        if (assetCount >= STATIC_ASSET_MAX) {
+            Serial.printf("[WARNING] Static asset table full, %s served from file\n", path);
+            return false;
+        }
+        asset = &assets[assetCount++];
+        memset(asset, 0, sizeof(StaticAsset));
+        strncpy(asset->path, path, STATIC_ASSET_PATH_MAX - 1);
+    }
+    asset->contentType = contentType;
+
+    char gzPath[STATIC_ASSET_PATH_MAX];
+    snprintf(gzPath, sizeof(gzPath), "%s.gz", path);
+    size_t size = 0;
+    bool gzip = true;
+    uint8_t *data = readFile(fs, gzPath, size);
+    if (!data) {
+        gzip = false;
+        data = readFile(fs, path, size);
+    }
+    if (!data) {
+        asset->failedAt = max(millis(), 1UL);
+        Serial.printf("[WARNING] Static asset %s not loaded\n", path);
+        return false;
+    }
+
+    free(asset->data);
+    asset->data = data;
+    asset->size = size;
+    asset->gzip = gzip;
+    asset->failedAt = 0;
+
+    // FNV-1a of the content
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    snprintf(asset->etag, sizeof(asset->etag), "\"%08x\"", (unsigned)hash);
+
+    Serial.printf("[INFO] Static asset %s: %u bytes%s in memory\n", path, (unsigned)size, gzip ? " gzipped" : "");
+    return true;
+}
+
+bool staticAssetSend(AsyncWebServerRequest *request, fs::FS &fs, const char *path, const char *contentType) {
+    StaticAsset *asset = findAsset(path);
+    if (asset == NULL || asset->data == NULL) {
+        if (asset && asset->failedAt != 0 && millis() - asset->failedAt < STATIC_ASSET_RETRY_MS) return false;
+        if (!staticAssetLoad(fs, path, contentType)) return false;
+        asset = findAsset(path);
+    }
+
+    if (asset->gzip && (!request->hasHeader("Accept-Encoding") ||
+                        request->header("Accept-Encoding").indexOf("gzip") < 0)) {
+        return false;
+    }
+
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match").indexOf(asset->etag) >= 0) {
+        response = request->beginResponse(304);
+    } else {
+        response = request->beginResponse(200, asset->contentType, asset->data, asset->size);
+        if (asset->gzip) response->addHeader("Content-Encoding", "gzip");
+    }
+    char cacheControl[32];
+    snprintf(cacheControl, sizeof(cacheControl), "max-age=%d", STATIC_ASSET_MAX_AGE);
+    response->addHeader("Cache-Control", cacheControl);
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Vary", "Accept-Encoding");
+    request->send(response);
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef STATICASSETS_H
+#define STATICASSETS_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ESPAsyncWebServer.h>
+
+// Web pages kept in PSRAM - loaded once from the card / SPIFFS, preferably as the .gz that
+// gzip_assets.py produces at build time, and sent from memory with Content-Encoding: gzip.
+// Page loads don't touch the SD bus and move ~6x fewer bytes over WiFi.
+
+#define STATIC_ASSET_MAX 4
+#define STATIC_ASSET_PATH_MAX 32
+#define STATIC_ASSET_SIZE_MAX (256 * 1024)
+
+// Browsers reuse a page this long without asking, then revalidate it with the ETag
+#ifndef STATIC_ASSET_MAX_AGE
+#define STATIC_ASSET_MAX_AGE 86400
+#endif
+
+// Loads path.gz, else path itself, from fs - again if already loaded (page updated)
+bool staticAssetLoad(fs::FS &fs, const char *path, const char *contentType);
+// Sends a page from memory, loading it on first use; false if it isn't available
+// (caller falls back to the file), or only gzipped and the client doesn't accept gzip
+bool staticAssetSend(AsyncWebServerRequest *request, fs::FS &fs, const char *path, const char *contentType);
+
+#endif /* STATICASSETS_H */
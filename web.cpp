@@ -7,6 +7,7 @@
 #include <ElegantOTA.h>
 
 #include <web.h>
+#include "staticAssets.h"
 
 bool configDone = false;
 static AsyncWebServer configServer(80);
@@ -18,9 +19,18 @@ void handleRoot(AsyncWebServerRequest *request)
     request->send(200, "text/plain", "hello from ESP32!");
 }
 
+// Gzipped page from PSRAM, the SPIFFS file if it isn't available
+void sendConfigPage(AsyncWebServerRequest *request)
+{
+    if (!staticAssetSend(request, SPIFFS, "/config.html", "text/html"))
+    {
+        request->send(SPIFFS, "/config.html", "text/html");
+    }
+}
+
 void handleSettings(AsyncWebServerRequest *request)
 {
-    request->send(SPIFFS, "/config.html", "text/html");
+    sendConfigPage(request);
 }
 
 void handleConfig(AsyncWebServerRequest *request)
@@ -32,7 +42,7 @@ void handleConfig(AsyncWebServerRequest *request)
         Serial.println("Processing settings...");
         storeConfigFromRequest(request);
         configDone = true;
-        request->send(SPIFFS, "/config.html", "text/html");
+        sendConfigPage(request);
     }
     else
     {
@@ -79,6 +89,8 @@ void setupConfigWEB()
     // Initialize ElegantOTA with AsyncWebServer
     ElegantOTA.begin(&configServer);  // Start ElegantOTA
 
+    staticAssetLoad(SPIFFS, "/config.html", "text/html");
+
     // Serve static files from SPIFFS
     configServer.serveStatic("/", SPIFFS, "/").setDefaultFile("config.html");
 